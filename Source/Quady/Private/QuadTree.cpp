@@ -4,23 +4,169 @@
 #include "ContentStreaming.h"
 #include "AssertionMacros.h"
 #include "QuadTreeViewer.h"
-#include "Async.h"
+#include "QuadTreeCore.h"
+#include "QuadTreeOcclusion.h"
+#include "QuadTreeHeightCache.h"
+#include "QuadTreeHeightAtlas.h"
+#include "QuadTreeHeightNormals.h"
+#include "QuadTreeRelevancy.h"
+#include "QuadTreeClipmap.h"
+#include "QuadTreeLayers.h"
+#include "QuadTreeDebugDraw.h"
+#include "QuadyScalability.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "Misc/MemStack.h"
+#include "Engine/Texture2D.h"
 
 #if !UE_BUILD_SHIPPING
 #include "DrawDebugHelpers.h"
+#include "Components/LineBatchComponent.h"
 #endif
 
 #define LOCTEXT_NAMESPACE "Quady"
 
 DECLARE_CYCLE_STAT(TEXT("QuadTree Update"), STAT_QuadTreeUpdate, STATGROUP_Quady);
+DECLARE_CYCLE_STAT(TEXT("QuadTree Snapshot"), STAT_QuadTreeSnapshot, STATGROUP_Quady);
+DECLARE_CYCLE_STAT(TEXT("QuadTree Tiles"), STAT_QuadTreeTiles, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Resident Tiles"), STAT_QuadTreeResidentTiles, STATGROUP_Quady);
+DECLARE_CYCLE_STAT(TEXT("QuadTree Occlusion"), STAT_QuadTreeOcclusion, STATGROUP_Quady);
+DECLARE_MEMORY_STAT(TEXT("QuadTree Compact Nodes"), STAT_QuadTreeCompactNodeMemory, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Update Allocations"), STAT_QuadTreeUpdateAllocations, STATGROUP_Quady);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("QuadTree Atlas Unplaced Leaves"), STAT_QuadTreeAtlasUnplacedLeaves, STATGROUP_Quady);
+
+#if STATS
+/* Global allocator calls on any thread while in scope, an upper bound on Quady's own */
+struct FQuadTreeAllocationCounter
+{
+    uint32 Start;
+
+    FQuadTreeAllocationCounter() : Start(GetCount()) { }
+    ~FQuadTreeAllocationCounter() { INC_DWORD_STAT_BY(STAT_QuadTreeUpdateAllocations, GetCount() - Start); }
+
+    static uint32 GetCount() { return FMalloc::TotalMallocCalls + FMalloc::TotalReallocCalls; }
+};
+#define QUADTREE_SCOPE_ALLOCATION_COUNTER() FQuadTreeAllocationCounter QuadTreeAllocationCounter
+#else
+#define QUADTREE_SCOPE_ALLOCATION_COUNTER()
+#endif
+
+/* Staging image and regions of one atlas update, reused once the render thread has copied them */
+struct FQuadTreeHeightAtlasUpload
+{
+    TArray<FColor> Staging;
+    TArray<FQuadTreeHeightAtlasRegion> Regions;
+    TArray<FUpdateTextureRegion2D> UpdateRegions;
+    FThreadSafeBool bInFlight;
+};
+
+/* Nearest occluders of the previous selection */
+static void RasterizeOccluders(FQuadTreeOcclusionBuffer& OcclusionBuffer, const FQuadTreeViewer& Viewer, const TArray<FQuadTreeLeaf>& Leaves, const FVector& EyeLocation, const int32 Count)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeOcclusion);
+
+    /* The calling thread's own arena */
+    FMemMark WorkerMark(FMemStack::Get());
+
+    TArray<FBox, TMemStackAllocator<>> Occluders;
+    Occluders.Reserve(Leaves.Num());
+    for (auto& Leaf : Leaves)
+        Occluders.Add(Viewer.GetRelativeBounds(Leaf.Coordinates, Leaf.Level, Leaf.HeightBounds));
+
+    Occluders.Sort([&EyeLocation](const FBox& A, const FBox& B)
+    {
+        return A.ComputeSquaredDistanceToPoint(EyeLocation) < B.ComputeSquaredDistanceToPoint(EyeLocation);
+    });
+
+    OcclusionBuffer.Reset(EyeLocation);
+    for (auto i = 0; i < FMath::Min(Count, Occluders.Num()); i++)
+        OcclusionBuffer.AddOccluder(Occluders[i]);
+}
+
+/* Small enough for the task graph's pooled task and event allocators, so dispatching one doesn't hit the heap */
+class FQuadTreeOcclusionTask
+{
+public:
+    FQuadTreeOcclusionTask(FQuadTreeOcclusionBuffer* InOcclusionBuffer, const FQuadTreeViewer* InViewer, const TArray<FQuadTreeLeaf>* InLeaves, const FVector& InEyeLocation, const int32 InCount)
+        : OcclusionBuffer(InOcclusionBuffer),
+        Viewer(InViewer),
+        Leaves(InLeaves),
+        EyeLocation(InEyeLocation),
+        Count(InCount) { }
+
+    inline TStatId GetStatId() const { RETURN_QUICK_DECLARE_CYCLE_STAT(FQuadTreeOcclusionTask, STATGROUP_TaskGraphTasks); }
+    static inline ENamedThreads::Type GetDesiredThread() { return ENamedThreads::AnyThread; }
+    static inline ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::TrackSubsequents; }
+
+    void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+    {
+        RasterizeOccluders(*OcclusionBuffer, *Viewer, *Leaves, EyeLocation, Count);
+    }
+
+private:
+    FQuadTreeOcclusionBuffer* OcclusionBuffer;
+    const FQuadTreeViewer* Viewer;
+    const TArray<FQuadTreeLeaf>* Leaves;
+    FVector EyeLocation;
+    int32 Count;
+};
+
+namespace QuadTreeSnapshot
+{
+    static const uint32 Magic = 0x51445953; // QDYS
+    static const int32 Version = 7;
+}
+
+/* Smallest specialization that fits, fewer levels get narrower indices */
+template <typename BoundsPolicy>
+static TSharedPtr<IQuadTreeCore> MakeQuadTreeCore(const uint8 LevelCount)
+{
+    check(LevelCount <= IQuadTreeCore::MaxLevelCount);
+
+    if (LevelCount <= 8)
+        return MakeShared<TQuadTree<8, BoundsPolicy>>();
+    
+    return MakeShared<TQuadTree<IQuadTreeCore::MaxLevelCount, BoundsPolicy>>();
+}
+
+/* Cube bounds never change, so with height data the nodes need their own for refits and occlusion */
+static TSharedPtr<IQuadTreeCore> MakeQuadTreeCore(const uint8 LevelCount, const bool bHasHeights)
+{
+    return bHasHeights ? MakeQuadTreeCore<FQuadTreeHeightBoundsPolicy>(LevelCount) : MakeQuadTreeCore<FQuadTreeCubeBoundsPolicy>(LevelCount);
+}
 
 UQuadTree::UQuadTree()
     : bFloatingOrigin(false),
     MinimumQuadSize(1600),
     MaximumQuadSize(102400),
-    ViewerRadiusMultiplier(1.0f)
+    bTiled(false),
+    bCompactNodes(false),
+    bClipmap(false),
+    ViewerRadiusMultiplier(1.0f),
+    MorphStartRatio(0.7f),
+    bOcclusionCulling(false),
+    OccluderCount(64),
+    bProceduralHeights(false),
+    HeightTileResolution(32),
+    MaxCachedHeightTiles(1024),
+    bHeightAtlas(false),
+    HeightAtlasSlotsPerSide(24),
+    HeightAtlasZScale(100.0f),
+    DebugView(EQuadTreeDebugView::Outlines),
+    GridCentering(FIntVector::ZeroValue),
+    RangeScale(1.0f),
+    bShadowViewsDirty(false),
+    RequiredHeightTileCount(0),
+    HeightAtlasTexture(nullptr),
+    HeightAtlasRevision(0),
+    bHeightAtlasComplete(false),
+    bWarnedHeightAtlasFull(false),
+    SelectionRevision(0),
+    DebugBatcher(nullptr)
 {
     Viewer = MakeShared<FQuadTreeViewer>();
+    Relevancy = MakeShared<FQuadTreeRelevancy>(Grid);
+    PayloadLayers = MakeShared<FQuadTreeLayers>(Grid);
     Build();
 }
 
@@ -28,26 +174,98 @@ void UQuadTree::Build()
 {
     check(MinimumQuadSize > 0);
     check(MaximumQuadSize > MinimumQuadSize); // Max should be greater than Min
-    check(FMath::Frac(MaximumQuadSize / MinimumQuadSize) == 0.0f); // Max should be divisible by Min
+    check(MaximumQuadSize % MinimumQuadSize == 0); // Max should be divisible by Min
+    check(FMath::IsPowerOfTwo(MaximumQuadSize / MinimumQuadSize)); // Each level halves the quad size
 
     LevelCount = 0;
     for (auto Level = MinimumQuadSize; Level <= MaximumQuadSize; Level <<= 1)
         LevelCount++;
     
     TArray<float> Ranges;
-    Ranges.Empty(LevelCount);
-    auto Range = MinimumQuadSize >> 1;
-    for (auto i = 0; i < LevelCount; i++)
+    GetRanges(Ranges);
+
+    Grid.CellSize = MinimumQuadSize;
+    Viewer->SetCellSize(Grid.CellSize);
+    Viewer->SetRanges(Ranges);
+
+    /* Level count may have changed, pooled tiles can't be reused */
+    Tiles.Empty();
+    TilePool.Empty();
+    SelectedLeaves.Reset();
+    for (auto& Leaves : ShadowLeaves)
+        Leaves.Reset();
+
+    Core.Reset();
+    Clipmap.Reset();
+    DirtyRegions.Reset();
+
+    /* Cached tiles are keyed for the old cell size */
+    check(FMath::IsPowerOfTwo(HeightTileResolution));
+    HeightCache.Reset();
+    RequiredHeightTileCount = 0;
+
+    auto Source = HeightSource;
+    if (!Source.IsValid() && bProceduralHeights)
+        Source = MakeShared<FQuadTreeProceduralHeightSource, ESPMode::ThreadSafe>(NoiseSettings);
+
+    if (Source.IsValid())
+        HeightCache = MakeShared<FQuadTreeHeightCache, ESPMode::ThreadSafe>(Source.ToSharedRef(), MinimumQuadSize, HeightTileResolution + 1);
+
+    /* Slot size follows the tile resolution, the texture is recreated on the next upload */
+    HeightAtlas.Reset();
+    HeightAtlasTexture = nullptr;
+    bHeightAtlasComplete = false;
+    bWarnedHeightAtlasFull = false;
+    if (bHeightAtlas && HeightCache.IsValid())
+        HeightAtlas = MakeShared<FQuadTreeHeightAtlas>(HeightAtlasSlotsPerSide, HeightTileResolution + 1);
+
+    /* Centered on the world origin. A key only round trips for a node on a multiple of its size, so rather
+       than moving the root off cell (0, 0) the grid is moved under it, tiles and rings stay on the world grid */
+    const auto Centering = bTiled || bClipmap ? FIntVector::ZeroValue : FIntVector(-(MaximumQuadSize >> 1), -(MaximumQuadSize >> 1), 0);
+    Grid.Origin += Centering - GridCentering;
+    GridCentering = Centering;
+
+    auto HalfSize = MaximumQuadSize * 0.5f;
+    auto RootCoordinates = FIntPoint::ZeroValue;
+    auto RootHeightBounds = FFloatInterval(-HalfSize, HalfSize);
+
+    if (bClipmap)
     {
-        Ranges.Add(Range);
-        Range <<= 1;
+        /* Rings are placed on Update */
+        Root = FQuadTreeNode();
+        Clipmap = MakeShared<FQuadTreeClipmap>();
+        Clipmap->Build(LevelCount, Grid.CellSize, Ranges);
     }
+    else if (bTiled)
+    {
+        /* Tiles are paged in on Update */
+        Root = FQuadTreeNode();
+    }
+    else if (bCompactNodes && LevelCount > IQuadTreeCore::MaxLevelCount)
+    {
+        /* Every node of a complete tree is allocated up front, this deep it would take gigabytes */
+        UE_LOG(LogQuady, Warning, TEXT("QuadTree has %d levels, compact nodes support at most %d, using FQuadTreeNode instead"), LevelCount, IQuadTreeCore::MaxLevelCount);
+        Root = FQuadTreeNode(EQuadrant::None, RootCoordinates, LevelCount - 1, RootHeightBounds);
+    }
+    else if (bCompactNodes)
+    {
+        Root = FQuadTreeNode();
+        /* SetNodeHeightBounds without a height source only refits with occlusion on */
+        Core = MakeQuadTreeCore(LevelCount, HeightCache.IsValid() || bOcclusionCulling);
+        Core->Build(LevelCount, RootCoordinates, RootHeightBounds);
 
-    Viewer->SetRanges(Ranges);
+        SET_MEMORY_STAT(STAT_QuadTreeCompactNodeMemory, Core->GetAllocatedSize());
+    }
+    else
+    {
+        Root = FQuadTreeNode(EQuadrant::None, RootCoordinates, LevelCount - 1, RootHeightBounds);
+    }
+
+    /* Registered actors are rebucketed for the new levels */
+    Relevancy->Configure(LevelCount, Ranges, bTiled || bClipmap ? nullptr : &RootCoordinates);
+    PayloadLayers->Configure(LevelCount, Ranges, bTiled || bClipmap ? nullptr : &RootCoordinates);
 
-    auto HalfSize = MaximumQuadSize * 0.5f;;
-    FBox RootBounds(FVector(-HalfSize, -HalfSize, -HalfSize), FVector(HalfSize, HalfSize, HalfSize));
-    Root = FQuadTreeNode(nullptr, EQuadrant::None, RootBounds, LevelCount - 1);
+    Viewer->Invalidate();
 }
 
 void UQuadTree::Update()
@@ -57,6 +275,9 @@ void UQuadTree::Update()
     if (ViewCount <= 0) // Early out
         return;
 
+    /* Selection is 2D, only occlusion needs the height */
+    auto EyeHeight = StreamingManager.GetViewInformation(0).ViewOrigin.Z - Grid.Origin.Z;
+
     PreviousViewLocations.Reset(ViewCount);
     for (auto i = 0; i < ViewCount; i++)
     {
@@ -68,16 +289,83 @@ void UQuadTree::Update()
     }
 
     SCOPE_CYCLE_COUNTER(STAT_QuadTreeUpdate);
+    QUADTREE_SCOPE_ALLOCATION_COUNTER();
+
+    /* Transient containers come from the frame arena, everything after this is freed in O(1) on return */
+    FMemMark FrameMark(FMemStack::Get());
 
     // NOTE: Only supports single viewer for now
 
     auto& FirstViewer = PreviousViewLocations[0];
-    Viewer->SetLocation(FirstViewer.Origin);
+    Viewer->SetLocation(Grid, FirstViewer.Origin);
+    Viewer->SetShadowViews(Grid, ShadowViews);
+
+    if (bShadowViewsDirty)
+    {
+        Viewer->Invalidate();
+        bShadowViewsDirty = false;
+    }
+
+    /* Overlaps tile paging, no task when it ran inline */
+    const auto bOcclusion = bOcclusionCulling && !Clipmap.IsValid() && SelectedLeaves.Num() > 0 && (Viewer->HasLocationChanged() || Viewer->HasDirectionChanged());
+    FGraphEventRef OcclusionTask;
+    if (bOcclusion)
+        OcclusionTask = BeginOcclusion(EyeHeight);
+
+    /* New tiles have no selection yet */
+    if (bTiled && !Clipmap.IsValid() && UpdateTiles())
+        Viewer->Invalidate();
+
+    if (bOcclusion)
+    {
+        if (OcclusionTask.IsValid())
+            FTaskGraphInterface::Get().WaitUntilTaskCompletes(OcclusionTask);
 
-    if (Viewer->HasLocationChanged() || Viewer->HasDirectionChanged())
+        Viewer->SetOcclusion(Occlusion.Get());
+    }
+
+    if (Clipmap.IsValid())
     {
-        Root.Select(Viewer);
+        /* Only the strips that scrolled in, direction doesn't matter */
+        if (Viewer->HasLocationChanged() && Clipmap->Update(Viewer->GetCell()))
+        {
+            ApplyClipmapChanges();
+            RequestHeightTiles();
+        }
     }
+    else if (Viewer->HasLocationChanged() || Viewer->HasDirectionChanged())
+    {
+        if (Core.IsValid())
+            Core->Select(*Viewer);
+        else
+            ForEachRoot([this](FQuadTreeNode& Node) { Node.Select(Viewer); });
+
+        GatherSelectedLeaves();
+        RequestHeightTiles();
+    }
+
+    if (UpdateDirtyRegions())
+    {
+        /* Clipmap leaves were refit in place, nothing entered or left */
+        if (Clipmap.IsValid())
+        {
+            SelectionRevision++;
+        }
+        else
+        {
+            GatherSelectedLeaves();
+            RequestHeightTiles();
+        }
+    }
+
+    Viewer->SetOcclusion(nullptr);
+
+    /* Tiles land asynchronously, keeps going until every leaf is resident */
+    UpdateHeightAtlas();
+
+    /* Same viewer cell and offset as the selection, so a layer at range multiplier 1 matches its cut */
+    if (Viewer->HasLocationChanged() || PayloadLayers->IsDirty())
+        PayloadLayers->Update(Viewer->GetCell(), Viewer->GetCellOffset(), [this](const FQuadTreeNodeKey Key) { return GetNodeHeightBounds(Key); });
 
     Viewer->PostSelect();
 
@@ -86,12 +374,941 @@ void UQuadTree::Update()
 #endif
 }
 
+void UQuadTree::GetRanges(TArray<float>& OutRanges) const
+{
+    OutRanges.Reset(LevelCount);
+    auto Range = (MinimumQuadSize >> 1) * RangeScale;
+    for (auto i = 0; i < LevelCount; i++)
+    {
+        OutRanges.Add(Range);
+        Range *= 2.0f;
+    }
+}
+
+bool UQuadTree::SetRangeScale(const float InRangeScale)
+{
+    const auto NewRangeScale = FMath::Max(InRangeScale, KINDA_SMALL_NUMBER);
+    if (FMath::IsNearlyEqual(NewRangeScale, RangeScale, 1e-3f))
+        return false;
+
+    RangeScale = NewRangeScale;
+
+    /* Rebuilding the rings would drop their height bounds, picked up on the next Build instead */
+    if (Clipmap.IsValid())
+        return false;
+
+    TArray<float> Ranges;
+    GetRanges(Ranges);
+    Viewer->SetRanges(Ranges);
+
+    /* Same levels and cells, only the cuts move, nothing is rebucketed */
+    Relevancy->SetRanges(Ranges);
+    PayloadLayers->SetRanges(Ranges);
+
+    Viewer->Invalidate();
+    return true;
+}
+
+int64 UQuadTree::GetRequiredHeightTileMemory() const
+{
+    const auto SampleCount = (int64)HeightTileResolution + 1;
+    return RequiredHeightTileCount * (SampleCount * SampleCount * sizeof(float) + sizeof(FQuadTreeHeightTile));
+}
+
+bool UQuadTree::HasPendingWork() const
+{
+    return DirtyRegions.Num() > 0 || bShadowViewsDirty || (HeightAtlas.IsValid() && !bHeightAtlasComplete) || PayloadLayers->IsDirty();
+}
+
+void UQuadTree::SetShadowView(const int32 Index, const FConvexVolume& WorldFrustum, const int32 LevelBias)
+{
+    check(Index >= 0 && Index < FQuadTreeShadowView::MaxViews);
+    check(Index <= ShadowViews.Num()); // Views are contiguous
+
+    const auto ClampedLevelBias = (uint8)FMath::Clamp(LevelBias, 0, FMath::Max(LevelCount - 1, 0));
+    if (Index == ShadowViews.Num())
+        ShadowViews.Emplace(WorldFrustum, ClampedLevelBias);
+    else
+        ShadowViews[Index] = FQuadTreeShadowView(WorldFrustum, ClampedLevelBias);
+
+    bShadowViewsDirty = true;
+}
+
+void UQuadTree::ClearShadowViews()
+{
+    if (ShadowViews.Num() == 0)
+        return;
+
+    ShadowViews.Reset();
+    for (auto& Leaves : ShadowLeaves)
+        Leaves.Reset();
+
+    bShadowViewsDirty = true;
+}
+
 void UQuadTree::Draw(const UWorld* World)
 {
     check(World);
 
+    if (DebugView != EQuadTreeDebugView::Immediate)
+    {
+        DrawBatched(World);
+        return;
+    }
+
+#if !UE_BUILD_SHIPPING
+    if (DebugBatcher != nullptr && DebugDrawState.View != EQuadTreeDebugView::Immediate)
+    {
+        DebugBatcher->Flush();
+        DebugDrawState = FDebugDrawState();
+    }
+#endif
+
     Viewer->Draw(World);
-    Root.Draw(World);
+
+    if (!Core.IsValid())
+    {
+        ForEachRoot([World, this](FQuadTreeNode& Node) { Node.Draw(World, Grid); });
+        return;
+    }
+
+#if !UE_BUILD_SHIPPING
+    /* Compact nodes aren't objects, draw the leaves instead */
+    for (auto& Leaf : SelectedLeaves)
+    {
+        auto HalfSize = (1 << Leaf.Level) * Grid.CellSize * 0.5f;
+        auto Center = Grid.ToWorld(Leaf.Coordinates) + FVector(HalfSize, HalfSize, Leaf.Level * 100.0f);
+        DrawDebugBox(World, Center, FVector(HalfSize, HalfSize, 0.0f), FQuat::Identity, FColor::Red);
+    }
+#endif
+}
+
+void UQuadTree::DrawBatched(const UWorld* World)
+{
+#if !UE_BUILD_SHIPPING
+    /* Owned like UWorld's own line batchers, registered to whichever world is drawn into */
+    if (DebugBatcher == nullptr || DebugBatcher->GetWorld() != World)
+    {
+        if (DebugBatcher != nullptr && DebugBatcher->IsRegistered())
+            DebugBatcher->DestroyComponent();
+
+        auto* MutableWorld = const_cast<UWorld*>(World);
+        DebugBatcher = NewObject<ULineBatchComponent>(MutableWorld);
+        DebugBatcher->bCalculateAccurateBounds = false;
+        DebugBatcher->RegisterComponentWithWorld(MutableWorld);
+        DebugDrawState = FDebugDrawState();
+    }
+
+    FDebugDrawState State;
+    State.View = DebugView;
+    State.SelectionRevision = SelectionRevision;
+    State.ViewerCell = Viewer->GetCell();
+    State.Origin = Grid.Origin;
+
+    /* Changes as tiles land */
+    if (DebugView == EQuadTreeDebugView::Streaming && HeightCache.IsValid())
+        State.StreamingState = ((uint64)HeightCache->Num() << 32) | (uint32)HeightCache->GetPendingCount();
+
+    if (State == DebugDrawState)
+        return;
+
+    const auto bSelectionChanged = State.SelectionRevision != DebugDrawState.SelectionRevision || State.View != DebugDrawState.View;
+    DebugDrawState = State;
+
+    if (DebugView != EQuadTreeDebugView::UpdateCost)
+    {
+        DebugLeafRevisions.Empty();
+    }
+    else if (bSelectionChanged)
+    {
+        TMap<FQuadTreeNodeKey, uint32> LeafRevisions;
+        LeafRevisions.Reserve(SelectedLeaves.Num());
+        for (auto& Leaf : SelectedLeaves)
+        {
+            const auto* Revision = DebugLeafRevisions.Find(Leaf.Key);
+            LeafRevisions.Add(Leaf.Key, Revision != nullptr ? *Revision : SelectionRevision);
+        }
+
+        DebugLeafRevisions = MoveTemp(LeafRevisions);
+    }
+
+    const auto TopLevel = (float)FMath::Max(LevelCount - 1, 1);
+    auto Heat = [this, TopLevel](const FQuadTreeLeaf& Leaf) -> float
+    {
+        switch (DebugView)
+        {
+        case EQuadTreeDebugView::Level:
+            return Leaf.Level / TopLevel;
+
+        case EQuadTreeDebugView::Error:
+            return Leaf.HeightBounds.Size() / (float)(Grid.CellSize << Leaf.Level);
+
+        case EQuadTreeDebugView::Streaming:
+            return HeightCache.IsValid() && !HeightCache->Find(Leaf.Key).IsValid() ? 1.0f : 0.0f;
+
+        case EQuadTreeDebugView::UpdateCost:
+        {
+            /* Hot when just selected, cold after HeatSteps reselections */
+            const auto Age = SelectionRevision - DebugLeafRevisions.FindRef(Leaf.Key);
+            return 1.0f - (float)Age / FQuadTreeDebugDraw::HeatSteps;
+        }
+
+        default:
+            return 0.0f;
+        }
+    };
+
+    FQuadTreeDebugDraw::Build(*DebugBatcher, Grid, SelectedLeaves, DebugView != EQuadTreeDebugView::Outlines, Heat);
+
+    /* Drawn from the viewer's location when last rebuilt, so they only follow it cell by cell */
+    TArray<float> Ranges;
+    Ranges.Reserve(LevelCount);
+    for (uint8 Level = 0; Level < LevelCount; Level++)
+        Ranges.Add(Viewer->GetRange(Level).SphereRadius);
+
+    FQuadTreeDebugDraw::AddRanges(*DebugBatcher, Viewer->GetLocation(), Ranges);
+#endif
+}
+
+void UQuadTree::ForEachRoot(TFunctionRef<void(FQuadTreeNode&)> Func)
+{
+    if (Core.IsValid() || Clipmap.IsValid())
+        return;
+
+    if (!bTiled)
+    {
+        Func(Root);
+        return;
+    }
+
+    for (auto& KVP : Tiles)
+        Func(*KVP.Value);
+}
+
+void UQuadTree::GatherSelectedLeaves()
+{
+    SelectedLeaves.Reset();
+    SelectionRevision++;
+
+    if (Core.IsValid() || Clipmap.IsValid())
+    {
+        auto AddLeaf = [this](const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds)
+        {
+            auto Level = Key.GetLevel();
+            SelectedLeaves.Emplace(Key, Key.GetCoordinates(), HeightBounds, Level, Viewer->GetMorphRange(Level, MorphStartRatio));
+        };
+
+        if (Core.IsValid())
+            Core->ForEachSelectedLeaf(AddLeaf);
+        else
+            Clipmap->ForEachLeaf(AddLeaf);
+    }
+    else
+    {
+        ForEachRoot([this](FQuadTreeNode& TreeRoot) 
+        {
+            TreeRoot.ForEachSelectedLeaf([this](const FQuadTreeNode& Node) 
+            {
+                auto Level = Node.GetLevel();
+                SelectedLeaves.Emplace(Node.GetKey(), Node.GetCoordinates(), Node.GetHeightBounds(), Level, Viewer->GetMorphRange(Level, MorphStartRatio));
+            });
+        });
+    }
+
+    for (auto View = 0; View < ShadowViews.Num(); View++)
+    {
+        auto& Leaves = ShadowLeaves[View];
+        const auto LevelBias = ShadowViews[View].LevelBias;
+        Leaves.Reset();
+
+        /* Biased level, so morphing matches the shrunken ranges */
+        auto AddLeaf = [this, &Leaves, LevelBias](const FQuadTreeNodeKey Key, const FIntPoint& Coordinates, const FFloatInterval& HeightBounds, const uint8 Level)
+        {
+            Leaves.Emplace(Key, Coordinates, HeightBounds, Level, Viewer->GetMorphRange(Level - LevelBias, MorphStartRatio));
+        };
+
+        if (Core.IsValid())
+        {
+            Core->ForEachShadowLeaf(View, [&AddLeaf](const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds)
+            {
+                AddLeaf(Key, Key.GetCoordinates(), HeightBounds, Key.GetLevel());
+            });
+            continue;
+        }
+
+        ForEachRoot([View, &AddLeaf](FQuadTreeNode& TreeRoot)
+        {
+            TreeRoot.ForEachShadowLeaf(View, [&AddLeaf](const FQuadTreeNode& Node)
+            {
+                AddLeaf(Node.GetKey(), Node.GetCoordinates(), Node.GetHeightBounds(), Node.GetLevel());
+            });
+        });
+    }
+}
+
+void UQuadTree::ApplyClipmapChanges()
+{
+    SelectionRevision++;
+
+    /* Same removes and appends as the clipmap's leaf list, so both stay in the same order */
+    Clipmap->ApplyLeafChanges<FQuadTreeLeaf>(SelectedLeaves, [this](const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds)
+    {
+        const auto Level = Key.GetLevel();
+        return FQuadTreeLeaf(Key, Key.GetCoordinates(), HeightBounds, Level, Viewer->GetMorphRange(Level, MorphStartRatio));
+    });
+}
+
+void UQuadTree::RequestHeightTiles()
+{
+    if (!HeightCache.IsValid())
+        return;
+
+    HeightCache->BeginSelection();
+    for (auto& Leaf : SelectedLeaves)
+        HeightCache->Request(Leaf.Key);
+
+    RequiredHeightTileCount = SelectedLeaves.Num();
+    for (auto& Leaves : ShadowLeaves)
+    {
+        for (auto& Leaf : Leaves)
+            HeightCache->Request(Leaf.Key);
+
+        RequiredHeightTileCount += Leaves.Num();
+    }
+
+    /* Retained tiles beyond the selection give way first under quady.StreamingMemoryMB */
+    auto MaxTiles = SelectedLeaves.Num() + MaxCachedHeightTiles;
+    const auto StreamingMemory = FQuadyScalability::GetStreamingMemory();
+    if (StreamingMemory > 0 && RequiredHeightTileCount > 0)
+    {
+        const auto TileMemory = GetRequiredHeightTileMemory() / RequiredHeightTileCount;
+        MaxTiles = FMath::Min(MaxTiles, (int32)FMath::Max<int64>(StreamingMemory / TileMemory, SelectedLeaves.Num()));
+    }
+
+    HeightCache->Trim(MaxTiles);
+}
+
+void UQuadTree::MarkDirty(const FBox2D& WorldRect)
+{
+    FIntPoint MinCell, MaxCell;
+    FVector Offset;
+    Grid.ToCell(FVector(WorldRect.Min, 0.0f), MinCell, Offset);
+    Grid.ToCell(FVector(WorldRect.Max, 0.0f), MaxCell, Offset);
+
+    const auto Cells = FIntRect(MinCell, MaxCell + FIntPoint(1, 1));
+
+    /* Every level's nodes over the edit, proportional to its area */
+    if (HeightCache.IsValid())
+        for (uint8 Level = 0; Level < LevelCount; Level++)
+        {
+            const auto Size = 1 << Level;
+            for (auto Y = FQuadTreeGrid::FloorDivide(Cells.Min.Y, Size); Y <= FQuadTreeGrid::FloorDivide(Cells.Max.Y - 1, Size); Y++)
+                for (auto X = FQuadTreeGrid::FloorDivide(Cells.Min.X, Size); X <= FQuadTreeGrid::FloorDivide(Cells.Max.X - 1, Size); X++)
+                {
+                    const auto Key = FQuadTreeNodeKey(FIntPoint(X * Size, Y * Size), Level);
+                    HeightCache->Invalidate(Key);
+
+                    if (HeightAtlas.IsValid())
+                        HeightAtlas->Invalidate(Key);
+                }
+        }
+
+    bHeightAtlasComplete = false;
+
+    DirtyRegions.Add(Cells);
+}
+
+void UQuadTree::SetNodeHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds)
+{
+    if (!RefitHeightBounds(Key, HeightBounds))
+        return;
+
+    const auto Coordinates = Key.GetCoordinates();
+    DirtyRegions.Add(FIntRect(Coordinates, Coordinates + FIntPoint(1 << Key.GetLevel(), 1 << Key.GetLevel())));
+}
+
+bool UQuadTree::RefitHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds)
+{
+    if (Clipmap.IsValid())
+    {
+        if (!Clipmap->SetHeightBounds(Key, HeightBounds))
+            return false;
+
+        /* The selection mirrors the clipmap's leaf list */
+        const auto LeafIndex = Clipmap->FindLeaf(Key);
+        if (LeafIndex != INDEX_NONE)
+            SelectedLeaves[LeafIndex].HeightBounds = HeightBounds;
+
+        return true;
+    }
+
+    if (Core.IsValid())
+        return Core->RefitHeightBounds(Key, HeightBounds);
+
+    if (!bTiled)
+        return Root.RefitHeightBounds(Key, HeightBounds);
+
+    const auto TileCells = GetTileSizeInCells();
+    const auto Coordinates = Key.GetCoordinates();
+    const auto* Tile = Tiles.Find(FIntPoint(FQuadTreeGrid::FloorDivide(Coordinates.X, TileCells), FQuadTreeGrid::FloorDivide(Coordinates.Y, TileCells)));
+
+    return Tile != nullptr && (*Tile)->RefitHeightBounds(Key, HeightBounds);
+}
+
+void UQuadTree::ResetDescendantHeightBounds(const FQuadTreeNodeKey Key, const FIntRect& Cells)
+{
+    /* Clipmap leaves have no descendants, its hole tiles are reset once per edit */
+    if (Clipmap.IsValid())
+        return;
+
+    if (Core.IsValid())
+    {
+        Core->ResetDescendantHeightBounds(Key, Cells);
+        return;
+    }
+
+    if (!bTiled)
+    {
+        Root.ResetDescendantHeightBounds(Key, Cells, Grid.CellSize);
+        return;
+    }
+
+    const auto TileCells = GetTileSizeInCells();
+    const auto Coordinates = Key.GetCoordinates();
+    const auto* Tile = Tiles.Find(FIntPoint(FQuadTreeGrid::FloorDivide(Coordinates.X, TileCells), FQuadTreeGrid::FloorDivide(Coordinates.Y, TileCells)));
+    if (Tile != nullptr)
+        (*Tile)->ResetDescendantHeightBounds(Key, Cells, Grid.CellSize);
+}
+
+FFloatInterval UQuadTree::GetNodeHeightBounds(const FQuadTreeNodeKey Key) const
+{
+    FFloatInterval HeightBounds;
+    if (Core.IsValid())
+    {
+        if (Core->GetHeightBounds(Key, HeightBounds))
+            return HeightBounds;
+    }
+    else if (!Clipmap.IsValid())
+    {
+        const auto TileCells = GetTileSizeInCells();
+        const auto Coordinates = Key.GetCoordinates();
+        const auto* Tile = bTiled ? Tiles.Find(FIntPoint(FQuadTreeGrid::FloorDivide(Coordinates.X, TileCells), FQuadTreeGrid::FloorDivide(Coordinates.Y, TileCells))) : nullptr;
+        const auto* Node = bTiled ? (Tile != nullptr ? Tile->Get() : nullptr) : &Root;
+
+        if (Node != nullptr && Node->FindHeightBounds(Key, HeightBounds))
+            return HeightBounds;
+    }
+
+    const auto HalfSize = (float)(Grid.CellSize << Key.GetLevel()) * 0.5f;
+    return FFloatInterval(-HalfSize, HalfSize);
+}
+
+bool UQuadTree::UpdateDirtyRegions()
+{
+    auto bReselected = false;
+    for (auto Index = DirtyRegions.Num() - 1; Index >= 0; Index--)
+    {
+        const auto Cells = DirtyRegions[Index];
+        auto LeafIntersects = [&Cells](const FQuadTreeLeaf& Leaf)
+        {
+            const auto Size = 1 << Leaf.Level;
+            return Leaf.Coordinates.X < Cells.Max.X && Leaf.Coordinates.X + Size > Cells.Min.X
+                && Leaf.Coordinates.Y < Cells.Max.Y && Leaf.Coordinates.Y + Size > Cells.Min.Y;
+        };
+
+        if (HeightCache.IsValid())
+        {
+            /* Wait for all of the edit's regenerated tiles so its bounds are refit once */
+            auto bIsReady = true;
+            for (auto& Leaf : SelectedLeaves)
+                if (LeafIntersects(Leaf) && !HeightCache->Find(Leaf.Key).IsValid())
+                {
+                    HeightCache->Request(Leaf.Key);
+                    bIsReady = false;
+                }
+
+            if (!bIsReady)
+                continue;
+
+            /* Unselected descendants would keep their pre-edit bounds and be selected with them, they go back to the unrefit cube */
+            for (auto& Leaf : SelectedLeaves)
+                if (LeafIntersects(Leaf))
+                {
+                    ResetDescendantHeightBounds(Leaf.Key, Cells);
+                    RefitHeightBounds(Leaf.Key, HeightCache->Find(Leaf.Key)->HeightBounds);
+                }
+
+            if (Clipmap.IsValid())
+                Clipmap->ResetHoleHeightBounds(Cells);
+        }
+
+        /* Clipmap rings don't depend on bounds, only the refit leaves are gathered again */
+        if (Core.IsValid())
+            Core->Reselect(*Viewer, Cells);
+        else
+            ForEachRoot([this, &Cells](FQuadTreeNode& Node) { Node.Reselect(Viewer, Cells); });
+
+        DirtyRegions.RemoveAtSwap(Index, 1, false);
+        bReselected = true;
+    }
+
+    return bReselected;
+}
+
+TSharedPtr<const FQuadTreeHeightTile, ESPMode::ThreadSafe> UQuadTree::FindHeightTile(const FQuadTreeNodeKey Key) const
+{
+    return HeightCache.IsValid() ? HeightCache->Find(Key) : nullptr;
+}
+
+bool UQuadTree::GetHeightAtlasUVScaleBias(const FQuadTreeNodeKey Key, FVector4& OutUVScaleBias) const
+{
+    const auto Slot = HeightAtlas.IsValid() ? HeightAtlas->Find(Key) : INDEX_NONE;
+    if (Slot == INDEX_NONE)
+        return false;
+
+    OutUVScaleBias = HeightAtlas->GetUVScaleBias(Slot);
+    return true;
+}
+
+void UQuadTree::UpdateHeightAtlas()
+{
+    if (!HeightAtlas.IsValid() || (bHeightAtlasComplete && HeightAtlasRevision == SelectionRevision))
+        return;
+
+    HeightAtlasRevision = SelectionRevision;
+    bHeightAtlasComplete = true;
+    HeightAtlas->BeginFrame();
+
+    const auto SlotSize = HeightAtlas->GetSlotSize();
+    FMemMark Mark(FMemStack::Get());
+
+    /* Newly allocated slots, packed on workers once every slot is queued */
+    TArray<TPair<int32, FQuadTreeHeightNeighborhood>, TMemStackAllocator<>> Packs;
+
+    auto UnplacedCount = 0;
+    auto MakeResident = [this, &Packs, &UnplacedCount](const FQuadTreeLeaf& Leaf)
+    {
+        /* Resident slots are kept even while their tile is out of the cache */
+        const auto Tile = HeightCache->Find(Leaf.Key);
+        if (!Tile.IsValid() && HeightAtlas->Find(Leaf.Key) == INDEX_NONE)
+        {
+            bHeightAtlasComplete = false;
+            return;
+        }
+
+        bool bAllocated;
+        const auto Slot = HeightAtlas->Acquire(Leaf.Key, bAllocated);
+        if (Slot == INDEX_NONE)
+        {
+            UnplacedCount++;
+            return;
+        }
+
+        if (bAllocated)
+        {
+            HeightAtlas->QueueUpload(Slot);
+            Packs.Emplace(Slot, FQuadTreeHeightNormals::Gather(*HeightCache, Tile));
+        }
+    };
+
+    for (auto& Leaf : SelectedLeaves)
+        MakeResident(Leaf);
+
+    for (auto View = 0; View < ShadowViews.Num(); View++)
+        for (auto& Leaf : ShadowLeaves[View])
+            MakeResident(Leaf);
+
+    /* Straight into the staging image */
+    ParallelFor(Packs.Num(), [this, &Packs](const int32 Index)
+    {
+        FQuadTreeHeightNormals::PackTexels(Packs[Index].Value, HeightAtlasZScale, HeightAtlas->GetQueuedTexels(Packs[Index].Key));
+    });
+
+    /* Once per Build, the stat shows whether it still is */
+    SET_DWORD_STAT(STAT_QuadTreeAtlasUnplacedLeaves, UnplacedCount);
+    if (UnplacedCount > 0 && !bWarnedHeightAtlasFull)
+    {
+        UE_LOG(LogQuady, Warning, TEXT("Height atlas is full, increase HeightAtlasSlotsPerSide (%d slots, %d leaves unplaced)"), HeightAtlas->GetSlotCount(), UnplacedCount);
+        bWarnedHeightAtlasFull = true;
+    }
+
+    /* Nothing was queued, don't hold an upload for it */
+    if (Packs.Num() == 0)
+        return;
+
+    /* Usually one or two, another only while the render thread is behind */
+    auto* FreeUpload = HeightAtlasUploads.FindByPredicate([](const TSharedPtr<FQuadTreeHeightAtlasUpload, ESPMode::ThreadSafe>& Upload) { return !Upload->bInFlight; });
+    const auto Upload = FreeUpload != nullptr ? *FreeUpload : HeightAtlasUploads[HeightAtlasUploads.Add(MakeShared<FQuadTreeHeightAtlasUpload, ESPMode::ThreadSafe>())];
+
+    /* The atlas stages the next frame into the upload's previous image */
+    if (!HeightAtlas->TakeUploads(Upload->Staging, Upload->Regions))
+        return;
+
+    if (HeightAtlasTexture == nullptr)
+    {
+        const auto TextureSize = HeightAtlas->GetTextureSize();
+        HeightAtlasTexture = UTexture2D::CreateTransient(TextureSize, TextureSize, PF_B8G8R8A8);
+        HeightAtlasTexture->SRGB = false;
+        HeightAtlasTexture->Filter = TF_Bilinear;
+        HeightAtlasTexture->AddressX = TA_Clamp;
+        HeightAtlasTexture->AddressY = TA_Clamp;
+        HeightAtlasTexture->NeverStream = true;
+        HeightAtlasTexture->UpdateResource();
+    }
+
+    /* One render command for the whole frame, the upload is reused once the render thread has copied it */
+    Upload->UpdateRegions.Reset(Upload->Regions.Num());
+    for (auto& Region : Upload->Regions)
+        Upload->UpdateRegions.Emplace(Region.Destination.X, Region.Destination.Y, 0, Region.SourceY, SlotSize, SlotSize);
+
+    Upload->bInFlight = true;
+    HeightAtlasTexture->UpdateTextureRegions(0, Upload->UpdateRegions.Num(), Upload->UpdateRegions.GetData(), SlotSize * sizeof(FColor), sizeof(FColor), (uint8*)Upload->Staging.GetData(),
+        [Upload](uint8* SrcData, const FUpdateTextureRegion2D* UploadedRegions)
+        {
+            Upload->bInFlight = false;
+        });
+}
+
+FGraphEventRef UQuadTree::BeginOcclusion(const float EyeHeight)
+{
+    if (!Occlusion.IsValid())
+        Occlusion = MakeShared<FQuadTreeOcclusionBuffer>();
+
+    const auto& CellOffset = Viewer->GetCellOffset();
+    const auto EyeLocation = FVector(CellOffset.X, CellOffset.Y, EyeHeight);
+
+    if (FQuadyScalability::ShouldRunInline())
+    {
+        RasterizeOccluders(*Occlusion, *Viewer, SelectedLeaves, EyeLocation, OccluderCount);
+        return FGraphEventRef();
+    }
+
+    /* Viewer and leaves are only read until the task is waited on, before leaves are gathered again */
+    return TGraphTask<FQuadTreeOcclusionTask>::CreateTask().ConstructAndDispatchWhenReady(Occlusion.Get(), Viewer.Get(), &SelectedLeaves, EyeLocation, OccluderCount);
+}
+
+bool UQuadTree::UpdateTiles()
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeTiles);
+
+    const auto TileCells = GetTileSizeInCells();
+    const auto TileSize = (float)TileCells * Grid.CellSize;
+    const auto Range = Viewer->GetRange(LevelCount - 1).SphereRadius;
+    const auto RangeCells = FMath::CeilToInt(Range / Grid.CellSize);
+
+    /* Few tiles per view, a linear AddUnique beats hashing and stays in the frame arena */
+    TArray<FIntPoint, TMemStackAllocator<>> RequiredTiles;
+    for (auto& ViewLocation : PreviousViewLocations)
+    {
+        FIntPoint Cell;
+        FVector CellOffset;
+        Grid.ToCell(ViewLocation.Origin, Cell, CellOffset);
+
+        const auto MinTile = FIntPoint(FQuadTreeGrid::FloorDivide(Cell.X - RangeCells, TileCells), FQuadTreeGrid::FloorDivide(Cell.Y - RangeCells, TileCells));
+        const auto MaxTile = FIntPoint(FQuadTreeGrid::FloorDivide(Cell.X + RangeCells, TileCells), FQuadTreeGrid::FloorDivide(Cell.Y + RangeCells, TileCells));
+        const auto RangeSphere = FSphere(CellOffset, Range);
+
+        for (auto Y = MinTile.Y; Y <= MaxTile.Y; Y++)
+            for (auto X = MinTile.X; X <= MaxTile.X; X++)
+            {
+                /* Relative to the views cell, same as node selection */
+                const auto Relative = FIntPoint(X * TileCells, Y * TileCells) - Cell;
+                const auto Min = FVector(Relative.X * (float)Grid.CellSize, Relative.Y * (float)Grid.CellSize, CellOffset.Z);
+                const auto TileBounds = FBox(Min, FVector(Min.X + TileSize, Min.Y + TileSize, CellOffset.Z));
+
+                if (FMath::SphereAABBIntersection(RangeSphere, TileBounds))
+                    RequiredTiles.AddUnique(FIntPoint(X, Y));
+            }
+    }
+
+    TArray<FIntPoint, TMemStackAllocator<>> ReleasedTiles;
+    for (auto& KVP : Tiles)
+        if (!RequiredTiles.Contains(KVP.Key))
+            ReleasedTiles.Add(KVP.Key);
+
+    for (auto& TileCoordinates : ReleasedTiles)
+        ReleaseTile(TileCoordinates);
+
+    auto bAcquiredAny = false;
+    for (auto& TileCoordinates : RequiredTiles)
+    {
+        if (Tiles.Contains(TileCoordinates))
+            continue;
+
+        AcquireTile(TileCoordinates);
+        bAcquiredAny = true;
+    }
+
+    SET_DWORD_STAT(STAT_QuadTreeResidentTiles, Tiles.Num());
+
+    return bAcquiredAny;
+}
+
+void UQuadTree::AcquireTile(const FIntPoint& TileCoordinates)
+{
+    const auto Coordinates = TileCoordinates * GetTileSizeInCells();
+    const auto HalfSize = MaximumQuadSize * 0.5f;
+    const auto HeightBounds = FFloatInterval(-HalfSize, HalfSize);
+
+    TSharedPtr<FQuadTreeNode> Tile;
+    if (TilePool.Num() > 0)
+    {
+        /* Re-keys the whole subtree, no allocations */
+        Tile = TilePool.Pop(false);
+        Tile->Reset(Coordinates, HeightBounds);
+    }
+    else
+    {
+        Tile = MakeShared<FQuadTreeNode>(EQuadrant::None, Coordinates, LevelCount - 1, HeightBounds);
+    }
+
+    Tiles.Add(TileCoordinates, Tile);
+}
+
+void UQuadTree::ReleaseTile(const FIntPoint& TileCoordinates)
+{
+    TSharedPtr<FQuadTreeNode> Tile;
+    if (!Tiles.RemoveAndCopyValue(TileCoordinates, Tile))
+        return;
+
+    Tile->SetSelected(false, true);
+    TilePool.Push(Tile);
+}
+
+void UQuadTree::ApplyWorldOffset(const FVector& InOffset, bool bWorldShift)
+{
+    if (!bFloatingOrigin)
+        return;
+
+    /* Nodes are in grid cells, only the origin moves */
+    Grid.Rebase(InOffset);
+    Viewer->ApplyWorldOffset(InOffset);
+
+    for (auto& ViewLocation : PreviousViewLocations)
+        ViewLocation.Origin += InOffset;
+
+#if WITH_EDITOR
+    PrevousViewLocation += InOffset;
+#endif
+}
+
+bool UQuadTree::SerializeSnapshot(FArchive& Ar)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeSnapshot);
+
+    auto Magic = QuadTreeSnapshot::Magic;
+    auto Version = QuadTreeSnapshot::Version;
+    Ar << Magic;
+    Ar << Version;
+
+    if (Ar.IsLoading() && (Magic != QuadTreeSnapshot::Magic || Version != QuadTreeSnapshot::Version))
+    {
+        UE_LOG(LogQuady, Warning, TEXT("QuadTree snapshot has an unknown format (version %d)"), Version);
+        return false;
+    }
+
+    auto SnapshotMinimumQuadSize = MinimumQuadSize;
+    auto SnapshotMaximumQuadSize = MaximumQuadSize;
+    auto bSnapshotTiled = bTiled;
+    auto bSnapshotCompactNodes = bCompactNodes;
+    auto bSnapshotClipmap = bClipmap;
+    Ar << SnapshotMinimumQuadSize;
+    Ar << SnapshotMaximumQuadSize;
+    Ar << bSnapshotTiled;
+    Ar << bSnapshotCompactNodes;
+    Ar << bSnapshotClipmap;
+
+    if (Ar.IsLoading() && (SnapshotMinimumQuadSize != MinimumQuadSize 
+        || SnapshotMaximumQuadSize != MaximumQuadSize 
+        || bSnapshotTiled != bTiled 
+        || bSnapshotCompactNodes != bCompactNodes
+        || bSnapshotClipmap != bClipmap))
+    {
+        if (SnapshotMinimumQuadSize <= 0 
+            || SnapshotMaximumQuadSize <= SnapshotMinimumQuadSize 
+            || SnapshotMaximumQuadSize % SnapshotMinimumQuadSize != 0)
+        {
+            UE_LOG(LogQuady, Warning, TEXT("QuadTree snapshot has invalid quad sizes (%d, %d)"), SnapshotMinimumQuadSize, SnapshotMaximumQuadSize);
+            return false;
+        }
+
+        /* Snapshot wins, the tree must match it node for node */
+        MinimumQuadSize = SnapshotMinimumQuadSize;
+        MaximumQuadSize = SnapshotMaximumQuadSize;
+        bTiled = bSnapshotTiled;
+        bCompactNodes = bSnapshotCompactNodes;
+        bClipmap = bSnapshotClipmap;
+        Build();
+    }
+
+    Ar << *Viewer;
+
+    /* Layer cuts aren't saved, reselected for the restored viewer on the next Update */
+    if (Ar.IsLoading())
+        PayloadLayers->Invalidate();
+
+    /* Rings follow from the viewer alone, placing them is as cheap as restoring them */
+    if (Clipmap.IsValid())
+    {
+        if (Ar.IsLoading() && !Ar.IsError())
+        {
+            Clipmap->Update(Viewer->GetCell());
+            GatherSelectedLeaves();
+            Viewer->PostSelect();
+        }
+
+        return !Ar.IsError();
+    }
+
+    if (Core.IsValid())
+    {
+        if (!Core->Serialize(Ar))
+        {
+            UE_LOG(LogQuady, Warning, TEXT("QuadTree snapshot doesn't match compact tree (%d nodes)"), Core->GetNodeCount());
+            if (Ar.IsLoading())
+                Build();
+
+            return false;
+        }
+
+        if (Ar.IsLoading())
+        {
+            GatherSelectedLeaves();
+            Viewer->PostSelect();
+
+            /* Shadow cuts aren't saved */
+            bShadowViewsDirty |= ShadowViews.Num() > 0;
+        }
+
+        return true;
+    }
+
+    /* Tiles are written in an explicit order, map order isn't stable between sessions */
+    TArray<FIntPoint> TileCoordinates;
+    if (Ar.IsSaving())
+        Tiles.GetKeys(TileCoordinates);
+
+    Ar << TileCoordinates;
+
+    if (Ar.IsLoading() && bTiled)
+    {
+        TArray<FIntPoint> ResidentTiles;
+        Tiles.GetKeys(ResidentTiles);
+        for (auto& Tile : ResidentTiles)
+            ReleaseTile(Tile);
+
+        for (auto& Tile : TileCoordinates)
+            AcquireTile(Tile);
+    }
+
+    TArray<FQuadTreeNode*> Roots;
+    if (bTiled)
+    {
+        for (auto& Tile : TileCoordinates)
+            if (auto* Node = Tiles.Find(Tile))
+                Roots.Add(Node->Get());
+    }
+    else
+    {
+        Roots.Add(&Root);
+    }
+
+    auto ForEachSnapshotNode = [&Roots](TFunctionRef<void(FQuadTreeNode&)> Func)
+    {
+        for (auto* Node : Roots)
+            Node->ForEachNode(Func);
+    };
+
+    auto NodeCount = 0;
+    ForEachSnapshotNode([&NodeCount](FQuadTreeNode& Node) { NodeCount++; });
+
+    TBitArray<> Selection;
+    TArray<FFloatInterval> HeightBounds;
+    TArray<FQuadTreeNodeKey> SelectedLeafKeys;
+    if (Ar.IsSaving())
+    {
+        Selection.Reserve(NodeCount);
+        HeightBounds.Reserve(NodeCount);
+        ForEachSnapshotNode([&](FQuadTreeNode& Node) 
+        {
+            Selection.Add(Node.IsSelected());
+            HeightBounds.Add(Node.GetHeightBounds());
+            if (Node.IsSelectedLeaf())
+                SelectedLeafKeys.Add(Node.GetKey());
+        });
+    }
+
+    Ar << Selection;
+    Ar << HeightBounds;
+    Ar << SelectedLeafKeys;
+
+    if (!Ar.IsLoading())
+        return !Ar.IsError();
+
+    if (Ar.IsError() || Selection.Num() != NodeCount || HeightBounds.Num() != NodeCount)
+    {
+        UE_LOG(LogQuady, Warning, TEXT("QuadTree snapshot doesn't match tree (%d nodes, expected %d)"), Selection.Num(), NodeCount);
+        return false;
+    }
+
+    auto Index = 0;
+    auto RestoredLeafCount = 0;
+    auto bKeysMatch = true;
+    TSet<FQuadTreeNodeKey> ExpectedLeafKeys(SelectedLeafKeys);
+    ForEachSnapshotNode([&](FQuadTreeNode& Node) 
+    {
+        Node.SetSelected(Selection[Index]);
+        Node.SetHeightBounds(HeightBounds[Index]);
+        Node.ClearShadowMask();
+        Index++;
+    });
+
+    ForEachSnapshotNode([&](FQuadTreeNode& Node)
+    {
+        if (!Node.IsSelectedLeaf())
+            return;
+
+        RestoredLeafCount++;
+        bKeysMatch &= ExpectedLeafKeys.Contains(Node.GetKey());
+    });
+
+    if (!bKeysMatch || RestoredLeafCount != ExpectedLeafKeys.Num())
+    {
+        UE_LOG(LogQuady, Warning, TEXT("QuadTree snapshot selection doesn't match its leaf keys, rebuilding"));
+
+        /* Cold start, next Update will reselect */
+        Viewer = MakeShared<FQuadTreeViewer>();
+        Build();
+        return false;
+    }
+
+    /* Selection is current for the restored viewer */
+    GatherSelectedLeaves();
+    Viewer->PostSelect();
+
+    /* Shadow cuts aren't saved */
+    bShadowViewsDirty |= ShadowViews.Num() > 0;
+
+    return true;
+}
+
+bool UQuadTree::SaveSnapshot(const FString& Filename)
+{
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Filename));
+    if (!Writer.IsValid())
+        return false;
+
+    auto bResult = SerializeSnapshot(*Writer);
+    return Writer->Close() && bResult;
+}
+
+bool UQuadTree::LoadSnapshot(const FString& Filename)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename));
+    if (!Reader.IsValid())
+        return false;
+
+    return SerializeSnapshot(*Reader);
 }
 
 #undef LOCTEXT_NAMESPACE
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "QuadTreeClipmap.h"
+
+#include "Quady.h"
+#include "QuadTreeGrid.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Clipmap"), STAT_QuadTreeClipmap, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Clipmap Tiles Updated"), STAT_QuadTreeClipmapTilesUpdated, STATGROUP_Quady);
+
+void FQuadTreeClipmap::Build(const uint8 LevelCount, const int32 CellSize, const TArray<float>& Ranges)
+{
+    check(LevelCount > 0 && Ranges.Num() >= LevelCount);
+
+    this->CellSize = CellSize;
+    UpdatedTileCount = 0;
+
+    Leaves.Reset();
+    LeafChanges.Reset();
+    Rings.Reset();
+    Rings.SetNum(LevelCount);
+
+    /* Next level nodes on each side of the viewer's. Never under half the finer ring's, so rings nest */
+    auto Half = 1;
+    for (uint8 Level = 0; Level < LevelCount; Level++)
+    {
+        const auto NodeSize = (float)(CellSize << (Level + 1));
+        Half = FMath::Max3(1, FMath::CeilToInt(Ranges[Level] / NodeSize), (Half + 1) / 2);
+
+        auto& Ring = Rings[Level];
+        Ring.Width = (2 * Half + 1) * 2;
+        Ring.Origin = FIntPoint::ZeroValue;
+        Ring.bIsValid = false;
+        Ring.Tiles.SetNum(Ring.Width * Ring.Width);
+    }
+}
+
+bool FQuadTreeClipmap::Update(const FIntPoint& ViewerCell)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeClipmap);
+
+    UpdatedTileCount = 0;
+    LeafChanges.Reset();
+
+    /* Holes move with the finer rings, which are updated first */
+    TArray<FIntRect, TInlineAllocator<32>> PreviousHoles;
+    for (uint8 Level = 0; Level < Rings.Num(); Level++)
+        PreviousHoles.Add(GetHole(Level));
+
+    auto bChanged = false;
+    for (uint8 Level = 0; Level < Rings.Num(); Level++)
+    {
+        auto& Ring = Rings[Level];
+
+        const auto NodeSize = 2 << Level;
+        const auto Half = Ring.Width / 4;
+        const auto Node = FIntPoint(FQuadTreeGrid::FloorDivide(ViewerCell.X, NodeSize), FQuadTreeGrid::FloorDivide(ViewerCell.Y, NodeSize));
+        const auto Origin = (Node - FIntPoint(Half, Half)) * 2;
+        const auto Hole = GetHole(Level);
+        const auto& PreviousHole = PreviousHoles[Level];
+
+        if (Ring.bIsValid && Ring.Origin == Origin && Hole == PreviousHole)
+            continue;
+
+        bChanged = true;
+
+        const auto PreviousRect = Ring.GetRect();
+        const auto bWasValid = Ring.bIsValid;
+        Ring.Origin = Origin;
+        Ring.bIsValid = true;
+
+        const auto Rect = Ring.GetRect();
+        if (!bWasValid)
+        {
+            for (auto Y = Rect.Min.Y; Y < Rect.Max.Y; Y++)
+                for (auto X = Rect.Min.X; X < Rect.Max.X; X++)
+                    WriteTile(Level, FIntPoint(X, Y), Hole);
+
+            continue;
+        }
+
+        /* Strips that scrolled in */
+        for (auto Y = Rect.Min.Y; Y < Rect.Max.Y; Y++)
+        {
+            if (Y < PreviousRect.Min.Y || Y >= PreviousRect.Max.Y)
+            {
+                for (auto X = Rect.Min.X; X < Rect.Max.X; X++)
+                    WriteTile(Level, FIntPoint(X, Y), Hole);
+
+                continue;
+            }
+
+            for (auto X = Rect.Min.X; X < FMath::Min(PreviousRect.Min.X, Rect.Max.X); X++)
+                WriteTile(Level, FIntPoint(X, Y), Hole);
+
+            for (auto X = FMath::Max(PreviousRect.Max.X, Rect.Min.X); X < Rect.Max.X; X++)
+                WriteTile(Level, FIntPoint(X, Y), Hole);
+        }
+
+        /* Kept tiles that entered or left the hole */
+        for (const auto* Area : { &PreviousHole, &Hole })
+        {
+            const auto Min = FIntPoint(FMath::Max3(Area->Min.X, Rect.Min.X, PreviousRect.Min.X), FMath::Max3(Area->Min.Y, Rect.Min.Y, PreviousRect.Min.Y));
+            const auto Max = FIntPoint(FMath::Min3(Area->Max.X, Rect.Max.X, PreviousRect.Max.X), FMath::Min3(Area->Max.Y, Rect.Max.Y, PreviousRect.Max.Y));
+
+            for (auto Y = Min.Y; Y < Max.Y; Y++)
+                for (auto X = Min.X; X < Max.X; X++)
+                    SetLeaf(Level, Ring.GetTileIndex(FIntPoint(X, Y)), !Hole.Contains(FIntPoint(X, Y)));
+        }
+    }
+
+    INC_DWORD_STAT_BY(STAT_QuadTreeClipmapTilesUpdated, UpdatedTileCount);
+
+    return bChanged;
+}
+
+void FQuadTreeClipmap::ForEachLeaf(TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func) const
+{
+    for (auto& Leaf : Leaves)
+    {
+        const auto& Tile = Rings[Leaf.Level].Tiles[Leaf.TileIndex];
+        Func(Tile.Key, Tile.HeightBounds);
+    }
+}
+
+int32 FQuadTreeClipmap::FindLeaf(const FQuadTreeNodeKey Key) const
+{
+    const auto TileIndex = FindTile(Key);
+    return TileIndex != INDEX_NONE ? Rings[Key.GetLevel()].Tiles[TileIndex].LeafIndex : INDEX_NONE;
+}
+
+bool FQuadTreeClipmap::SetHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds)
+{
+    const auto TileIndex = FindTile(Key);
+    if (TileIndex == INDEX_NONE)
+        return false;
+
+    Rings[Key.GetLevel()].Tiles[TileIndex].HeightBounds = HeightBounds;
+    return true;
+}
+
+void FQuadTreeClipmap::ResetHoleHeightBounds(const FIntRect& Cells)
+{
+    for (uint8 Level = 1; Level < Rings.Num(); Level++)
+    {
+        auto& Ring = Rings[Level];
+        if (!Ring.bIsValid)
+            continue;
+
+        const auto Size = 1 << Level;
+        const auto Rect = Ring.GetRect();
+        const auto Min = FIntPoint(FMath::Max(FQuadTreeGrid::FloorDivide(Cells.Min.X, Size), Rect.Min.X), FMath::Max(FQuadTreeGrid::FloorDivide(Cells.Min.Y, Size), Rect.Min.Y));
+        const auto Max = FIntPoint(FMath::Min(FQuadTreeGrid::FloorDivide(Cells.Max.X - 1, Size) + 1, Rect.Max.X), FMath::Min(FQuadTreeGrid::FloorDivide(Cells.Max.Y - 1, Size) + 1, Rect.Max.Y));
+        const auto HalfHeight = (CellSize << Level) * 0.5f;
+
+        for (auto Y = Min.Y; Y < Max.Y; Y++)
+            for (auto X = Min.X; X < Max.X; X++)
+            {
+                auto& Tile = Ring.GetTile(FIntPoint(X, Y));
+                if (Tile.LeafIndex == INDEX_NONE)
+                    Tile.HeightBounds = FFloatInterval(-HalfHeight, HalfHeight);
+            }
+    }
+}
+
+int32 FQuadTreeClipmap::FindTile(const FQuadTreeNodeKey Key) const
+{
+    const auto Level = Key.GetLevel();
+    if (Level >= Rings.Num() || !Rings[Level].bIsValid)
+        return INDEX_NONE;
+
+    const auto& Ring = Rings[Level];
+    const auto Coordinates = Key.GetCoordinates();
+    const auto TileCoordinates = FIntPoint(FQuadTreeGrid::FloorDivide(Coordinates.X, 1 << Level), FQuadTreeGrid::FloorDivide(Coordinates.Y, 1 << Level));
+    if (!Ring.GetRect().Contains(TileCoordinates))
+        return INDEX_NONE;
+
+    const auto TileIndex = Ring.GetTileIndex(TileCoordinates);
+    return Ring.Tiles[TileIndex].Key == Key ? TileIndex : INDEX_NONE;
+}
+
+FIntRect FQuadTreeClipmap::GetHole(const uint8 Level) const
+{
+    if (Level == 0 || !Rings[Level - 1].bIsValid)
+        return FIntRect();
+
+    /* Finer rings start and end on this level's tiles */
+    const auto& Finer = Rings[Level - 1];
+    return FIntRect(Finer.Origin / 2, (Finer.Origin + FIntPoint(Finer.Width, Finer.Width)) / 2);
+}
+
+void FQuadTreeClipmap::WriteTile(const uint8 Level, const FIntPoint& Coordinates, const FIntRect& Hole)
+{
+    const auto TileIndex = Rings[Level].GetTileIndex(Coordinates);
+    auto& Tile = Rings[Level].Tiles[TileIndex];
+    const auto Size = CellSize << Level;
+
+    /* The tile's previous node scrolled out */
+    SetLeaf(Level, TileIndex, false);
+
+    /* Same cube bounds as FQuadTreeNode until refit */
+    Tile.Key = FQuadTreeNodeKey(Coordinates * (1 << Level), Level);
+    Tile.HeightBounds = FFloatInterval(-Size * 0.5f, Size * 0.5f);
+    SetLeaf(Level, TileIndex, !Hole.Contains(Coordinates));
+
+    UpdatedTileCount++;
+}
+
+void FQuadTreeClipmap::SetLeaf(const uint8 Level, const int32 TileIndex, const bool bIsLeaf)
+{
+    auto& Tile = Rings[Level].Tiles[TileIndex];
+    if ((Tile.LeafIndex != INDEX_NONE) == bIsLeaf)
+        return;
+
+    if (bIsLeaf)
+    {
+        Tile.LeafIndex = Leaves.Add(FLeaf{ Level, TileIndex });
+        LeafChanges.Add(FLeafChange{ INDEX_NONE, Tile.Key, Tile.HeightBounds });
+        return;
+    }
+
+    /* Swapped like TArray::RemoveAtSwap, the moved leaf's tile follows it */
+    const auto Index = Tile.LeafIndex;
+    Tile.LeafIndex = INDEX_NONE;
+    Leaves.RemoveAtSwap(Index, 1, false);
+    if (Index < Leaves.Num())
+        Rings[Leaves[Index].Level].Tiles[Leaves[Index].TileIndex].LeafIndex = Index;
+
+    LeafChanges.Add(FLeafChange{ Index, FQuadTreeNodeKey(), FFloatInterval(0.0f, 0.0f) });
+}
+
+#undef LOCTEXT_NAMESPACE
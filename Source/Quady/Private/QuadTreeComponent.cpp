@@ -1,33 +1,103 @@
-// Fill out your copyright notice in the Description page of Project Settings.
-
 #include "QuadTreeComponent.h"
 
-// Sets default values for this component's properties
+#include "QuadTree.h"
+#include "QuadTreeUpdateScheduler.h"
+#include "ContentStreaming.h"
+
 UQuadTreeComponent::UQuadTreeComponent()
+    : UpdateDistanceRatio(0.25f),
+    bDrawDebug(false),
+    bUpdateRequested(true),
+    DeferredFrames(0)
 {
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
-	PrimaryComponentTick.bCanEverTick = true;
+    /* Updated by FQuadTreeUpdateScheduler instead */
+	PrimaryComponentTick.bCanEverTick = false;
 
-	// ...
+    QuadTree = CreateDefaultSubobject<UQuadTree>(TEXT("QuadTree"));
 }
 
+float UQuadTreeComponent::GetUpdateUrgency() const
+{
+    if (QuadTree == nullptr)
+        return 0.0f;
+
+    FStreamingManagerCollection& StreamingManager = IStreamingManager::Get();
+    const auto ViewCount = StreamingManager.GetNumViews();
+    if (ViewCount <= 0)
+        return 0.0f;
+
+    if (bUpdateRequested || QuadTree->HasPendingWork() || ViewCount != LastViewLocations.Num())
+        return 1.0f + DeferredFrames;
+
+    /* Selection can't change before a viewer gets near the edge of the smallest range */
+    const auto Threshold = QuadTree->GetSmallestRange() * UpdateDistanceRatio;
+    const auto ThresholdSquared = FMath::Max(Threshold * Threshold, KINDA_SMALL_NUMBER);
+
+    auto MaxDistanceSquared = 0.0f;
+    for (auto i = 0; i < ViewCount; i++)
+        MaxDistanceSquared = FMath::Max(MaxDistanceSquared, FVector::DistSquaredXY(StreamingManager.GetViewInformation(i).ViewOrigin, LastViewLocations[i]));
 
-// Called when the game starts
-void UQuadTreeComponent::BeginPlay()
+    if (MaxDistanceSquared < ThresholdSquared)
+        return 0.0f;
+
+    return FMath::Sqrt(MaxDistanceSquared / ThresholdSquared) + DeferredFrames;
+}
+
+void UQuadTreeComponent::PerformUpdate()
 {
-	Super::BeginPlay();
+    check(QuadTree);
+
+    QuadTree->Update();
 
-	// ...
-	
+    FStreamingManagerCollection& StreamingManager = IStreamingManager::Get();
+    const auto ViewCount = StreamingManager.GetNumViews();
+
+    LastViewLocations.Reset(ViewCount);
+    for (auto i = 0; i < ViewCount; i++)
+        LastViewLocations.Add(StreamingManager.GetViewInformation(i).ViewOrigin);
+
+    bUpdateRequested = false;
+    DeferredFrames = 0;
 }
 
+void UQuadTreeComponent::SetRangeScale(const float RangeScale)
+{
+    /* Every leaf's range changed, not just those near the viewers */
+    if (QuadTree != nullptr && QuadTree->SetRangeScale(RangeScale))
+        bUpdateRequested = true;
+}
+
+void UQuadTreeComponent::PerformDraw()
+{
+    if (bDrawDebug && QuadTree != nullptr && GetWorld() != nullptr)
+        QuadTree->Draw(GetWorld());
+}
 
-// Called every frame
-void UQuadTreeComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+void UQuadTreeComponent::ApplyWorldOffset(const FVector& InOffset, bool bWorldShift)
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+    Super::ApplyWorldOffset(InOffset, bWorldShift);
 
-	// ...
+    if (QuadTree == nullptr)
+        return;
+
+    QuadTree->ApplyWorldOffset(InOffset, bWorldShift);
+
+    /* Views moved with the world, not relative to it */
+    for (auto& ViewLocation : LastViewLocations)
+        ViewLocation += InOffset;
 }
 
+void UQuadTreeComponent::OnRegister()
+{
+    Super::OnRegister();
+
+    bUpdateRequested = true;
+    FQuadTreeUpdateScheduler::Register(this);
+}
+
+void UQuadTreeComponent::OnUnregister()
+{
+    FQuadTreeUpdateScheduler::Unregister(this);
+
+    Super::OnUnregister();
+}
@@ -0,0 +1,101 @@
+#include "QuadTreeDebugDraw.h"
+
+#include "Quady.h"
+#include "QuadTreeGrid.h"
+#include "Components/LineBatchComponent.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Debug Draw Build"), STAT_QuadTreeDebugDrawBuild, STATGROUP_Quady);
+
+void FQuadTreeDebugDraw::Build(ULineBatchComponent& Batcher, const FQuadTreeGrid& Grid, const TArray<FQuadTreeLeaf>& Leaves, const bool bHeat, TFunctionRef<float(const FQuadTreeLeaf&)> Heat)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeDebugDrawBuild);
+
+    Batcher.Flush();
+
+    if (Leaves.Num() == 0)
+        return;
+
+    /* Lifetime 0 persists until the next Flush */
+    TArray<FBatchedLine> Lines;
+    Lines.Reserve(Leaves.Num() * 4);
+
+    TArray<FVector> Vertices[HeatSteps];
+    TArray<int32> Indices[HeatSteps];
+
+    for (auto& Leaf : Leaves)
+    {
+        const FVector Corners[] = { GetLeafCorner(Grid, Leaf, 0, 0), GetLeafCorner(Grid, Leaf, 1, 0), GetLeafCorner(Grid, Leaf, 1, 1), GetLeafCorner(Grid, Leaf, 0, 1) };
+
+        for (auto i = 0; i < 4; i++)
+            Lines.Emplace(Corners[i], Corners[(i + 1) % 4], FLinearColor(FColor::Red), 0.0f, 0.0f, SDPG_World);
+
+        if (!bHeat)
+            continue;
+
+        const auto Step = FMath::Clamp(FMath::FloorToInt(Heat(Leaf) * HeatSteps), 0, HeatSteps - 1);
+        auto& StepVertices = Vertices[Step];
+        auto& StepIndices = Indices[Step];
+
+        const auto Base = StepVertices.Num();
+        StepVertices.Append(Corners, 4);
+
+        /* Both windings, the overlay is seen from above and below */
+        const int32 Quad[] = { 0, 1, 2, 0, 2, 3, 0, 2, 1, 0, 3, 2 };
+        for (auto Index : Quad)
+            StepIndices.Add(Base + Index);
+    }
+
+    Batcher.DrawLines(Lines);
+
+    if (!bHeat)
+        return;
+
+    for (auto Step = 0; Step < HeatSteps; Step++)
+        if (Indices[Step].Num() > 0)
+            Batcher.DrawMesh(Vertices[Step], Indices[Step], GetHeatColor(Step), SDPG_World, 0.0f);
+}
+
+void FQuadTreeDebugDraw::AddRanges(ULineBatchComponent& Batcher, const FVector& Center, const TArray<float>& Ranges)
+{
+    /* Coarser than DrawDebugCircle's 64, ranges are large and drawn once */
+    static const int32 Segments = 32;
+
+    TArray<FBatchedLine> Lines;
+    Lines.Reserve(Ranges.Num() * Segments);
+
+    for (auto Range : Ranges)
+    {
+        auto Previous = Center + FVector(Range, 0.0f, 0.0f);
+        for (auto i = 1; i <= Segments; i++)
+        {
+            float Sin, Cos;
+            FMath::SinCos(&Sin, &Cos, 2.0f * PI * i / Segments);
+
+            const auto Next = Center + FVector(Cos * Range, Sin * Range, 0.0f);
+            Lines.Emplace(Previous, Next, FLinearColor(FColor::Green), 0.0f, 0.0f, SDPG_World);
+            Previous = Next;
+        }
+    }
+
+    Batcher.DrawLines(Lines);
+}
+
+FColor FQuadTreeDebugDraw::GetHeatColor(const int32 Step)
+{
+    /* Hue from blue (cold) to red (hot), translucent so the terrain stays visible */
+    const auto Alpha = (float)Step / (HeatSteps - 1);
+    auto Color = FLinearColor::FGetHSV((uint8)FMath::Lerp(170.0f, 0.0f, Alpha), 255, 255).ToFColor(false);
+    Color.A = 128;
+
+    return Color;
+}
+
+FVector FQuadTreeDebugDraw::GetLeafCorner(const FQuadTreeGrid& Grid, const FQuadTreeLeaf& Leaf, const int32 X, const int32 Y)
+{
+    const auto Size = (float)(Grid.CellSize << Leaf.Level);
+    return Grid.ToWorld(Leaf.Coordinates) + FVector(X * Size, Y * Size, Leaf.Level * 100.0f);
+}
+
+#undef LOCTEXT_NAMESPACE
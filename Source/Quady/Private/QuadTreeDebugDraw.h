@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+
+class ULineBatchComponent;
+struct FQuadTreeGrid;
+
+/*
+Fills a line batch with the selection in a handful of draw calls: outlines as one line
+list, heat as one mesh per color step. The batch persists until rebuilt, so nothing is
+resubmitted on frames where the selection doesn't change.
+*/
+class FQuadTreeDebugDraw
+{
+public:
+    static const int32 HeatSteps = 8;
+
+    /* Replace Batcher's contents with Leaves, filled by Heat in [0, 1] when bHeat */
+    static void Build(ULineBatchComponent& Batcher, const FQuadTreeGrid& Grid, const TArray<FQuadTreeLeaf>& Leaves, const bool bHeat, TFunctionRef<float(const FQuadTreeLeaf&)> Heat);
+
+    /* Horizontal circles at Center, one per range */
+    static void AddRanges(ULineBatchComponent& Batcher, const FVector& Center, const TArray<float>& Ranges);
+
+    /* Blue to red */
+    static FColor GetHeatColor(const int32 Step);
+
+private:
+    /* Leaves are raised by level so overlapping levels stay readable */
+    static FVector GetLeafCorner(const FQuadTreeGrid& Grid, const FQuadTreeLeaf& Leaf, const int32 X, const int32 Y);
+};
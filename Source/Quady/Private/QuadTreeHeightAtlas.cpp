@@ -0,0 +1,189 @@
+#include "QuadTreeHeightAtlas.h"
+
+#include "Quady.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Atlas Uploads"), STAT_QuadTreeAtlasUploads, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Atlas Evictions"), STAT_QuadTreeAtlasEvictions, STATGROUP_Quady);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("QuadTree Atlas Resident Slots"), STAT_QuadTreeAtlasResidentSlots, STATGROUP_Quady);
+
+FQuadTreeHeightAtlas::FQuadTreeHeightAtlas(const int32 SlotsPerSide, const int32 SlotSize)
+    : SlotsPerSide(SlotsPerSide),
+    SlotSize(SlotSize),
+    Frame(1),
+    Head(INDEX_NONE),
+    Tail(INDEX_NONE)
+{
+    check(SlotsPerSide > 0 && SlotSize > 0);
+
+    /* Every slot starts free at the tail */
+    Slots.SetNum(SlotsPerSide * SlotsPerSide);
+    for (auto Slot = 0; Slot < Slots.Num(); Slot++)
+    {
+        Slots[Slot].LastFrame = 0;
+        LinkTail(Slot);
+    }
+}
+
+void FQuadTreeHeightAtlas::BeginFrame()
+{
+    Frame++;
+}
+
+int32 FQuadTreeHeightAtlas::Acquire(const FQuadTreeNodeKey Key, bool& bOutAllocated)
+{
+    bOutAllocated = false;
+
+    if (const auto* Resident = PageTable.Find(Key))
+    {
+        const auto Slot = *Resident;
+        Slots[Slot].LastFrame = Frame;
+        Unlink(Slot);
+        LinkHead(Slot);
+        return Slot;
+    }
+
+    /* Least recently used, free slots are kept behind it */
+    const auto Slot = Tail;
+    if (Slot == INDEX_NONE || Slots[Slot].LastFrame == Frame)
+        return INDEX_NONE;
+
+    auto& Entry = Slots[Slot];
+    if (Entry.Key.IsValid())
+    {
+        PageTable.Remove(Entry.Key);
+        INC_DWORD_STAT(STAT_QuadTreeAtlasEvictions);
+    }
+
+    Entry.Key = Key;
+    Entry.LastFrame = Frame;
+    Unlink(Slot);
+    LinkHead(Slot);
+    PageTable.Add(Key, Slot);
+
+    SET_DWORD_STAT(STAT_QuadTreeAtlasResidentSlots, PageTable.Num());
+
+    bOutAllocated = true;
+    return Slot;
+}
+
+int32 FQuadTreeHeightAtlas::Find(const FQuadTreeNodeKey Key) const
+{
+    const auto* Slot = PageTable.Find(Key);
+    return Slot != nullptr ? *Slot : INDEX_NONE;
+}
+
+void FQuadTreeHeightAtlas::Invalidate(const FQuadTreeNodeKey Key)
+{
+    int32 Slot;
+    if (!PageTable.RemoveAndCopyValue(Key, Slot))
+        return;
+
+    Slots[Slot].Key = FQuadTreeNodeKey();
+    Slots[Slot].LastFrame = 0;
+    Unlink(Slot);
+    LinkTail(Slot);
+
+    SET_DWORD_STAT(STAT_QuadTreeAtlasResidentSlots, PageTable.Num());
+}
+
+void FQuadTreeHeightAtlas::QueueUpload(const int32 Slot)
+{
+    check(Slots.IsValidIndex(Slot));
+
+    if (QueuedSlots.Contains(Slot))
+        return;
+
+    QueuedSlots.Add(Slot, Staging.Num());
+    Staging.AddUninitialized(SlotSize * SlotSize);
+}
+
+FColor* FQuadTreeHeightAtlas::GetQueuedTexels(const int32 Slot)
+{
+    const auto* Offset = QueuedSlots.Find(Slot);
+    check(Offset != nullptr);
+
+    return &Staging[*Offset];
+}
+
+bool FQuadTreeHeightAtlas::TakeUploads(TArray<FColor>& OutStaging, TArray<FQuadTreeHeightAtlasRegion>& OutRegions)
+{
+    OutRegions.Reset(QueuedSlots.Num());
+    if (QueuedSlots.Num() == 0)
+        return false;
+
+    for (auto& KVP : QueuedSlots)
+    {
+        const auto Slot = KVP.Key;
+        const auto Destination = FIntPoint(Slot % SlotsPerSide, Slot / SlotsPerSide) * SlotSize;
+        OutRegions.Add(FQuadTreeHeightAtlasRegion{ KVP.Value / SlotSize, Destination });
+    }
+
+    INC_DWORD_STAT_BY(STAT_QuadTreeAtlasUploads, QueuedSlots.Num());
+
+    /* Swapped rather than moved so neither side reallocates once both have grown */
+    Swap(OutStaging, Staging);
+    Staging.Reset();
+    QueuedSlots.Reset();
+
+    return true;
+}
+
+FVector4 FQuadTreeHeightAtlas::GetUVScaleBias(const int32 Slot) const
+{
+    check(Slots.IsValidIndex(Slot));
+
+    const auto InvTextureSize = 1.0f / GetTextureSize();
+    const auto Origin = FIntPoint(Slot % SlotsPerSide, Slot / SlotsPerSide) * SlotSize;
+
+    return FVector4(InvTextureSize, InvTextureSize, Origin.X * InvTextureSize, Origin.Y * InvTextureSize);
+}
+
+void FQuadTreeHeightAtlas::Unlink(const int32 Slot)
+{
+    auto& Entry = Slots[Slot];
+
+    if (Entry.Previous != INDEX_NONE)
+        Slots[Entry.Previous].Next = Entry.Next;
+    else
+        Head = Entry.Next;
+
+    if (Entry.Next != INDEX_NONE)
+        Slots[Entry.Next].Previous = Entry.Previous;
+    else
+        Tail = Entry.Previous;
+
+    Entry.Previous = INDEX_NONE;
+    Entry.Next = INDEX_NONE;
+}
+
+void FQuadTreeHeightAtlas::LinkHead(const int32 Slot)
+{
+    auto& Entry = Slots[Slot];
+    Entry.Previous = INDEX_NONE;
+    Entry.Next = Head;
+
+    if (Head != INDEX_NONE)
+        Slots[Head].Previous = Slot;
+    else
+        Tail = Slot;
+
+    Head = Slot;
+}
+
+void FQuadTreeHeightAtlas::LinkTail(const int32 Slot)
+{
+    auto& Entry = Slots[Slot];
+    Entry.Previous = Tail;
+    Entry.Next = INDEX_NONE;
+
+    if (Tail != INDEX_NONE)
+        Slots[Tail].Next = Slot;
+    else
+        Head = Slot;
+
+    Tail = Slot;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,143 @@
+#include "QuadTreeHeightCache.h"
+
+#include "Quady.h"
+#include "Async.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/MemStack.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Height Generation"), STAT_QuadTreeHeightGeneration, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Height Tiles Requested"), STAT_QuadTreeHeightTilesRequested, STATGROUP_Quady);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("QuadTree Cached Height Tiles"), STAT_QuadTreeCachedHeightTiles, STATGROUP_Quady);
+
+FQuadTreeHeightCache::FQuadTreeHeightCache(const TSharedRef<IQuadTreeHeightSource, ESPMode::ThreadSafe>& Source, const int32 CellSize, const int32 SampleCount)
+    : Source(Source),
+    CellSize(CellSize),
+    SampleCount(SampleCount),
+    Selection(0)
+{
+    check(CellSize > 0);
+    check(SampleCount > 1 && (SampleCount - 1) % 2 == 0);
+}
+
+void FQuadTreeHeightCache::BeginSelection()
+{
+    check(IsInGameThread());
+
+    FScopeLock ScopeLock(&Lock);
+    Selection++;
+}
+
+void FQuadTreeHeightCache::Request(const FQuadTreeNodeKey Key)
+{
+    check(IsInGameThread());
+
+    {
+        FScopeLock ScopeLock(&Lock);
+
+        if (auto* Entry = Tiles.Find(Key))
+        {
+            Entry->LastSelection = Selection;
+            return;
+        }
+
+        if (Pending.Contains(Key))
+            return;
+
+        Pending.Add(Key);
+    }
+
+    INC_DWORD_STAT(STAT_QuadTreeHeightTilesRequested);
+
+    /* Keeps the cache alive until the tile lands */
+    Async<void>(EAsyncExecution::TaskGraph, [Cache = AsShared(), Key]()
+    {
+        Cache->Generate(Key);
+    });
+}
+
+void FQuadTreeHeightCache::Invalidate(const FQuadTreeNodeKey Key)
+{
+    check(IsInGameThread());
+
+    FScopeLock ScopeLock(&Lock);
+
+    Tiles.Remove(Key);
+    if (Pending.Contains(Key))
+        Stale.Add(Key);
+}
+
+FQuadTreeHeightTilePtr FQuadTreeHeightCache::Find(const FQuadTreeNodeKey Key) const
+{
+    FScopeLock ScopeLock(&Lock);
+
+    auto* Entry = Tiles.Find(Key);
+    return Entry != nullptr ? Entry->Tile : nullptr;
+}
+
+void FQuadTreeHeightCache::Trim(const int32 MaxTiles)
+{
+    check(IsInGameThread());
+
+    FScopeLock ScopeLock(&Lock);
+
+    const auto Excess = Tiles.Num() - MaxTiles;
+    if (Excess <= 0)
+        return;
+
+    FMemMark Mark(FMemStack::Get());
+
+    TArray<TPair<uint32, FQuadTreeNodeKey>, TMemStackAllocator<>> Candidates;
+    Candidates.Reserve(Tiles.Num());
+    for (auto& KVP : Tiles)
+        if (KVP.Value.LastSelection != Selection)
+            Candidates.Emplace(KVP.Value.LastSelection, KVP.Key);
+
+    Candidates.Sort([](const TPair<uint32, FQuadTreeNodeKey>& A, const TPair<uint32, FQuadTreeNodeKey>& B) { return A.Key < B.Key; });
+
+    for (auto i = 0; i < FMath::Min(Excess, Candidates.Num()); i++)
+        Tiles.Remove(Candidates[i].Value);
+
+    SET_DWORD_STAT(STAT_QuadTreeCachedHeightTiles, Tiles.Num());
+}
+
+int32 FQuadTreeHeightCache::Num() const
+{
+    FScopeLock ScopeLock(&Lock);
+
+    return Tiles.Num();
+}
+
+int32 FQuadTreeHeightCache::GetPendingCount() const
+{
+    FScopeLock ScopeLock(&Lock);
+
+    return Pending.Num();
+}
+
+void FQuadTreeHeightCache::Generate(const FQuadTreeNodeKey Key)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeHeightGeneration);
+
+    /* Parent's coordinates are the child's rounded down to the parent's size */
+    const auto Level = Key.GetLevel();
+    const auto ParentTile = Find(FQuadTreeNodeKey(Key.GetCoordinates(), Level + 1));
+
+    auto Tile = MakeShared<FQuadTreeHeightTile, ESPMode::ThreadSafe>(Key, CellSize, SampleCount);
+    Source->Generate(ParentTile.Get(), *Tile);
+
+    FScopeLock ScopeLock(&Lock);
+
+    Pending.Remove(Key);
+
+    /* Generated from old data, the next Request starts over */
+    if (Stale.Remove(Key) > 0)
+        return;
+
+    Tiles.Add(Key, FEntry{ Tile, Selection });
+
+    SET_DWORD_STAT(STAT_QuadTreeCachedHeightTiles, Tiles.Num());
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,201 @@
+#include "QuadTreeHeightNormals.h"
+
+#include "Quady.h"
+#include "Misc/MemStack.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Height Normals"), STAT_QuadTreeHeightNormals, STATGROUP_Quady);
+
+namespace QuadyNormals
+{
+    /* NWES, in samples */
+    static const FIntPoint Directions[4] = { FIntPoint(0, -1), FIntPoint(-1, 0), FIntPoint(1, 0), FIntPoint(0, 1) };
+
+    static FORCEINLINE float GetHeight(const FQuadTreeHeightTile& Tile, const FIntPoint& Sample)
+    {
+        return Tile.Heights[Sample.Y * Tile.SampleCount + Sample.X];
+    }
+
+    /* Position in the tile's samples, clamped to it */
+    static float SampleBilinear(const FQuadTreeHeightTile& Tile, const FVector2D& Position)
+    {
+        const auto Last = (float)(Tile.SampleCount - 1);
+        const auto X = FMath::Clamp(Position.X, 0.0f, Last);
+        const auto Y = FMath::Clamp(Position.Y, 0.0f, Last);
+
+        const auto X0 = FMath::FloorToInt(X);
+        const auto Y0 = FMath::FloorToInt(Y);
+        const auto X1 = FMath::Min(X0 + 1, Tile.SampleCount - 1);
+        const auto Y1 = FMath::Min(Y0 + 1, Tile.SampleCount - 1);
+
+        const auto Top = FMath::Lerp(GetHeight(Tile, FIntPoint(X0, Y0)), GetHeight(Tile, FIntPoint(X1, Y0)), X - X0);
+        const auto Bottom = FMath::Lerp(GetHeight(Tile, FIntPoint(X0, Y1)), GetHeight(Tile, FIntPoint(X1, Y1)), X - X0);
+        return FMath::Lerp(Top, Bottom, Y - Y0);
+    }
+
+    static FORCEINLINE uint8 ToUnorm8(const float Value)
+    {
+        return (uint8)FMath::Clamp(FMath::RoundToInt((Value * 0.5f + 0.5f) * 255.0f), 0, 255);
+    }
+}
+
+FQuadTreeHeightNeighborhood FQuadTreeHeightNormals::Gather(const FQuadTreeHeightCache& Cache, const FQuadTreeHeightTilePtr& Tile)
+{
+    check(Tile.IsValid());
+
+    FQuadTreeHeightNeighborhood Neighborhood;
+    Neighborhood.Tile = Tile;
+
+    const auto Level = Tile->Key.GetLevel();
+    const auto Size = 1 << Level;
+    const auto Coordinates = Tile->Key.GetCoordinates();
+
+    for (auto Side = 0; Side < 4; Side++)
+    {
+        const auto& Direction = QuadyNormals::Directions[Side];
+        Neighborhood.Neighbors[Side] = Cache.Find(FQuadTreeNodeKey(Coordinates + Direction * Size, Level));
+
+        /* A cell just past this side, its Level + 1 node spans the whole side */
+        const auto Outside = FIntPoint(Direction.X > 0 ? Size : Direction.X, Direction.Y > 0 ? Size : Direction.Y);
+        Neighborhood.Coarse[Side] = Cache.Find(FQuadTreeNodeKey(Coordinates + Outside, Level + 1));
+    }
+
+    return Neighborhood;
+}
+
+void FQuadTreeHeightNormals::GatherBorder(const FQuadTreeHeightNeighborhood& Neighborhood, float* OutBordered)
+{
+    const auto& Tile = *Neighborhood.Tile;
+    const auto Count = Tile.SampleCount;
+    const auto Stride = Count + 2;
+    const auto Size = 1 << Tile.Key.GetLevel();
+
+    for (auto Y = 0; Y < Count; Y++)
+        FMemory::Memcpy(&OutBordered[(Y + 1) * Stride + 1], &Tile.Heights[Y * Count], Count * sizeof(float));
+
+    for (auto Side = 0; Side < 4; Side++)
+    {
+        const auto& Direction = QuadyNormals::Directions[Side];
+        const auto* Neighbor = Neighborhood.Neighbors[Side].Get();
+        const auto* Coarse = Neighborhood.Coarse[Side].Get();
+
+        if (Neighbor != nullptr && Neighbor->SampleCount != Count)
+            Neighbor = nullptr;
+
+        if (Coarse != nullptr && Coarse->SampleCount != Count)
+            Coarse = nullptr;
+
+        /* This tile's origin in the coarse tile's samples, which are twice as far apart */
+        const auto CoarseOffset = Coarse != nullptr ? (Tile.Key.GetCoordinates() - Coarse->Key.GetCoordinates()) / Size * (Count - 1) : FIntPoint::ZeroValue;
+
+        for (auto i = 0; i < Count; i++)
+        {
+            const auto Sample = FIntPoint(
+                Direction.X != 0 ? (Direction.X > 0 ? Count : -1) : i,
+                Direction.Y != 0 ? (Direction.Y > 0 ? Count : -1) : i);
+
+            float Height;
+            if (Neighbor != nullptr)
+            {
+                /* Edges are shared, the neighbor's second row or column */
+                Height = QuadyNormals::GetHeight(*Neighbor, Sample - Direction * (Count - 1));
+            }
+            else if (Coarse != nullptr)
+            {
+                const auto Position = CoarseOffset + Sample;
+                Height = QuadyNormals::SampleBilinear(*Coarse, FVector2D(Position.X * 0.5f, Position.Y * 0.5f));
+            }
+            else
+            {
+                /* Linear extrapolation, a one sided difference at the edge */
+                const auto Edge = Sample - Direction;
+                Height = 2.0f * QuadyNormals::GetHeight(Tile, Edge) - QuadyNormals::GetHeight(Tile, Edge - Direction);
+            }
+
+            OutBordered[(Sample.Y + 1) * Stride + Sample.X + 1] = Height;
+        }
+    }
+
+    /* Never differenced, only keeps vector loads deterministic */
+    OutBordered[0] = OutBordered[1];
+    OutBordered[Stride - 1] = OutBordered[Stride - 2];
+    OutBordered[(Stride - 1) * Stride] = OutBordered[(Stride - 1) * Stride + 1];
+    OutBordered[Stride * Stride - 1] = OutBordered[Stride * Stride - 2];
+}
+
+void FQuadTreeHeightNormals::PackTexels(const float* Bordered, const int32 SampleCount, const float SampleSpacing, const float HeightScale, FColor* OutTexels)
+{
+    check(SampleSpacing > 0.0f && HeightScale > 0.0f);
+
+    const auto Stride = SampleCount + 2;
+    const auto One = VectorOne();
+    const auto InvTwoSpacing = VectorSetFloat1(0.5f / SampleSpacing);
+    const auto HeightToPacked = VectorSetFloat1(128.0f / HeightScale);
+
+    float Heights[4];
+    float NormalX[4];
+    float NormalY[4];
+
+    for (auto Y = 0; Y < SampleCount; Y++)
+    {
+        const auto* Row = &Bordered[(Y + 1) * Stride + 1];
+
+        /* The last vector of a row reads into the next, its extra lanes are dropped */
+        for (auto X = 0; X < SampleCount; X += 4)
+        {
+            const auto* Center = Row + X;
+            const auto SlopeX = VectorMultiply(VectorSubtract(VectorLoad(Center + 1), VectorLoad(Center - 1)), InvTwoSpacing);
+            const auto SlopeY = VectorMultiply(VectorSubtract(VectorLoad(Center + Stride), VectorLoad(Center - Stride)), InvTwoSpacing);
+
+            /* (-SlopeX, -SlopeY, 1) over its L1 norm, Z is never negative so there is no fold */
+            const auto InvNorm = VectorReciprocal(VectorAdd(VectorAdd(VectorAbs(SlopeX), VectorAbs(SlopeY)), One));
+
+            VectorStore(VectorMultiply(VectorLoad(Center), HeightToPacked), Heights);
+            VectorStore(VectorNegate(VectorMultiply(SlopeX, InvNorm)), NormalX);
+            VectorStore(VectorNegate(VectorMultiply(SlopeY, InvNorm)), NormalY);
+
+            const auto Lanes = FMath::Min(4, SampleCount - X);
+            for (auto Lane = 0; Lane < Lanes; Lane++)
+            {
+                /* Same packing as DecodePackedHeight in QuadyVertexFactory.ush */
+                const auto Packed = (uint16)FMath::Clamp(FMath::RoundToInt(Heights[Lane]) + 32768, 0, 65535);
+
+                auto& Texel = OutTexels[Y * SampleCount + X + Lane];
+                Texel.R = Packed >> 8;
+                Texel.G = Packed & 0xFF;
+                Texel.B = QuadyNormals::ToUnorm8(NormalX[Lane]);
+                Texel.A = QuadyNormals::ToUnorm8(NormalY[Lane]);
+            }
+        }
+    }
+}
+
+void FQuadTreeHeightNormals::PackTexels(const FQuadTreeHeightNeighborhood& Neighborhood, const float HeightScale, FColor* OutTexels)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeHeightNormals);
+
+    FMemMark Mark(FMemStack::Get());
+
+    const auto& Tile = *Neighborhood.Tile;
+    const auto Stride = Tile.SampleCount + 2;
+
+    TArray<float, TMemStackAllocator<>> Bordered;
+    Bordered.SetNumUninitialized(Stride * Stride + 3);
+
+    GatherBorder(Neighborhood, Bordered.GetData());
+    PackTexels(Bordered.GetData(), Tile.SampleCount, Tile.GetSampleSpacing(), HeightScale, OutTexels);
+}
+
+FVector2D FQuadTreeHeightNormals::EncodeOctahedral(const FVector& Normal)
+{
+    const auto L1 = FMath::Abs(Normal.X) + FMath::Abs(Normal.Y) + FMath::Max(Normal.Z, 0.0f);
+    return L1 > 0.0f ? FVector2D(Normal.X / L1, Normal.Y / L1) : FVector2D::ZeroVector;
+}
+
+FVector FQuadTreeHeightNormals::DecodeOctahedral(const FVector2D& Encoded)
+{
+    return FVector(Encoded.X, Encoded.Y, 1.0f - FMath::Abs(Encoded.X) - FMath::Abs(Encoded.Y)).GetSafeNormal();
+}
+
+#undef LOCTEXT_NAMESPACE
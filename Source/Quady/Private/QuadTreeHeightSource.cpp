@@ -0,0 +1,267 @@
+#include "QuadTreeHeightSource.h"
+
+#include "Quady.h"
+#include "Misc/MemStack.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("QuadTree Derived Height Samples"), STAT_QuadTreeDerivedHeightSamples, STATGROUP_Quady);
+
+namespace QuadyNoise
+{
+    static FORCEINLINE VectorRegister Floor(const VectorRegister& Value)
+    {
+        /* Truncation rounds negatives up */
+        const auto Truncated = VectorTruncate(Value);
+        return VectorSubtract(Truncated, VectorSelect(VectorCompareGT(Truncated, Value), VectorOne(), VectorZero()));
+    }
+
+    static FORCEINLINE VectorRegister Fraction(const VectorRegister& Value)
+    {
+        return VectorSubtract(Value, Floor(Value));
+    }
+
+    /* Hash without sine (Dave Hoskins), in [0, 1). Only float math so every lane and platform agrees */
+    static FORCEINLINE VectorRegister Hash(const VectorRegister& X, const VectorRegister& Y)
+    {
+        const auto Scale = VectorSetFloat1(0.1031f);
+        const auto Offset = VectorSetFloat1(33.33f);
+
+        auto PX = Fraction(VectorMultiply(X, Scale));
+        auto PY = Fraction(VectorMultiply(Y, Scale));
+        auto PZ = PX;
+
+        const auto Dot = VectorAdd(VectorAdd(
+            VectorMultiply(PX, VectorAdd(PY, Offset)),
+            VectorMultiply(PY, VectorAdd(PZ, Offset))),
+            VectorMultiply(PZ, VectorAdd(PX, Offset)));
+
+        PX = VectorAdd(PX, Dot);
+        PY = VectorAdd(PY, Dot);
+        PZ = VectorAdd(PZ, Dot);
+
+        return Fraction(VectorMultiply(VectorAdd(PX, PY), PZ));
+    }
+
+    /* Lattice and Local are split so interpolation stays precise far from the origin, in [0, 1) */
+    static FORCEINLINE VectorRegister ValueNoise(const VectorRegister& LatticeX, const VectorRegister& LatticeY, const VectorRegister& LocalX, const VectorRegister& LocalY)
+    {
+        const auto One = VectorOne();
+        const auto Three = VectorSetFloat1(3.0f);
+
+        const auto FloorX = Floor(LocalX);
+        const auto FloorY = Floor(LocalY);
+        const auto FX = VectorSubtract(LocalX, FloorX);
+        const auto FY = VectorSubtract(LocalY, FloorY);
+
+        /* Smoothstep */
+        const auto UX = VectorMultiply(VectorMultiply(FX, FX), VectorSubtract(Three, VectorAdd(FX, FX)));
+        const auto UY = VectorMultiply(VectorMultiply(FY, FY), VectorSubtract(Three, VectorAdd(FY, FY)));
+
+        const auto X0 = VectorAdd(LatticeX, FloorX);
+        const auto Y0 = VectorAdd(LatticeY, FloorY);
+        const auto X1 = VectorAdd(X0, One);
+        const auto Y1 = VectorAdd(Y0, One);
+
+        const auto A = Hash(X0, Y0);
+        const auto B = Hash(X1, Y0);
+        const auto C = Hash(X0, Y1);
+        const auto D = Hash(X1, Y1);
+
+        const auto Bottom = VectorMultiplyAdd(VectorSubtract(B, A), UX, A);
+        const auto Top = VectorMultiplyAdd(VectorSubtract(D, C), UX, C);
+        return VectorMultiplyAdd(VectorSubtract(Top, Bottom), UY, Bottom);
+    }
+}
+
+void FQuadTreeHeightTile::UpdateHeightBounds()
+{
+    if (Heights.Num() == 0)
+    {
+        HeightBounds = FFloatInterval(0.0f, 0.0f);
+        return;
+    }
+
+    HeightBounds = FFloatInterval(Heights[0], Heights[0]);
+    for (auto Height : Heights)
+        HeightBounds.Include(Height);
+}
+
+FQuadTreeProceduralHeightSource::FQuadTreeProceduralHeightSource(const FQuadTreeNoiseSettings& Settings)
+    : Settings(Settings)
+{
+    check(Settings.Octaves > 0);
+
+    /* Per octave lattice offsets decorrelate the octaves, integers so they don't cost precision */
+    FRandomStream Random(Settings.Seed);
+
+    auto Frequency = (double)Settings.Frequency;
+    auto Amplitude = Settings.Amplitude;
+    for (auto Octave = 0; Octave < Settings.Octaves; Octave++)
+    {
+        Frequencies.Add(Frequency);
+        Amplitudes.Add(Amplitude);
+        LatticeOffsets.Add(FIntPoint(Random.RandRange(-4096, 4096), Random.RandRange(-4096, 4096)));
+
+        Frequency *= Settings.Lacunarity;
+        Amplitude *= Settings.Gain;
+    }
+}
+
+int32 FQuadTreeProceduralHeightSource::GetOctaveCount(const float SampleSpacing) const
+{
+    /* Nyquist, finer octaves would only alias */
+    auto Count = 1;
+    while (Count < Frequencies.Num() && Frequencies[Count] * SampleSpacing <= 0.5)
+        Count++;
+
+    return Count;
+}
+
+void FQuadTreeProceduralHeightSource::Generate(const FQuadTreeHeightTile* Parent, FQuadTreeHeightTile& InOutTile) const
+{
+    check(InOutTile.SampleCount > 1 && (InOutTile.SampleCount - 1) % 2 == 0);
+
+    FMemMark Mark(FMemStack::Get());
+
+    const auto SampleCount = InOutTile.SampleCount;
+    const auto OctaveCount = GetOctaveCount(InOutTile.GetSampleSpacing());
+    const auto Level = InOutTile.Key.GetLevel();
+
+    InOutTile.Heights.SetNumUninitialized(SampleCount * SampleCount);
+    InOutTile.Detail = OctaveCount;
+
+    const auto bCanDerive = Parent != nullptr
+        && Parent->SampleCount == SampleCount
+        && Parent->Key.GetLevel() == Level + 1
+        && Parent->Detail <= OctaveCount;
+
+    /* Child's quadrant within its parent, in parent samples */
+    FIntPoint ParentOffset(0, 0);
+    if (bCanDerive)
+    {
+        const auto Quadrant = (InOutTile.Key.GetCoordinates() - Parent->Key.GetCoordinates()) / (1 << Level);
+        ParentOffset = Quadrant * ((SampleCount - 1) / 2);
+    }
+
+    /* Two batches, full evaluation and continuing from the parent, each padded to whole vectors */
+    const auto Capacity = Align(SampleCount * SampleCount, 4);
+    TArray<int32, TMemStackAllocator<>> FullX, FullY, FullIndices, DerivedX, DerivedY, DerivedIndices;
+    TArray<float, TMemStackAllocator<>> FullHeights, DerivedHeights;
+    for (auto* Array : { &FullX, &FullY, &FullIndices, &DerivedX, &DerivedY, &DerivedIndices })
+        Array->Reserve(Capacity);
+
+    FullHeights.Reserve(Capacity);
+    DerivedHeights.Reserve(Capacity);
+
+    for (auto Y = 0; Y < SampleCount; Y++)
+        for (auto X = 0; X < SampleCount; X++)
+        {
+            const auto Index = Y * SampleCount + X;
+            if (bCanDerive && (X & 1) == 0 && (Y & 1) == 0)
+            {
+                DerivedX.Add(X);
+                DerivedY.Add(Y);
+                DerivedHeights.Add(Parent->Heights[(ParentOffset.Y + Y / 2) * SampleCount + ParentOffset.X + X / 2]);
+                DerivedIndices.Add(Index);
+            }
+            else
+            {
+                FullX.Add(X);
+                FullY.Add(Y);
+                FullHeights.Add(0.0f);
+                FullIndices.Add(Index);
+            }
+        }
+
+    auto Evaluate = [this, &InOutTile](TArray<int32, TMemStackAllocator<>>& SampleX, TArray<int32, TMemStackAllocator<>>& SampleY, TArray<float, TMemStackAllocator<>>& Heights, const TArray<int32, TMemStackAllocator<>>& Indices, const int32 FirstOctave, const int32 LastOctave)
+    {
+        const auto Count = Indices.Num();
+        const auto Padding = Align(Count, 4) - Count;
+        SampleX.AddZeroed(Padding);
+        SampleY.AddZeroed(Padding);
+        Heights.AddZeroed(Padding);
+
+        EvaluateOctaves(InOutTile, SampleX.GetData(), SampleY.GetData(), Heights.GetData(), Heights.Num(), FirstOctave, LastOctave);
+
+        for (auto i = 0; i < Count; i++)
+            InOutTile.Heights[Indices[i]] = Heights[i];
+    };
+
+    Evaluate(FullX, FullY, FullHeights, FullIndices, 0, OctaveCount);
+    if (bCanDerive)
+    {
+        Evaluate(DerivedX, DerivedY, DerivedHeights, DerivedIndices, Parent->Detail, OctaveCount);
+        INC_DWORD_STAT_BY(STAT_QuadTreeDerivedHeightSamples, DerivedIndices.Num());
+    }
+
+    InOutTile.UpdateHeightBounds();
+}
+
+void FQuadTreeProceduralHeightSource::EvaluateOctaves(const FQuadTreeHeightTile& Tile, const int32* SampleX, const int32* SampleY, float* InOutHeights, const int32 Count, const int32 FirstOctave, const int32 LastOctave) const
+{
+    check(Count % 4 == 0);
+
+    const auto SampleCount = Tile.SampleCount;
+    const auto Coordinates = Tile.Key.GetCoordinates();
+
+    /*
+    Samples are placed on the global lattice of level 0 samples, a level 0 node has SampleCount - 1
+    of them per side. A sample shared with the parent or a neighbor has the same integer position
+    and goes through the same double math, so its noise is bit identical whichever tile evaluates it.
+    */
+    const auto Stride = (int64)1 << Tile.Key.GetLevel();
+    const auto BaseX = (int64)Coordinates.X * (SampleCount - 1);
+    const auto BaseY = (int64)Coordinates.Y * (SampleCount - 1);
+    const auto LatticeSpacing = (double)Tile.CellSize / (SampleCount - 1);
+
+    /* Per row and column of the tile, the lattice cell in float and the position within it */
+    TArray<float, TMemStackAllocator<>> LatticeX, LatticeY, LocalX, LocalY;
+    for (auto* Array : { &LatticeX, &LatticeY, &LocalX, &LocalY })
+        Array->SetNumUninitialized(SampleCount);
+
+    const auto Two = VectorSetFloat1(2.0f);
+    const auto One = VectorOne();
+
+    for (auto Octave = FirstOctave; Octave < LastOctave; Octave++)
+    {
+        const auto Scale = LatticeSpacing * Frequencies[Octave];
+        for (auto Index = 0; Index < SampleCount; Index++)
+        {
+            const auto PositionX = (double)(BaseX + Index * Stride) * Scale;
+            const auto PositionY = (double)(BaseY + Index * Stride) * Scale;
+            const auto FloorX = FMath::FloorToDouble(PositionX);
+            const auto FloorY = FMath::FloorToDouble(PositionY);
+
+            LatticeX[Index] = (float)(FloorX + LatticeOffsets[Octave].X);
+            LatticeY[Index] = (float)(FloorY + LatticeOffsets[Octave].Y);
+            LocalX[Index] = (float)(PositionX - FloorX);
+            LocalY[Index] = (float)(PositionY - FloorY);
+        }
+
+        const auto Amplitude = VectorSetFloat1(Amplitudes[Octave]);
+
+        for (auto i = 0; i < Count; i += 4)
+        {
+            const auto* X = &SampleX[i];
+            const auto* Y = &SampleY[i];
+
+            const auto CellX = MakeVectorRegister(LatticeX[X[0]], LatticeX[X[1]], LatticeX[X[2]], LatticeX[X[3]]);
+            const auto CellY = MakeVectorRegister(LatticeY[Y[0]], LatticeY[Y[1]], LatticeY[Y[2]], LatticeY[Y[3]]);
+            const auto PositionX = MakeVectorRegister(LocalX[X[0]], LocalX[X[1]], LocalX[X[2]], LocalX[X[3]]);
+            const auto PositionY = MakeVectorRegister(LocalY[Y[0]], LocalY[Y[1]], LocalY[Y[2]], LocalY[Y[3]]);
+
+            /* [-1, 1] */
+            auto Noise = VectorSubtract(VectorMultiply(QuadyNoise::ValueNoise(CellX, CellY, PositionX, PositionY), Two), One);
+            if (Settings.bRidged)
+            {
+                const auto Ridge = VectorSubtract(One, VectorAbs(Noise));
+                Noise = VectorSubtract(VectorMultiply(VectorMultiply(Ridge, Ridge), Two), One);
+            }
+
+            VectorStore(VectorMultiplyAdd(Noise, Amplitude, VectorLoad(&InOutHeights[i])), &InOutHeights[i]);
+        }
+    }
+}
+
+#undef LOCTEXT_NAMESPACE
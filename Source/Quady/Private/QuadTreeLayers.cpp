@@ -0,0 +1,236 @@
+#include "QuadTreeLayers.h"
+
+#include "Quady.h"
+#include "QuadTreeGrid.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Layers"), STAT_QuadTreeLayers, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Layer Loads"), STAT_QuadTreeLayerLoads, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Layer Unloads"), STAT_QuadTreeLayerUnloads, STATGROUP_Quady);
+
+FQuadTreeLayers::FQuadTreeLayers(const FQuadTreeGrid& Grid)
+    : Grid(Grid),
+    LevelCount(0),
+    bHasRoot(false),
+    RootCoordinates(FIntPoint::ZeroValue),
+    ValidMask(0),
+    bDirty(false) { }
+
+void FQuadTreeLayers::Configure(const uint8 LevelCount, const TArray<float>& Ranges, const FIntPoint* RootCoordinates)
+{
+    check(Ranges.Num() == LevelCount);
+
+    this->LevelCount = LevelCount;
+    this->Ranges = Ranges;
+    this->bHasRoot = RootCoordinates != nullptr;
+    this->RootCoordinates = bHasRoot ? *RootCoordinates : FIntPoint::ZeroValue;
+
+    /* Keys of the old cell size or level count mean nothing now */
+    for (auto& Layer : Layers)
+        if (Layer.bIsValid)
+        {
+            Unload(Layer);
+            ApplyRanges(Layer);
+        }
+
+    bDirty = ValidMask != 0;
+}
+
+void FQuadTreeLayers::SetRanges(const TArray<float>& Ranges)
+{
+    check(Ranges.Num() == LevelCount);
+
+    this->Ranges = Ranges;
+    for (auto& Layer : Layers)
+        if (Layer.bIsValid)
+            ApplyRanges(Layer);
+
+    bDirty = ValidMask != 0;
+}
+
+int32 FQuadTreeLayers::AddLayer(const FQuadTreeLayerDesc& Desc)
+{
+    auto Index = Layers.IndexOfByPredicate([](const FLayer& Layer) { return !Layer.bIsValid; });
+    if (Index == INDEX_NONE)
+    {
+        if (Layers.Num() >= MaxLayers)
+            return INDEX_NONE;
+
+        Index = Layers.AddDefaulted();
+    }
+
+    auto& Layer = Layers[Index];
+    Layer.Desc = Desc;
+    Layer.bIsValid = true;
+    ApplyRanges(Layer);
+
+    ValidMask |= 1u << Index;
+    bDirty = true;
+
+    return Index;
+}
+
+void FQuadTreeLayers::RemoveLayer(const int32 Index)
+{
+    check(Layers.IsValidIndex(Index) && Layers[Index].bIsValid);
+
+    auto& Layer = Layers[Index];
+    Unload(Layer);
+
+    /* Drops whatever the callbacks hold */
+    Layer = FLayer();
+    ValidMask &= ~(1u << Index);
+}
+
+void FQuadTreeLayers::Update(const FIntPoint& Cell, const FVector& CellOffset, FQuadTreeLayerHeightBounds GetHeightBounds)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeLayers);
+
+    bDirty = false;
+    if (LevelCount == 0 || ValidMask == 0)
+        return;
+
+    for (auto& Layer : Layers)
+        Layer.Cut.Reset();
+
+    const auto TopLevel = (uint8)(LevelCount - 1);
+    if (bHasRoot)
+    {
+        const auto Mask = GetInRangeMask(Cell, CellOffset, GetHeightBounds, RootCoordinates, TopLevel, ValidMask);
+        if (Mask != 0)
+            SelectNode(Cell, CellOffset, GetHeightBounds, RootCoordinates, TopLevel, Mask);
+    }
+    else
+    {
+        /* Every root tile the widest layer's top range reaches */
+        auto TopRange = 0.0f;
+        for (auto& Layer : Layers)
+            if (Layer.bIsValid)
+                TopRange = FMath::Max(TopRange, Layer.Ranges[TopLevel]);
+
+        const auto TileCells = 1 << TopLevel;
+        const auto RangeCells = FMath::CeilToInt(TopRange / Grid.CellSize) + 1;
+        for (auto Y = FQuadTreeGrid::FloorDivide(Cell.Y - RangeCells, TileCells); Y <= FQuadTreeGrid::FloorDivide(Cell.Y + RangeCells, TileCells); Y++)
+            for (auto X = FQuadTreeGrid::FloorDivide(Cell.X - RangeCells, TileCells); X <= FQuadTreeGrid::FloorDivide(Cell.X + RangeCells, TileCells); X++)
+            {
+                const auto Coordinates = FIntPoint(X * TileCells, Y * TileCells);
+                const auto Mask = GetInRangeMask(Cell, CellOffset, GetHeightBounds, Coordinates, TopLevel, ValidMask);
+                if (Mask != 0)
+                    SelectNode(Cell, CellOffset, GetHeightBounds, Coordinates, TopLevel, Mask);
+            }
+    }
+
+    for (auto Index = 0; Index < Layers.Num(); Index++)
+    {
+        auto& Layer = Layers[Index];
+        if (!Layer.bIsValid)
+            continue;
+
+        auto& Cut = Layer.Cut;
+        for (auto& Key : Layer.Loaded)
+            if (!Cut.Contains(Key))
+            {
+                if (Layer.Desc.OnUnload)
+                    Layer.Desc.OnUnload(Key);
+
+                INC_DWORD_STAT(STAT_QuadTreeLayerUnloads);
+            }
+
+        for (auto& Key : Cut)
+            if (!Layer.Loaded.Contains(Key))
+            {
+                if (Layer.Desc.OnLoad)
+                    Layer.Desc.OnLoad(Key);
+
+                INC_DWORD_STAT(STAT_QuadTreeLayerLoads);
+            }
+
+        Swap(Layer.Loaded, Layer.Cut);
+    }
+}
+
+void FQuadTreeLayers::ApplyRanges(FLayer& Layer) const
+{
+    Layer.Ranges.Reset(Ranges.Num());
+    for (auto Range : Ranges)
+        Layer.Ranges.Add(Range * Layer.Desc.RangeMultiplier);
+}
+
+void FQuadTreeLayers::Unload(FLayer& Layer)
+{
+    if (Layer.Desc.OnUnload)
+        for (auto& Key : Layer.Loaded)
+            Layer.Desc.OnUnload(Key);
+
+    INC_DWORD_STAT_BY(STAT_QuadTreeLayerUnloads, Layer.Loaded.Num());
+    Layer.Loaded.Reset();
+}
+
+void FQuadTreeLayers::SelectNode(const FIntPoint& Cell, const FVector& CellOffset, FQuadTreeLayerHeightBounds GetHeightBounds, const FIntPoint& Coordinates, const uint8 Level, const uint32 Mask)
+{
+    if (Level == 0)
+    {
+        AddLeaf(Coordinates, Level, Mask);
+        return;
+    }
+
+    const auto HalfSize = 1 << (Level - 1);
+    const FIntPoint ChildCoordinates[] = { Coordinates, Coordinates + FIntPoint(HalfSize, 0), Coordinates + FIntPoint(0, HalfSize), Coordinates + FIntPoint(HalfSize, HalfSize) };
+
+    uint32 ChildMasks[4];
+    uint32 Refining = 0;
+    for (auto i = 0; i < 4; i++)
+    {
+        ChildMasks[i] = GetInRangeMask(Cell, CellOffset, GetHeightBounds, ChildCoordinates[i], Level - 1, Mask);
+        Refining |= ChildMasks[i];
+    }
+
+    /* Layers no child is in range for stop here */
+    AddLeaf(Coordinates, Level, Mask & ~Refining);
+
+    /* Constrain, siblings out of a refining layer's range are its leaves */
+    for (auto i = 0; i < 4; i++)
+    {
+        AddLeaf(ChildCoordinates[i], Level - 1, Refining & ~ChildMasks[i]);
+
+        if (ChildMasks[i] != 0)
+            SelectNode(Cell, CellOffset, GetHeightBounds, ChildCoordinates[i], Level - 1, ChildMasks[i]);
+    }
+}
+
+uint32 FQuadTreeLayers::GetInRangeMask(const FIntPoint& Cell, const FVector& CellOffset, FQuadTreeLayerHeightBounds GetHeightBounds, const FIntPoint& Coordinates, const uint8 Level, const uint32 Mask) const
+{
+    if (Mask == 0)
+        return 0;
+
+    /* Relative to the viewer's cell, as FQuadTreeViewer::GetRelativeBounds with the node's height bounds */
+    const auto HeightBounds = GetHeightBounds(FQuadTreeNodeKey(Coordinates, Level));
+    const auto Relative = Coordinates - Cell;
+    const auto Size = (float)(Grid.CellSize << Level);
+    const auto Min = FVector(Relative.X * (float)Grid.CellSize, Relative.Y * (float)Grid.CellSize, HeightBounds.Min);
+    const auto Bounds = FBox(Min, FVector(Min.X + Size, Min.Y + Size, HeightBounds.Max));
+
+    /* One box for every layer, each against its range like the viewer's */
+    uint32 InRange = 0;
+    for (auto Remaining = Mask; Remaining != 0; Remaining &= Remaining - 1)
+    {
+        const auto Index = FMath::CountTrailingZeros(Remaining);
+        if (FBoxSphereBounds::BoxesIntersect(Bounds, FSphere(CellOffset, Layers[Index].Ranges[Level])))
+            InRange |= 1u << Index;
+    }
+
+    return InRange;
+}
+
+void FQuadTreeLayers::AddLeaf(const FIntPoint& Coordinates, const uint8 Level, uint32 Mask)
+{
+    for (; Mask != 0; Mask &= Mask - 1)
+    {
+        const auto Index = FMath::CountTrailingZeros(Mask);
+        if (Level <= Layers[Index].Desc.MaxLevel)
+            Layers[Index].Cut.Add(FQuadTreeNodeKey(Coordinates, Level));
+    }
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -4,19 +4,21 @@
 #include "DrawDebugHelpers.h"
 #endif
 #include "QuadTreeViewer.h"
+#include "QuadTreeGrid.h"
 
 #define LOCTEXT_NAMESPACE "Quady"
 
-FQuadTreeNode::FQuadTreeNode(const FQuadTreeNode* Parent, EQuadrant Quadrant, const FBox& Bounds, const uint8 Level)
-    : Quadrant(Quadrant),
-    Bounds(Bounds),
+FQuadTreeNode::FQuadTreeNode(EQuadrant Quadrant, const FIntPoint& Coordinates, const uint8 Level, const FFloatInterval& HeightBounds)
+    : Key(Coordinates, Level),
+    Quadrant(Quadrant),
+    Coordinates(Coordinates),
+    HeightBounds(HeightBounds),
     Level(Level),
-    bIsSelected(false)
+    bIsSelected(false),
+    bIsOccluded(false),
+    ShadowMask(0)
 {
-    if (Parent == nullptr)
-        Key = FQuadTreeNodeKey(Bounds.Min, Level);
-    else
-        Key = FQuadTreeNodeKey(Parent->Key, Bounds.Min, Quadrant, Level);
+    check(FQuadTreeNodeKey::IsAligned(Coordinates, Level));
 
     if (Level == 0)
         Children.Empty();
@@ -35,21 +37,49 @@ FQuadTreeNode::~FQuadTreeNode()
 
 bool FQuadTreeNode::Select(const TSharedPtr<FQuadTreeViewer>& Viewer)
 {
-    auto RangeSphere = Viewer->GetRange(Level);
+    return Select(Viewer, Viewer->GetShadowViewMask());
+}
 
-    if (Viewer->HasLocationChanged())
+bool FQuadTreeNode::Reselect(const TSharedPtr<FQuadTreeViewer>& Viewer, const FIntRect& Cells)
+{
+    return Select(Viewer, Viewer->GetShadowViewMask(), &Cells);
+}
+
+bool FQuadTreeNode::Select(const TSharedPtr<FQuadTreeViewer>& Viewer, const uint8 ShadowViews, const FIntRect* DirtyCells)
+{
+    /* Untouched by the edit */
+    if (DirtyCells != nullptr && !Intersects(*DirtyCells))
+        return bIsSelected;
+
+    const auto bIsDirty = DirtyCells != nullptr;
+    bIsOccluded = false;
+
+    /* Deselect recursively, stale children would otherwise be picked up as leaves.
+       Shadow ranges are within the main range, so this also deselects every shadow view */
+    if (bIsDirty || Viewer->HasLocationChanged())
     {
-        SetSelected(IsInSphere(RangeSphere.GetSphere()));
-        if(!bIsSelected) return false;
+        SetSelected(IsInRange(Viewer));
+        if(!bIsSelected) { SetSelected(false, true); return false; }
     }
     
     /* TODO: Frustum representation */
-    if (Viewer->HasDirectionChanged())
+    if (bIsDirty || Viewer->HasDirectionChanged())
     {
         SetSelected(IsInFrustum());
-        if(!bIsSelected) return false;
+        if(!bIsSelected) { SetSelected(false, true); return false; }
+    }
+
+    /* Hidden, don't refine. Still casts shadows */
+    if (IsOccluded(Viewer))
+    {
+        SetSelected(false, true);
+        bIsOccluded = true;
+        SelectShadows(Viewer, ShadowViews);
+        return false;
     }
 
+    ShadowMask = Viewer->GetShadowViews(Viewer->GetRelativeBounds(Coordinates, Level, HeightBounds), Level, ShadowViews);
+
     if(Level == 0)
     {
         SetSelected(true);
@@ -57,27 +87,54 @@ bool FQuadTreeNode::Select(const TSharedPtr<FQuadTreeViewer>& Viewer)
     }
     else
     {
-        auto bAnyChildWasSplit = AnyChild([&Viewer](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child)
+        uint8 ChildShadowMask = 0;
+        auto bAnyChildWasSplit = AnyChild([&Viewer, &ChildShadowMask, DirtyCells, this](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child)
         {
-            return Child->Select(Viewer);
+            auto bWasSplit = Child->Select(Viewer, ShadowMask, DirtyCells);
+            ChildShadowMask |= Child->ShadowMask;
+            return bWasSplit;
         }, false);
 
-        /* Constrain, ensures no non-square spaces */
-        if (bAnyChildWasSplit)
-            ForEachChild([](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child) { Child->SetSelected(true); });
+        /* Constrain, ensures no non-square spaces. Occluded siblings stay out, nothing is seen through them */
+        if (bAnyChildWasSplit || ChildShadowMask != 0)
+            ForEachChild([bAnyChildWasSplit, ChildShadowMask](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child) 
+            {
+                if (bAnyChildWasSplit && !Child->bIsOccluded)
+                    Child->SetSelected(true);
+
+                Child->ShadowMask |= ChildShadowMask;
+            });
     }
 
     return true;
 }
 
-bool FQuadTreeNode::Select(const TSharedPtr<FQuadTreeViewer>& Viewer, TSet<FQuadTreeNodeSelectionEvent>& SelectionEvents)
+uint8 FQuadTreeNode::SelectShadows(const TSharedPtr<FQuadTreeViewer>& Viewer, const uint8 ShadowViews)
+{
+    ShadowMask = Viewer->GetShadowViews(Viewer->GetRelativeBounds(Coordinates, Level, HeightBounds), Level, ShadowViews);
+    if (ShadowMask == 0)
+        return 0;
+
+    uint8 ChildShadowMask = 0;
+    ForEachChild([&Viewer, &ChildShadowMask, this](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child)
+    {
+        ChildShadowMask |= Child->SelectShadows(Viewer, ShadowMask);
+    });
+
+    if (ChildShadowMask != 0)
+        ForEachChild([ChildShadowMask](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child) { Child->ShadowMask |= ChildShadowMask; });
+
+    return ShadowMask;
+}
+
+bool FQuadTreeNode::Select(const TSharedPtr<FQuadTreeViewer>& Viewer, FQuadTreeNodeSelectionEvents& SelectionEvents)
 {
-    auto RangeSphere = Viewer->GetRange(Level);
     auto Event = FQuadTreeNodeSelectionEvent(Key);
+    bIsOccluded = false;
 
     if (Viewer->HasLocationChanged())
     {
-        bool bIsInSphere = IsInSphere(RangeSphere.GetSphere());
+        bool bIsInSphere = IsInRange(Viewer);
         if (bIsInSphere)
             Event.Type |= EQuadTreeNodeSelectionEventType::InRange;
         else
@@ -116,6 +173,16 @@ bool FQuadTreeNode::Select(const TSharedPtr<FQuadTreeViewer>& Viewer, TSet<FQuad
         }
     }
 
+    if (IsOccluded(Viewer))
+    {
+        Event.Type |= EQuadTreeNodeSelectionEventType::Occluded;
+        SetSelected(false, true);
+        bIsOccluded = true;
+
+        SelectionEvents.Add(MoveTemp(Event));
+        return false;
+    }
+
     if (Level == 0)
     {
         SetSelected(true);
@@ -130,17 +197,28 @@ bool FQuadTreeNode::Select(const TSharedPtr<FQuadTreeViewer>& Viewer, TSet<FQuad
             return Child->Select(Viewer, SelectionEvents);
         }, false);
 
-        /* Constrain, ensures no non-square spaces */
+        /* Constrain, ensures no non-square spaces. Occluded siblings stay out */
         if (bAnyChildWasSplit)
-            ForEachChild([](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child) { Child->SetSelected(true); });
+            ForEachChild([](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child)
+            {
+                if (!Child->bIsOccluded)
+                    Child->SetSelected(true);
+            });
     }
 
     return true;
 }
 
-const bool FQuadTreeNode::IsInSphere(const FSphere& Sphere)
+const bool FQuadTreeNode::IsInRange(const TSharedPtr<FQuadTreeViewer>& Viewer) const
 {
-    return FBoxSphereBounds::BoxesIntersect(Bounds, Sphere);
+    /* Both relative to the viewers cell, so precision doesn't degrade away from the origin */
+    auto Bounds = Viewer->GetRelativeBounds(Coordinates, Level, HeightBounds);
+    return FBoxSphereBounds::BoxesIntersect(Bounds, Viewer->GetRange(Level).GetSphere());
+}
+
+const bool FQuadTreeNode::IsOccluded(const TSharedPtr<FQuadTreeViewer>& Viewer) const
+{
+    return Viewer->IsOccluded(Viewer->GetRelativeBounds(Coordinates, Level, HeightBounds));
 }
 
 const bool FQuadTreeNode::IsInFrustum()
@@ -148,24 +226,183 @@ const bool FQuadTreeNode::IsInFrustum()
     return true;
 }
 
-void FQuadTreeNode::Draw(const UWorld* World)
+const bool FQuadTreeNode::IsSelectedLeaf() const
+{
+    if (!bIsSelected)
+        return false;
+
+    for (auto& KVP : Children)
+        if (KVP.Value->IsSelected())
+            return false;
+
+    return true;
+}
+
+void FQuadTreeNode::SetHeightBounds(const FFloatInterval& HeightBounds)
+{
+    check(HeightBounds.Min <= HeightBounds.Max);
+
+    this->HeightBounds = HeightBounds;
+}
+
+bool FQuadTreeNode::RefitHeightBounds(const FQuadTreeNodeKey NodeKey, const FFloatInterval& NodeHeightBounds)
+{
+    if (Key == NodeKey)
+    {
+        SetHeightBounds(NodeHeightBounds);
+        return true;
+    }
+
+    const auto NodeCoordinates = NodeKey.GetCoordinates();
+    if (Level <= NodeKey.GetLevel() || !Intersects(FIntRect(NodeCoordinates, NodeCoordinates + FIntPoint(1, 1))))
+        return false;
+
+    /* Only the child on the path, O(depth) */
+    auto bFound = false;
+    for (auto& KVP : Children)
+        if (KVP.Value->RefitHeightBounds(NodeKey, NodeHeightBounds))
+        {
+            bFound = true;
+            break;
+        }
+
+    if (!bFound)
+        return false;
+
+    auto bFirst = true;
+    for (auto& KVP : Children)
+    {
+        const auto& ChildHeightBounds = KVP.Value->GetHeightBounds();
+        if (bFirst)
+            HeightBounds = ChildHeightBounds;
+        else
+            HeightBounds = FFloatInterval(FMath::Min(HeightBounds.Min, ChildHeightBounds.Min), FMath::Max(HeightBounds.Max, ChildHeightBounds.Max));
+
+        bFirst = false;
+    }
+
+    return true;
+}
+
+bool FQuadTreeNode::ResetDescendantHeightBounds(const FQuadTreeNodeKey NodeKey, const FIntRect& Cells, const float CellSize)
+{
+    if (Key == NodeKey)
+    {
+        /* Only within the edit, O(edit area) per level */
+        for (auto& KVP : Children)
+            if (KVP.Value->Intersects(Cells))
+            {
+                const auto HalfHeight = KVP.Value->GetSizeInCells() * CellSize * 0.5f;
+                KVP.Value->HeightBounds = FFloatInterval(-HalfHeight, HalfHeight);
+                KVP.Value->ResetDescendantHeightBounds(KVP.Value->Key, Cells, CellSize);
+            }
+
+        return true;
+    }
+
+    const auto NodeCoordinates = NodeKey.GetCoordinates();
+    if (Level <= NodeKey.GetLevel() || !Intersects(FIntRect(NodeCoordinates, NodeCoordinates + FIntPoint(1, 1))))
+        return false;
+
+    for (auto& KVP : Children)
+        if (KVP.Value->ResetDescendantHeightBounds(NodeKey, Cells, CellSize))
+            return true;
+
+    return false;
+}
+
+bool FQuadTreeNode::FindHeightBounds(const FQuadTreeNodeKey NodeKey, FFloatInterval& OutHeightBounds) const
+{
+    if (Key == NodeKey)
+    {
+        OutHeightBounds = HeightBounds;
+        return true;
+    }
+
+    const auto NodeCoordinates = NodeKey.GetCoordinates();
+    if (Level <= NodeKey.GetLevel() || !Intersects(FIntRect(NodeCoordinates, NodeCoordinates + FIntPoint(1, 1))))
+        return false;
+
+    for (auto& KVP : Children)
+        if (KVP.Value->FindHeightBounds(NodeKey, OutHeightBounds))
+            return true;
+
+    return false;
+}
+
+const bool FQuadTreeNode::Intersects(const FIntRect& Cells) const
+{
+    const auto Size = GetSizeInCells();
+    return Coordinates.X < Cells.Max.X && Coordinates.X + Size > Cells.Min.X
+        && Coordinates.Y < Cells.Max.Y && Coordinates.Y + Size > Cells.Min.Y;
+}
+
+void FQuadTreeNode::ForEachNode(TFunctionRef<void(FQuadTreeNode&)> Func)
+{
+    Func(*this);
+
+    for (auto& KVP : Children)
+        KVP.Value->ForEachNode(Func);
+}
+
+void FQuadTreeNode::ForEachSelectedLeaf(TFunctionRef<void(const FQuadTreeNode&)> Func) const
+{
+    if (!bIsSelected)
+        return;
+
+    auto bAnyChildSelected = false;
+    for (auto& KVP : Children)
+    {
+        if (!KVP.Value->IsSelected())
+            continue;
+
+        bAnyChildSelected = true;
+        KVP.Value->ForEachSelectedLeaf(Func);
+    }
+
+    if (!bAnyChildSelected)
+        Func(*this);
+}
+
+void FQuadTreeNode::ForEachShadowLeaf(const int32 View, TFunctionRef<void(const FQuadTreeNode&)> Func) const
+{
+    const auto Bit = (uint8)(1 << View);
+    if ((ShadowMask & Bit) == 0)
+        return;
+
+    auto bAnyChildSelected = false;
+    for (auto& KVP : Children)
+    {
+        if ((KVP.Value->ShadowMask & Bit) == 0)
+            continue;
+
+        bAnyChildSelected = true;
+        KVP.Value->ForEachShadowLeaf(View, Func);
+    }
+
+    if (!bAnyChildSelected)
+        Func(*this);
+}
+
+void FQuadTreeNode::Draw(const UWorld* World, const FQuadTreeGrid& Grid)
 {
 #if !UE_BUILD_SHIPPING
     if (!bIsSelected)
         return;
 
-    auto Center = Bounds.GetCenter();
-    auto Extent = Bounds.GetExtent();
+    auto HalfSize = GetSizeInCells() * Grid.CellSize * 0.5f;
+    auto Extent = FVector(HalfSize, HalfSize, HeightBounds.Size() * 0.5f);
+    auto Center = Grid.ToWorld(Coordinates) + FVector(HalfSize, HalfSize, 0.0f);
 
-    Center.Z = Level * 100.0f;
+    Center.Z += Level * 100.0f;
 
     //DrawDebugBox(World, Center, Extent, FQuat::Identity, FColor::White);
 
     Extent.Z = 0.0f;
     DrawDebugBox(World, Center, Extent, FQuat::Identity, FColor::Red);
 
-    ForEachChild([&World](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child) {
-        Child->Draw(World);
+    ForEachChild([&World, &Grid](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child) {
+        Child->Draw(World, Grid);
     });
 #endif
 }
@@ -176,25 +413,17 @@ bool FQuadTreeNode::Split()
     if (Children.Num() > 0 || Level == 0)
         return false;
 
-    auto& Min = Bounds.Min;
-    auto& Max = Bounds.Max;
-
-    auto HalfSize = (Max - Min) * 0.5f; 
-    auto QuarterSize = HalfSize * 0.5f;
+    static const EQuadrant Quadrants[] = { EQuadrant::TopLeft, EQuadrant::TopRight, EQuadrant::BottomLeft, EQuadrant::BottomRight };
 
+    auto HalfSize = GetSizeInCells() >> 1;
+    auto ChildHeightBounds = GetChildHeightBounds();
     auto NextLevel = Level - 1;
 
-    const auto TopLeft = FBox(FVector(Min.X + HalfSize.X, Min.Y, -QuarterSize.Z), FVector(Max.X, Min.Y + HalfSize.Y, QuarterSize.Z));
-    Children.Emplace(EQuadrant::TopLeft, MakeShareable(new FQuadTreeNode(this, EQuadrant::TopLeft, TopLeft, NextLevel)));
-
-    const auto TopRight = FBox(FVector(Min.X + HalfSize.X, Min.Y + HalfSize.Y, -QuarterSize.Z), FVector(Max.X, Max.Y, QuarterSize.Z));
-    Children.Emplace(EQuadrant::TopRight, MakeShareable(new FQuadTreeNode(this, EQuadrant::TopRight, TopRight, NextLevel)));
-
-    const auto BottomLeft = FBox(FVector(Min.X, Min.Y, -QuarterSize.Z), FVector(Min.X + HalfSize.X, Min.Y + HalfSize.Y, QuarterSize.Z));
-    Children.Emplace(EQuadrant::BottomLeft, MakeShareable(new FQuadTreeNode(this, EQuadrant::BottomLeft, BottomLeft, NextLevel)));
-
-    const auto BottomRight = FBox(FVector(Min.X, Min.Y + HalfSize.Y, -QuarterSize.Z), FVector(Min.X + HalfSize.X, Max.Y, QuarterSize.Z));
-    Children.Emplace(EQuadrant::BottomRight, MakeShareable(new FQuadTreeNode(this, EQuadrant::BottomRight, BottomRight, NextLevel)));
+    for (auto ChildQuadrant : Quadrants)
+    {
+        auto ChildCoordinates = Coordinates + GetQuadrantOffset(ChildQuadrant, HalfSize);
+        Children.Emplace(ChildQuadrant, MakeShareable(new FQuadTreeNode(ChildQuadrant, ChildCoordinates, NextLevel, ChildHeightBounds)));
+    }
     
     return true;
 }
@@ -203,17 +432,59 @@ void FQuadTreeNode::Empty()
 {
 }
 
+void FQuadTreeNode::Reset(const FIntPoint& Coordinates, const FFloatInterval& HeightBounds)
+{
+    this->Key = FQuadTreeNodeKey(Coordinates, Level);
+    this->Coordinates = Coordinates;
+    this->HeightBounds = HeightBounds;
+    this->bIsSelected = false;
+    this->bIsOccluded = false;
+    this->ShadowMask = 0;
+
+    auto HalfSize = GetSizeInCells() >> 1;
+    auto ChildHeightBounds = GetChildHeightBounds();
+    for (auto& KVP : Children)
+        KVP.Value->Reset(Coordinates + GetQuadrantOffset(KVP.Key, HalfSize), ChildHeightBounds);
+}
+
+FIntPoint FQuadTreeNode::GetQuadrantOffset(const EQuadrant Quadrant, const int32 HalfSize)
+{
+    switch (Quadrant)
+    {
+    case EQuadrant::TopLeft:
+        return FIntPoint(HalfSize, 0);
+    case EQuadrant::TopRight:
+        return FIntPoint(HalfSize, HalfSize);
+    case EQuadrant::BottomRight:
+        return FIntPoint(0, HalfSize);
+    default:
+        return FIntPoint::ZeroValue;
+    }
+}
+
+FFloatInterval FQuadTreeNode::GetChildHeightBounds() const
+{
+    auto QuarterHeight = HeightBounds.Size() * 0.25f;
+    return FFloatInterval(-QuarterHeight, QuarterHeight);
+}
+
 void FQuadTreeNode::SetSelected(const bool bIsSelected, const bool bRecursive /*= false*/)
 {
     this->bIsSelected = bIsSelected;
 
+    /* Shadow cuts are subsets of the main selection, except under occluded nodes */
+    if (!bIsSelected)
+        ShadowMask = 0;
+
+    /* Unselected nodes never have selected children, so deselecting can stop at them */
     if(bRecursive)
         ForEachChild([&bIsSelected, &bRecursive](EQuadrant Quadrant, TSharedPtr<FQuadTreeNode>& Child) {
-            Child->SetSelected(bIsSelected, bRecursive);
+            if (bIsSelected || Child->IsSelected() || Child->ShadowMask != 0)
+                Child->SetSelected(bIsSelected, bRecursive);
         });
 }
 
-void FQuadTreeNode::ForEachChild(TFunction<void(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func)
+void FQuadTreeNode::ForEachChild(TFunctionRef<void(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func)
 {
     if (Children.Num() > 0)
     {
@@ -222,7 +493,7 @@ void FQuadTreeNode::ForEachChild(TFunction<void(EQuadrant, TSharedPtr<FQuadTreeN
     }
 }
 
-bool FQuadTreeNode::AnyChild(TFunction<bool(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func, bool bTerminateOnFirst)
+bool FQuadTreeNode::AnyChild(TFunctionRef<bool(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func, bool bTerminateOnFirst)
 {
     bool bResult = false;
 
@@ -0,0 +1,161 @@
+#include "QuadTreeOcclusion.h"
+
+#include "Quady.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Occluded Nodes"), STAT_QuadTreeOccludedNodes, STATGROUP_Quady);
+
+/* Split an inclusive, possibly wrapping, bin range into contiguous [Begin, End) runs. Func returns false to stop */
+template <typename FuncType>
+static FORCEINLINE void ForEachBinRun(const int32 First, const int32 Last, const int32 Resolution, FuncType Func)
+{
+    if (Last < First)
+        return;
+
+    const auto Count = FMath::Min(Last - First + 1, Resolution);
+    const auto Begin = First & (Resolution - 1);
+    const auto FirstRun = FMath::Min(Count, Resolution - Begin);
+
+    if (Func(Begin, Begin + FirstRun) && Count > FirstRun)
+        Func(0, Count - FirstRun);
+}
+
+FQuadTreeOcclusionBuffer::FQuadTreeOcclusionBuffer(const int32 Resolution)
+    : Resolution(Resolution),
+    EyeLocation(FVector::ZeroVector),
+    MaxOccluderDistance(0.0f),
+    OccluderCount(0)
+{
+    check(Resolution >= 4 && FMath::IsPowerOfTwo(Resolution));
+
+    Horizon.Init(-BIG_NUMBER, Resolution);
+}
+
+void FQuadTreeOcclusionBuffer::Reset(const FVector& EyeLocation)
+{
+    this->EyeLocation = EyeLocation;
+    MaxOccluderDistance = 0.0f;
+    OccluderCount = 0;
+
+    const auto Empty = VectorSetFloat1(-BIG_NUMBER);
+    for (auto Index = 0; Index < Resolution; Index += 4)
+        VectorStoreAligned(Empty, &Horizon[Index]);
+}
+
+void FQuadTreeOcclusionBuffer::AddOccluder(const FBox& RelativeBounds)
+{
+    int32 FirstOverlap, LastOverlap, FirstInside, LastInside;
+    float MinDistance, MaxDistance;
+    if (!GetBins(RelativeBounds, FirstOverlap, LastOverlap, FirstInside, LastInside, MinDistance, MaxDistance))
+        return;
+
+    /* Lowest the solid part can appear from the eye, only bins it fully covers */
+    const auto Height = RelativeBounds.Min.Z - EyeLocation.Z;
+    const auto Slope = Height / (Height > 0.0f ? MaxDistance : MinDistance);
+    const auto SlopeVector = VectorSetFloat1(Slope);
+
+    ForEachBinRun(FirstInside, LastInside, Resolution, [this, Slope, SlopeVector](const int32 Begin, const int32 End)
+    {
+        auto Index = Begin;
+        for (; Index < End && (Index & 3) != 0; Index++)
+            Horizon[Index] = FMath::Max(Horizon[Index], Slope);
+
+        for (; Index + 4 <= End; Index += 4)
+        {
+            auto* Bins = &Horizon[Index];
+            VectorStoreAligned(VectorMax(VectorLoadAligned(Bins), SlopeVector), Bins);
+        }
+
+        for (; Index < End; Index++)
+            Horizon[Index] = FMath::Max(Horizon[Index], Slope);
+
+        return true;
+    });
+
+    MaxOccluderDistance = FMath::Max(MaxOccluderDistance, MaxDistance);
+    OccluderCount++;
+}
+
+bool FQuadTreeOcclusionBuffer::IsOccluded(const FBox& RelativeBounds) const
+{
+    if (OccluderCount == 0)
+        return false;
+
+    int32 FirstOverlap, LastOverlap, FirstInside, LastInside;
+    float MinDistance, MaxDistance;
+    if (!GetBins(RelativeBounds, FirstOverlap, LastOverlap, FirstInside, LastInside, MinDistance, MaxDistance))
+        return false;
+
+    /* Horizon is only valid for what is behind every occluder */
+    if (MinDistance <= MaxOccluderDistance)
+        return false;
+
+    /* Highest the node can appear from the eye, every bin it touches */
+    const auto Height = RelativeBounds.Max.Z - EyeLocation.Z;
+    const auto Slope = Height / (Height > 0.0f ? MinDistance : MaxDistance);
+    const auto SlopeVector = VectorSetFloat1(Slope);
+
+    auto bIsVisible = false;
+    ForEachBinRun(FirstOverlap, LastOverlap, Resolution, [this, Slope, SlopeVector, &bIsVisible](const int32 Begin, const int32 End)
+    {
+        /* Level with the horizon is visible, both paths compare the same way */
+        auto Index = Begin;
+        for (; Index < End && (Index & 3) != 0; Index++)
+            bIsVisible |= Slope >= Horizon[Index];
+
+        for (; Index + 4 <= End && !bIsVisible; Index += 4)
+            bIsVisible |= VectorMaskBits(VectorCompareGE(SlopeVector, VectorLoadAligned(&Horizon[Index]))) != 0;
+
+        for (; Index < End; Index++)
+            bIsVisible |= Slope >= Horizon[Index];
+
+        /* Stop at the first visible bin */
+        return !bIsVisible;
+    });
+
+    if (!bIsVisible)
+        INC_DWORD_STAT(STAT_QuadTreeOccludedNodes);
+
+    return !bIsVisible;
+}
+
+bool FQuadTreeOcclusionBuffer::GetBins(const FBox& RelativeBounds, int32& OutFirstOverlap, int32& OutLastOverlap, int32& OutFirstInside, int32& OutLastInside, float& OutMinDistance, float& OutMaxDistance) const
+{
+    const auto Min = FVector2D(RelativeBounds.Min.X - EyeLocation.X, RelativeBounds.Min.Y - EyeLocation.Y);
+    const auto Max = FVector2D(RelativeBounds.Max.X - EyeLocation.X, RelativeBounds.Max.Y - EyeLocation.Y);
+
+    /* Spans every direction */
+    if (Min.X <= 0.0f && Max.X >= 0.0f && Min.Y <= 0.0f && Max.Y >= 0.0f)
+        return false;
+
+    OutMinDistance = FVector2D(FMath::Clamp(0.0f, Min.X, Max.X), FMath::Clamp(0.0f, Min.Y, Max.Y)).Size();
+    OutMaxDistance = FVector2D(FMath::Max(-Min.X, Max.X), FMath::Max(-Min.Y, Max.Y)).Size();
+
+    /* Outside the footprint its angular span is under PI, measure corners from the center direction */
+    const auto Center = (Min + Max) * 0.5f;
+    const auto CenterAngle = FMath::Atan2(Center.Y, Center.X);
+    const FVector2D Corners[] = { Min, FVector2D(Max.X, Min.Y), Max, FVector2D(Min.X, Max.Y) };
+
+    auto MinDelta = 0.0f;
+    auto MaxDelta = 0.0f;
+    for (auto& Corner : Corners)
+    {
+        const auto Delta = FMath::UnwindRadians(FMath::Atan2(Corner.Y, Corner.X) - CenterAngle);
+        MinDelta = FMath::Min(MinDelta, Delta);
+        MaxDelta = FMath::Max(MaxDelta, Delta);
+    }
+
+    const auto BinsPerRadian = Resolution / (2.0f * PI);
+    const auto Start = (CenterAngle + MinDelta) * BinsPerRadian;
+    const auto End = (CenterAngle + MaxDelta) * BinsPerRadian;
+
+    OutFirstOverlap = FMath::FloorToInt(Start);
+    OutLastOverlap = FMath::FloorToInt(End);
+    OutFirstInside = FMath::CeilToInt(Start);
+    OutLastInside = FMath::FloorToInt(End) - 1;
+
+    return true;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,251 @@
+#include "QuadTreeRelevancy.h"
+
+#include "Quady.h"
+#include "QuadTreeGrid.h"
+#include "GameFramework/Actor.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Relevancy"), STAT_QuadTreeRelevancy, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Relevancy Leaves"), STAT_QuadTreeRelevancyLeaves, STATGROUP_Quady);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("QuadTree Relevancy Actors"), STAT_QuadTreeRelevancyActors, STATGROUP_Quady);
+
+FQuadTreeRelevancy::FQuadTreeRelevancy(const FQuadTreeGrid& Grid)
+    : Grid(Grid),
+    LevelCount(0),
+    bHasRoot(false),
+    RootCoordinates(FIntPoint::ZeroValue) { }
+
+void FQuadTreeRelevancy::Configure(const uint8 LevelCount, const TArray<float>& Ranges, const FIntPoint* RootCoordinates)
+{
+    check(Ranges.Num() == LevelCount);
+
+    this->LevelCount = LevelCount;
+    this->Ranges = Ranges;
+    this->bHasRoot = RootCoordinates != nullptr;
+    this->RootCoordinates = bHasRoot ? *RootCoordinates : FIntPoint::ZeroValue;
+
+    /* Cell size or level count may have changed */
+    Buckets.Empty(LevelCount);
+    Buckets.AddDefaulted(LevelCount);
+    Clients.Empty();
+
+    TArray<TWeakObjectPtr<AActor>> Actors;
+    ActorCells.GetKeys(Actors);
+    ActorCells.Empty(Actors.Num());
+
+    for (auto& Actor : Actors)
+        if (Actor.IsValid())
+            Register(Actor.Get());
+
+    SET_DWORD_STAT(STAT_QuadTreeRelevancyActors, ActorCells.Num());
+}
+
+void FQuadTreeRelevancy::SetRanges(const TArray<float>& Ranges)
+{
+    check(Ranges.Num() == LevelCount);
+
+    this->Ranges = Ranges;
+    Clients.Empty();
+}
+
+void FQuadTreeRelevancy::Register(AActor* Actor)
+{
+    check(Actor);
+
+    if (ActorCells.Contains(Actor) || Buckets.Num() == 0)
+        return;
+
+    FIntPoint Cell;
+    FVector CellOffset;
+    Grid.ToCell(Actor->GetActorLocation(), Cell, CellOffset);
+
+    ActorCells.Add(Actor, Cell);
+    AddToBuckets(Actor, Cell);
+
+    SET_DWORD_STAT(STAT_QuadTreeRelevancyActors, ActorCells.Num());
+}
+
+void FQuadTreeRelevancy::Unregister(AActor* Actor)
+{
+    FIntPoint Cell;
+    if (!ActorCells.RemoveAndCopyValue(Actor, Cell))
+        return;
+
+    RemoveFromBuckets(Actor, Cell);
+
+    SET_DWORD_STAT(STAT_QuadTreeRelevancyActors, ActorCells.Num());
+}
+
+void FQuadTreeRelevancy::Update(AActor* Actor)
+{
+    auto* PreviousCell = ActorCells.Find(Actor);
+    if (PreviousCell == nullptr)
+        return;
+
+    FIntPoint Cell;
+    FVector CellOffset;
+    Grid.ToCell(Actor->GetActorLocation(), Cell, CellOffset);
+
+    if (Cell == *PreviousCell)
+        return;
+
+    RemoveFromBuckets(Actor, *PreviousCell);
+    AddToBuckets(Actor, Cell);
+    *PreviousCell = Cell;
+}
+
+void FQuadTreeRelevancy::GetRelevantActors(const UObject* Client, const FVector& ViewLocation, TArray<FQuadTreeRelevantActor>& OutActors)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeRelevancy);
+
+    if (LevelCount == 0)
+        return;
+
+    FIntPoint Cell;
+    FVector CellOffset;
+    Grid.ToCell(ViewLocation, Cell, CellOffset);
+
+    /* Cuts are per cell, the offset within a cell only matters at range edges */
+    auto* Cut = Clients.Find(Client);
+    if (Cut == nullptr || Cut->Cell != Cell)
+    {
+        if (Cut == nullptr)
+            Cut = &Clients.Add(Client);
+
+        Cut->Cell = Cell;
+        Cut->Leaves.Reset();
+        SelectCut(Cell, FVector(Grid.CellSize * 0.5f, Grid.CellSize * 0.5f, 0.0f), Cut->Leaves);
+    }
+
+    INC_DWORD_STAT_BY(STAT_QuadTreeRelevancyLeaves, Cut->Leaves.Num());
+
+    for (auto& Leaf : Cut->Leaves)
+    {
+        const auto Priority = (float)(LevelCount - Leaf.Level) / LevelCount;
+        GatherBucket(Leaf.Coordinates, Leaf.Level, Priority, Leaf.Level, OutActors);
+    }
+}
+
+void FQuadTreeRelevancy::RemoveClient(const UObject* Client)
+{
+    Clients.Remove(Client);
+}
+
+void FQuadTreeRelevancy::AddToBuckets(AActor* Actor, const FIntPoint& Cell)
+{
+    for (uint8 Level = 0; Level < LevelCount; Level++)
+        Buckets[Level].FindOrAdd(FQuadTreeNodeKey(Cell, Level)).Add(Actor);
+}
+
+void FQuadTreeRelevancy::RemoveFromBuckets(AActor* Actor, const FIntPoint& Cell)
+{
+    for (uint8 Level = 0; Level < LevelCount; Level++)
+    {
+        const auto Key = FQuadTreeNodeKey(Cell, Level);
+        if (auto* Bucket = Buckets[Level].Find(Key))
+        {
+            Bucket->RemoveSwap(Actor);
+            if (Bucket->Num() == 0)
+                Buckets[Level].Remove(Key);
+        }
+    }
+}
+
+void FQuadTreeRelevancy::SelectCut(const FIntPoint& Cell, const FVector& CellOffset, TArray<FCutLeaf>& OutLeaves) const
+{
+    const auto TopLevel = (uint8)(LevelCount - 1);
+    if (bHasRoot)
+    {
+        if (IsInRange(Cell, CellOffset, RootCoordinates, TopLevel))
+            SelectNode(Cell, CellOffset, RootCoordinates, TopLevel, OutLeaves);
+
+        return;
+    }
+
+    /* Tiled, every root tile the top range reaches, same as UQuadTree::UpdateTiles */
+    const auto TileCells = 1 << TopLevel;
+    const auto RangeCells = FMath::CeilToInt(Ranges[TopLevel] / Grid.CellSize) + 1;
+    for (auto Y = FQuadTreeGrid::FloorDivide(Cell.Y - RangeCells, TileCells); Y <= FQuadTreeGrid::FloorDivide(Cell.Y + RangeCells, TileCells); Y++)
+        for (auto X = FQuadTreeGrid::FloorDivide(Cell.X - RangeCells, TileCells); X <= FQuadTreeGrid::FloorDivide(Cell.X + RangeCells, TileCells); X++)
+        {
+            const auto Coordinates = FIntPoint(X * TileCells, Y * TileCells);
+            if (IsInRange(Cell, CellOffset, Coordinates, TopLevel))
+                SelectNode(Cell, CellOffset, Coordinates, TopLevel, OutLeaves);
+        }
+}
+
+void FQuadTreeRelevancy::SelectNode(const FIntPoint& Cell, const FVector& CellOffset, const FIntPoint& Coordinates, const uint8 Level, TArray<FCutLeaf>& OutLeaves) const
+{
+    if (Level == 0)
+    {
+        OutLeaves.Add(FCutLeaf{ Coordinates, Level });
+        return;
+    }
+
+    const auto HalfSize = 1 << (Level - 1);
+    const FIntPoint ChildCoordinates[] = { Coordinates, Coordinates + FIntPoint(HalfSize, 0), Coordinates + FIntPoint(0, HalfSize), Coordinates + FIntPoint(HalfSize, HalfSize) };
+
+    bool bInRange[4];
+    auto bAnyInRange = false;
+    for (auto i = 0; i < 4; i++)
+    {
+        bInRange[i] = IsInRange(Cell, CellOffset, ChildCoordinates[i], Level - 1);
+        bAnyInRange |= bInRange[i];
+    }
+
+    if (!bAnyInRange)
+    {
+        OutLeaves.Add(FCutLeaf{ Coordinates, Level });
+        return;
+    }
+
+    /* Constrain, siblings out of range are leaves while the parent's range reaches them. Unlike selection the cut
+       needn't cover the root, so the rest are dropped and actors beyond the ranges are culled */
+    for (auto i = 0; i < 4; i++)
+    {
+        if (bInRange[i])
+            SelectNode(Cell, CellOffset, ChildCoordinates[i], Level - 1, OutLeaves);
+        else if (IsInRange(Cell, CellOffset, ChildCoordinates[i], Level - 1, Ranges[Level]))
+            OutLeaves.Add(FCutLeaf{ ChildCoordinates[i], (uint8)(Level - 1) });
+    }
+}
+
+bool FQuadTreeRelevancy::IsInRange(const FIntPoint& Cell, const FVector& CellOffset, const FIntPoint& Coordinates, const uint8 Level) const
+{
+    return IsInRange(Cell, CellOffset, Coordinates, Level, Ranges[Level]);
+}
+
+bool FQuadTreeRelevancy::IsInRange(const FIntPoint& Cell, const FVector& CellOffset, const FIntPoint& Coordinates, const uint8 Level, const float Range) const
+{
+    /* Relative to the client's cell like FQuadTreeViewer::GetRelativeBounds, flat since relevancy is 2D */
+    const auto Relative = Coordinates - Cell;
+    const auto Size = (float)(Grid.CellSize << Level);
+    const auto Min = FVector(Relative.X * (float)Grid.CellSize, Relative.Y * (float)Grid.CellSize, 0.0f);
+
+    return FMath::SphereAABBIntersection(FSphere(CellOffset, Range), FBox(Min, FVector(Min.X + Size, Min.Y + Size, 0.0f)));
+}
+
+void FQuadTreeRelevancy::GatherBucket(const FIntPoint& Coordinates, const uint8 Level, const float Priority, const uint8 LeafLevel, TArray<FQuadTreeRelevantActor>& OutActors) const
+{
+    /* Buckets are aligned to their size, an unaligned root is covered by its children's */
+    const auto Size = 1 << Level;
+    if (Level > 0 && ((Coordinates.X | Coordinates.Y) & (Size - 1)) != 0)
+    {
+        const auto HalfSize = Size >> 1;
+        for (auto i = 0; i < 4; i++)
+            GatherBucket(Coordinates + FIntPoint((i & 1) * HalfSize, (i >> 1) * HalfSize), Level - 1, Priority, LeafLevel, OutActors);
+
+        return;
+    }
+
+    const auto* Bucket = Buckets[Level].Find(FQuadTreeNodeKey(Coordinates, Level));
+    if (Bucket == nullptr)
+        return;
+
+    for (auto& Actor : *Bucket)
+        if (auto* ValidActor = Actor.Get())
+            OutActors.Emplace(ValidActor, Priority, LeafLevel);
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,217 @@
+#include "QuadTreeScatter.h"
+
+#include "Quady.h"
+#include "Async.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Scatter Generate"), STAT_QuadTreeScatterGenerate, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Scatter Leaves Generated"), STAT_QuadTreeScatterLeavesGenerated, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Scatter Slot Writes"), STAT_QuadTreeScatterSlotWrites, STATGROUP_Quady);
+
+namespace QuadyScatter
+{
+    /* Released pooled leaves beyond this are freed */
+    static const int32 MaxPooledLeaves = 64;
+}
+
+FQuadTreeScatter::FQuadTreeScatter(const TArray<FQuadTreeScatterLayer>& InLayers)
+    : MaxLevel(-1),
+    bSelectionChanged(false)
+{
+    for (auto& Settings : InLayers)
+    {
+        Layers.Add(FLayer{ Settings, 0, TArray<int32>() });
+        MaxLevel = FMath::Max(MaxLevel, Settings.MaxLevel);
+    }
+}
+
+void FQuadTreeScatter::SetSelection(const TArray<FQuadTreeLeaf>& InLeaves)
+{
+    Selection.Reset();
+    for (auto& Leaf : InLeaves)
+        if (Leaf.Level <= MaxLevel)
+            Selection.Add(Leaf.Key);
+
+    bSelectionChanged = true;
+}
+
+void FQuadTreeScatter::Update(TFunctionRef<FQuadTreeHeightTilePtr(const FQuadTreeNodeKey)> FindTile, TArray<FQuadTreeScatterWrite>& OutWrites)
+{
+    const auto FirstWrite = OutWrites.Num();
+
+    for (auto Index = Releasing.Num() - 1; Index >= 0; Index--)
+        if (Releasing[Index]->Task.IsReady())
+        {
+            Release(Releasing[Index], OutWrites);
+            Releasing.RemoveAtSwap(Index, 1, false);
+        }
+
+    if (bSelectionChanged)
+    {
+        bSelectionChanged = false;
+
+        for (auto It = Leaves.CreateIterator(); It; ++It)
+            if (!Selection.Contains(It.Key()))
+            {
+                Release(It.Value(), OutWrites);
+                It.RemoveCurrent();
+            }
+
+        for (auto& Key : Selection)
+        {
+            if (Leaves.Contains(Key))
+                continue;
+
+            TSharedPtr<FLeaf, ESPMode::ThreadSafe> Leaf = Pool.Num() > 0 ? Pool.Pop(false) : MakeShared<FLeaf, ESPMode::ThreadSafe>();
+            Leaf->Key = Key;
+            Leaf->bIsWritten = false;
+            Leaf->Instances.SetNum(Layers.Num());
+            Leaf->Slots.SetNum(Layers.Num());
+            Leaves.Add(Key, Leaf);
+        }
+    }
+
+    for (auto& KVP : Leaves)
+    {
+        const auto& Leaf = KVP.Value;
+        if (Leaf->bIsWritten)
+            continue;
+
+        if (!Leaf->Task.IsValid())
+        {
+            auto Tile = FindTile(Leaf->Key);
+            if (!Tile.IsValid())
+                continue;
+
+            /* Settings are copied, the task may outlive this */
+            TArray<FQuadTreeScatterLayer> Settings;
+            for (auto& Layer : Layers)
+                Settings.Add(Layer.Settings);
+
+            Leaf->Task = Async<void>(EAsyncExecution::TaskGraph, [Leaf, Tile, Settings = MoveTemp(Settings)]()
+            {
+                SCOPE_CYCLE_COUNTER(STAT_QuadTreeScatterGenerate);
+
+                for (auto Layer = 0; Layer < Settings.Num(); Layer++)
+                    Generate(Settings[Layer], Layer, *Tile, Leaf->Instances[Layer]);
+            });
+
+            INC_DWORD_STAT(STAT_QuadTreeScatterLeavesGenerated);
+            continue;
+        }
+
+        if (!Leaf->Task.IsReady())
+            continue;
+
+        Leaf->Task = TFuture<void>();
+        Leaf->bIsWritten = true;
+
+        for (auto Layer = 0; Layer < Layers.Num(); Layer++)
+        {
+            for (auto& Transform : Leaf->Instances[Layer])
+            {
+                const auto Slot = AllocateSlot(Layer);
+                Leaf->Slots[Layer].Add(Slot);
+                OutWrites.Add(FQuadTreeScatterWrite{ Layer, Slot, Transform });
+            }
+
+            /* Only slots are kept, the component holds the transforms */
+            Leaf->Instances[Layer].Reset();
+        }
+    }
+
+    INC_DWORD_STAT_BY(STAT_QuadTreeScatterSlotWrites, OutWrites.Num() - FirstWrite);
+}
+
+void FQuadTreeScatter::Generate(const FQuadTreeScatterLayer& Layer, const int32 LayerIndex, const FQuadTreeHeightTile& Tile, TArray<FTransform>& OutInstances)
+{
+    OutInstances.Reset();
+
+    const auto Level = Tile.Key.GetLevel();
+    if (Level > Layer.MaxLevel || Layer.Density <= 0.0f || Tile.SampleCount < 2)
+        return;
+
+    FRandomStream Random(HashCombine(GetTypeHash(Tile.Key), GetTypeHash(Layer.Seed + LayerIndex)));
+
+    /* Fractional instances are rounded by chance, so sparse layers still average out */
+    const auto Size = (float)(Tile.CellSize << Level);
+    const auto Expected = Layer.Density * FMath::Square(Size / 1000.0f) * FMath::Pow(Layer.LevelFalloff, Level);
+    const auto Count = FMath::Min(FMath::FloorToInt(Expected + Random.GetFraction()), Layer.MaxInstancesPerLeaf);
+    if (Count <= 0)
+        return;
+
+    OutInstances.Reserve(Count);
+
+    const auto Last = Tile.SampleCount - 1;
+    const auto Spacing = Tile.GetSampleSpacing();
+    const auto Origin = FVector2D(Tile.Key.GetCoordinates()) * (float)Tile.CellSize;
+
+    auto GetHeight = [&Tile](const int32 X, const int32 Y) { return Tile.Heights[Y * Tile.SampleCount + X]; };
+
+    for (auto i = 0; i < Count; i++)
+    {
+        /* Same draws whatever the settings, so instances don't shuffle when one changes */
+        const auto U = Random.GetFraction() * Last;
+        const auto V = Random.GetFraction() * Last;
+        const auto Yaw = Random.FRandRange(0.0f, 2.0f * PI);
+        const auto Scale = Random.FRandRange(Layer.MinScale, Layer.MaxScale);
+
+        const auto X0 = FMath::Min(FMath::FloorToInt(U), Last - 1);
+        const auto Y0 = FMath::Min(FMath::FloorToInt(V), Last - 1);
+        const auto FX = U - X0;
+        const auto FY = V - Y0;
+
+        const auto H00 = GetHeight(X0, Y0);
+        const auto H10 = GetHeight(X0 + 1, Y0);
+        const auto H01 = GetHeight(X0, Y0 + 1);
+        const auto H11 = GetHeight(X0 + 1, Y0 + 1);
+        const auto Height = FMath::Lerp(FMath::Lerp(H00, H10, FX), FMath::Lerp(H01, H11, FX), FY);
+
+        auto Rotation = FQuat(FVector::UpVector, Yaw);
+        if (Layer.bAlignToSurface)
+        {
+            const auto SlopeX = FMath::Lerp(H10 - H00, H11 - H01, FY) / Spacing;
+            const auto SlopeY = FMath::Lerp(H01 - H00, H11 - H10, FX) / Spacing;
+            Rotation = FQuat::FindBetweenNormals(FVector::UpVector, FVector(-SlopeX, -SlopeY, 1.0f).GetSafeNormal()) * Rotation;
+        }
+
+        OutInstances.Add(FTransform(Rotation, FVector(Origin.X + U * Spacing, Origin.Y + V * Spacing, Height), FVector(Scale)));
+    }
+}
+
+void FQuadTreeScatter::Release(const TSharedPtr<FLeaf, ESPMode::ThreadSafe>& Leaf, TArray<FQuadTreeScatterWrite>& OutWrites)
+{
+    /* Still generating, the task writes its instances. Collected by Update once done */
+    if (Leaf->Task.IsValid() && !Leaf->Task.IsReady())
+    {
+        Releasing.Add(Leaf);
+        return;
+    }
+
+    static const FTransform Hidden(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+
+    for (auto Layer = 0; Layer < Layers.Num(); Layer++)
+    {
+        for (auto Slot : Leaf->Slots[Layer])
+        {
+            Layers[Layer].FreeSlots.Add(Slot);
+            OutWrites.Add(FQuadTreeScatterWrite{ Layer, Slot, Hidden });
+        }
+
+        Leaf->Slots[Layer].Reset();
+        Leaf->Instances[Layer].Reset();
+    }
+
+    Leaf->Task = TFuture<void>();
+    if (Pool.Num() < QuadyScatter::MaxPooledLeaves)
+        Pool.Add(Leaf);
+}
+
+int32 FQuadTreeScatter::AllocateSlot(const int32 Layer)
+{
+    auto& Slots = Layers[Layer];
+    return Slots.FreeSlots.Num() > 0 ? Slots.FreeSlots.Pop(false) : Slots.SlotCount++;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,107 @@
+#include "QuadTreeScatterComponent.h"
+
+#include "QuadTree.h"
+#include "QuadTreeComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "GameFramework/Actor.h"
+
+UQuadTreeScatterComponent::UQuadTreeScatterComponent()
+    : Source(nullptr),
+    SelectionRevision(0),
+    InstanceOrigin(FIntVector::ZeroValue),
+    bInstancesPlaced(false)
+{
+    /* After the update scheduler, so a new selection is picked up the same frame */
+    PrimaryComponentTick.bCanEverTick = true;
+    PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+    bTickInEditor = true;
+}
+
+void UQuadTreeScatterComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    if (!Scatter.IsValid() || Source == nullptr || Source->QuadTree == nullptr)
+        return;
+
+    auto* QuadTree = Source->QuadTree;
+    if (QuadTree->GetSelectionRevision() != SelectionRevision)
+    {
+        SelectionRevision = QuadTree->GetSelectionRevision();
+        Scatter->SetSelection(QuadTree->GetSelectedLeaves());
+    }
+
+    TArray<FQuadTreeScatterWrite> Writes;
+    Scatter->Update([QuadTree](const FQuadTreeNodeKey Key) { return QuadTree->FindHeightTile(Key); }, Writes);
+
+    /* Instances are grid relative, only moved when the grid is rebased */
+    const auto& GridOrigin = QuadTree->GetGrid().Origin;
+    if (!bInstancesPlaced || GridOrigin != InstanceOrigin)
+    {
+        InstanceOrigin = GridOrigin;
+        bInstancesPlaced = true;
+        for (auto* Component : Instances)
+            Component->SetWorldLocation(FVector(InstanceOrigin));
+    }
+
+    if (Writes.Num() == 0)
+        return;
+
+    TBitArray<> DirtyLayers(false, Instances.Num());
+    for (auto& Write : Writes)
+    {
+        auto* Component = Instances[Write.Layer];
+
+        /* Slots are allocated densely, a new one is always the next instance */
+        if (Write.Slot >= Component->GetInstanceCount())
+            Component->AddInstance(Write.Transform);
+        else
+            Component->UpdateInstanceTransform(Write.Slot, Write.Transform, false, false, true);
+
+        DirtyLayers[Write.Layer] = true;
+    }
+
+    for (auto Layer = 0; Layer < Instances.Num(); Layer++)
+        if (DirtyLayers[Layer])
+            Instances[Layer]->MarkRenderStateDirty();
+}
+
+void UQuadTreeScatterComponent::ApplyWorldOffset(const FVector& InOffset, bool bWorldShift)
+{
+    Super::ApplyWorldOffset(InOffset, bWorldShift);
+
+    /* Absolute instance components were shifted with the world, the grid only follows with bFloatingOrigin */
+    bInstancesPlaced = false;
+}
+
+void UQuadTreeScatterComponent::OnRegister()
+{
+    Super::OnRegister();
+
+    Source = GetOwner() != nullptr ? GetOwner()->FindComponentByClass<UQuadTreeComponent>() : nullptr;
+    Scatter = MakeUnique<FQuadTreeScatter>(Layers);
+    SelectionRevision = 0;
+    bInstancesPlaced = false;
+
+    for (auto& Layer : Layers)
+    {
+        auto* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this, NAME_None, RF_Transient);
+        Component->SetStaticMesh(Layer.Mesh);
+        Component->SetAbsolute(true, true, true);
+        Component->SetupAttachment(this);
+        Component->RegisterComponent();
+        Instances.Add(Component);
+    }
+}
+
+void UQuadTreeScatterComponent::OnUnregister()
+{
+    for (auto* Component : Instances)
+        if (Component != nullptr)
+            Component->DestroyComponent();
+
+    Instances.Reset();
+    Scatter.Reset();
+
+    Super::OnUnregister();
+}
@@ -14,6 +14,13 @@ void AQuadTreeTestActor::BeginPlay()
 	Super::BeginPlay();
 }
 
+void AQuadTreeTestActor::ApplyWorldOffset(const FVector& InOffset, bool bWorldShift)
+{
+    Super::ApplyWorldOffset(InOffset, bWorldShift);
+
+    QuadTree->ApplyWorldOffset(InOffset, bWorldShift);
+}
+
 void AQuadTreeTestActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
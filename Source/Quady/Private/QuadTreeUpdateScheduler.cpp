@@ -0,0 +1,113 @@
+#include "QuadTreeUpdateScheduler.h"
+
+#include "Quady.h"
+#include "QuadTreeComponent.h"
+#include "QuadTree.h"
+#include "Misc/MemStack.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTree Scheduler"), STAT_QuadTreeScheduler, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Scheduled Updates"), STAT_QuadTreeScheduledUpdates, STATGROUP_Quady);
+DECLARE_DWORD_COUNTER_STAT(TEXT("QuadTree Deferred Updates"), STAT_QuadTreeDeferredUpdates, STATGROUP_Quady);
+
+TUniquePtr<FQuadTreeUpdateScheduler> FQuadTreeUpdateScheduler::Instance;
+
+void FQuadTreeUpdateScheduler::Register(UQuadTreeComponent* Component)
+{
+    check(IsInGameThread());
+
+    if (!Instance.IsValid())
+        Instance = MakeUnique<FQuadTreeUpdateScheduler>();
+
+    Instance->Components.AddUnique(Component);
+}
+
+void FQuadTreeUpdateScheduler::Unregister(UQuadTreeComponent* Component)
+{
+    check(IsInGameThread());
+
+    if (!Instance.IsValid())
+        return;
+
+    Instance->Components.RemoveSwap(Component);
+    if (Instance->Components.Num() == 0)
+        Instance.Reset();
+}
+
+void FQuadTreeUpdateScheduler::Tick(float DeltaTime)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadTreeScheduler);
+
+    FMemMark Mark(FMemStack::Get());
+
+    /* Scalability and last frame's bias, a compare per component unless either changed */
+    const auto RangeScale = FQuadyScalability::GetRangeScale() * LODController.GetRangeScale();
+    for (auto* Component : Components)
+        Component->SetRangeScale(RangeScale);
+
+    TArray<TPair<float, UQuadTreeComponent*>, TMemStackAllocator<>> Due;
+    for (auto* Component : Components)
+    {
+        const auto Urgency = Component->GetUpdateUrgency();
+        if (Urgency >= 1.0f)
+            Due.Emplace(Urgency, Component);
+    }
+
+    Due.Sort([](const TPair<float, UQuadTreeComponent*>& A, const TPair<float, UQuadTreeComponent*>& B) { return A.Key > B.Key; });
+
+    const auto BudgetMs = GetBudget();
+    const auto StartTime = FPlatformTime::Seconds();
+    for (auto i = 0; i < Due.Num(); i++)
+    {
+        if (i > 0 && (FPlatformTime::Seconds() - StartTime) * 1000.0 >= BudgetMs)
+        {
+            for (auto j = i; j < Due.Num(); j++)
+                Due[j].Value->Defer();
+
+            INC_DWORD_STAT_BY(STAT_QuadTreeDeferredUpdates, Due.Num() - i);
+            break;
+        }
+
+        Due[i].Value->PerformUpdate();
+        INC_DWORD_STAT(STAT_QuadTreeScheduledUpdates);
+    }
+
+    UpdateLOD(DeltaTime, (float)((FPlatformTime::Seconds() - StartTime) * 1000.0));
+
+    /* Batched, a state compare unless the selection changed */
+    for (auto* Component : Components)
+        Component->PerformDraw();
+}
+
+void FQuadTreeUpdateScheduler::UpdateLOD(const float DeltaTime, const float UpdateMs)
+{
+    const auto BudgetMs = GetBudget();
+    const auto MaxSelectedLeaves = FQuadyScalability::GetMaxSelectedLeaves();
+    const auto StreamingMemory = FQuadyScalability::GetStreamingMemory();
+
+    /* The busiest tree sets the pressure, the others coarsen with it */
+    auto DrawPressure = 0.0f;
+    auto MemoryPressure = 0.0f;
+    for (auto* Component : Components)
+    {
+        const auto* QuadTree = Component->QuadTree;
+        if (QuadTree == nullptr)
+            continue;
+
+        if (MaxSelectedLeaves > 0)
+            DrawPressure = FMath::Max(DrawPressure, (float)QuadTree->GetSelectedLeaves().Num() / MaxSelectedLeaves);
+
+        if (StreamingMemory > 0)
+            MemoryPressure = FMath::Max(MemoryPressure, (float)((double)QuadTree->GetRequiredHeightTileMemory() / StreamingMemory));
+    }
+
+    LODController.Update(DeltaTime, BudgetMs > 0.0f ? UpdateMs / BudgetMs : 0.0f, DrawPressure, MemoryPressure);
+}
+
+TStatId FQuadTreeUpdateScheduler::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(FQuadTreeUpdateScheduler, STATGROUP_Tickables);
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "QuadyScalability.h"
+
+class UQuadTreeComponent;
+
+/*
+One tick for every QuadTreeComponent. Exists while any component is registered. Due
+components are updated most urgent first until the frame's budget is spent, at least one
+per frame so nothing starves; the rest wait and grow more urgent. The time spent, selected
+leaves and resident tiles drive one LOD bias for all of them.
+*/
+class FQuadTreeUpdateScheduler
+    : public FTickableGameObject
+{
+public:
+    static void Register(UQuadTreeComponent* Component);
+    static void Unregister(UQuadTreeComponent* Component);
+
+    /* Shared by all QuadTrees, in milliseconds. quady.UpdateBudgetMs */
+    static float GetBudget() { return FQuadyScalability::GetUpdateBudget(); }
+    static void SetBudget(const float InBudgetMs) { FQuadyScalability::SetUpdateBudget(InBudgetMs); }
+
+    virtual void Tick(float DeltaTime) override;
+    virtual bool IsTickable() const override { return Components.Num() > 0; }
+    virtual bool IsTickableInEditor() const override { return true; }
+    virtual bool IsTickableWhenPaused() const override { return true; }
+    virtual TStatId GetStatId() const override;
+
+private:
+    static TUniquePtr<FQuadTreeUpdateScheduler> Instance;
+
+    TArray<UQuadTreeComponent*> Components;
+    FQuadyLODController LODController;
+
+    void UpdateLOD(const float DeltaTime, const float UpdateMs);
+};
@@ -1,4 +1,6 @@
 #include "QuadTreeViewer.h"
+#include "QuadTreeGrid.h"
+#include "QuadTreeOcclusion.h"
 
 #if !UE_BUILD_SHIPPING
 #include "DrawDebugHelpers.h"
@@ -7,6 +9,17 @@
 
 #define LOCTEXT_NAMESPACE "Quady"
 
+FQuadTreeViewer::FQuadTreeViewer()
+    : Location(FVector::ZeroVector),
+    Cell(FIntPoint::ZeroValue),
+    CellOffset(FVector::ZeroVector),
+    CellSize(1),
+    bLocationDirty(true),
+    Direction(FVector::ForwardVector),
+    bDirectionDirty(true),
+    Occlusion(nullptr),
+    ShadowViewCount(0) { }
+
 const bool FQuadTreeViewer::HasLocationChanged(bool bClearFlag /*= false*/)
 {
     if (bClearFlag && bLocationDirty)
@@ -28,18 +41,95 @@ const FVector& FQuadTreeViewer::GetLocation() const
     return Location;
 }
 
-void FQuadTreeViewer::SetLocation(const FVector& Location)
+void FQuadTreeViewer::SetLocation(const FQuadTreeGrid& Grid, const FVector& Location)
+{
+    this->Location = Location;
+    this->CellSize = Grid.CellSize;
+
+    FIntPoint NewCell;
+    FVector NewCellOffset;
+    Grid.ToCell(Location, NewCell, NewCellOffset);
+    SetCell(NewCell, NewCellOffset);
+}
+
+void FQuadTreeViewer::SetCell(const FIntPoint& Cell, const FVector& CellOffset)
 {
-    if (!this->Location.Equals(Location))
+    if (this->Cell != Cell || !this->CellOffset.Equals(CellOffset))
     {
-        this->Location = Location;
+        this->Cell = Cell;
+        this->CellOffset = CellOffset;
         this->bLocationDirty = true;
 
         for (auto& Range : Ranges)
-            Range.Origin = Location;
+            Range.Origin = CellOffset;
     }
 }
 
+FBox FQuadTreeViewer::GetRelativeBounds(const FIntPoint& Coordinates, const uint8 Level, const FFloatInterval& HeightBounds) const
+{
+    /* Integer difference first, exact however far both are from the origin */
+    const auto Relative = Coordinates - Cell;
+    const auto Size = (float)(CellSize << Level);
+
+    const auto Min = FVector(Relative.X * (float)CellSize, Relative.Y * (float)CellSize, HeightBounds.Min);
+    return FBox(Min, FVector(Min.X + Size, Min.Y + Size, HeightBounds.Max));
+}
+
+const bool FQuadTreeViewer::IsOccluded(const FBox& RelativeBounds) const
+{
+    return Occlusion != nullptr && Occlusion->IsOccluded(RelativeBounds);
+}
+
+void FQuadTreeViewer::SetShadowViews(const FQuadTreeGrid& Grid, const TArray<FQuadTreeShadowView>& WorldShadowViews)
+{
+    check(WorldShadowViews.Num() <= FQuadTreeShadowView::MaxViews);
+
+    /* Plane distances are rebased onto the cell's corner, the same space as GetRelativeBounds */
+    const auto CellOrigin = Grid.ToWorld(Cell);
+
+    ShadowViewCount = WorldShadowViews.Num();
+    for (auto View = 0; View < ShadowViewCount; View++)
+    {
+        auto& ShadowView = ShadowViews[View];
+        ShadowView.LevelBias = WorldShadowViews[View].LevelBias;
+        ShadowView.Frustum.Planes.Reset();
+
+        for (auto& Plane : WorldShadowViews[View].Frustum.Planes)
+            ShadowView.Frustum.Planes.Emplace(Plane, Plane.W - (Plane | CellOrigin));
+
+        ShadowView.Frustum.Init();
+    }
+}
+
+const uint8 FQuadTreeViewer::GetShadowViews(const FBox& RelativeBounds, const uint8 Level, const uint8 Candidates) const
+{
+    uint8 Result = 0;
+    if (Candidates == 0)
+        return Result;
+
+    for (auto View = 0; View < ShadowViewCount; View++)
+    {
+        const auto Bit = (uint8)(1 << View);
+        const auto& ShadowView = ShadowViews[View];
+        if ((Candidates & Bit) == 0 || Level < ShadowView.LevelBias)
+            continue;
+
+        /* A smaller range than the main view's for the same level, so always a subset of its selection */
+        if (!FBoxSphereBounds::BoxesIntersect(RelativeBounds, Ranges[Level - ShadowView.LevelBias].GetSphere()))
+            continue;
+
+        if (ShadowView.Frustum.IntersectBox(RelativeBounds.GetCenter(), RelativeBounds.GetExtent()))
+            Result |= Bit;
+    }
+
+    return Result;
+}
+
+void FQuadTreeViewer::ApplyWorldOffset(const FVector& Offset)
+{
+    Location += Offset;
+}
+
 const bool FQuadTreeViewer::HasDirectionChanged(bool bClearFlag /*= false*/)
 {
     if (bClearFlag && bLocationDirty)
@@ -82,12 +172,39 @@ void FQuadTreeViewer::SetRanges(const TArray<float>& Ranges)
     this->Ranges.Empty(Ranges.Num());
     for (auto i = 0; i < Ranges.Num(); i++)
     {
-        auto RangeSphere = FSphere(Location, Ranges[i]);
+        auto RangeSphere = FSphere(CellOffset, Ranges[i]);
         auto Range = FBoxSphereBounds(RangeSphere);
         this->Ranges.Emplace(Range);
     }
 }
 
+FVector2D FQuadTreeViewer::GetMorphRange(const uint8 Level, const float MorphStartRatio) const
+{
+    check(Level < Ranges.Num());
+
+    /* Children take over inside the previous range, so only the band between the two morphs */
+    const auto PreviousRange = Level > 0 ? Ranges[Level - 1].SphereRadius : 0.0f;
+    const auto Range = Ranges[Level].SphereRadius;
+
+    return FVector2D(FMath::Lerp(PreviousRange, Range, FMath::Clamp(MorphStartRatio, 0.0f, 1.0f)), Range);
+}
+
+void FQuadTreeViewer::SetCellSize(const int32 CellSize)
+{
+    check(CellSize > 0);
+
+    if (this->CellSize != CellSize)
+    {
+        this->CellSize = CellSize;
+        this->bLocationDirty = true;
+    }
+}
+
+void FQuadTreeViewer::Invalidate()
+{
+    bLocationDirty = true;
+}
+
 void FQuadTreeViewer::PostSelect()
 {
     bLocationDirty = false;
@@ -100,10 +217,29 @@ void FQuadTreeViewer::Draw(const UWorld* World)
     static const FQuat Rotation = FQuat::MakeFromEuler(FVector(0, 90, 0));
     for (auto& Range : Ranges)
     {
-        auto Transform = FTransform(Rotation, Range.Origin, FVector::OneVector);
+        auto Transform = FTransform(Rotation, Location, FVector::OneVector);
         DrawDebugCircle(World, Transform.ToMatrixNoScale(), Range.SphereRadius, 64, FColor::Green);
     }
 #endif
 }
 
+FArchive& operator<<(FArchive& Ar, FQuadTreeViewer& Viewer)
+{
+    auto Cell = Viewer.Cell;
+    auto CellOffset = Viewer.CellOffset;
+    auto Direction = Viewer.Direction;
+
+    Ar << Cell;
+    Ar << CellOffset;
+    Ar << Direction;
+
+    if (Ar.IsLoading())
+    {
+        Viewer.SetCell(Cell, CellOffset);
+        Viewer.SetDirection(Direction);
+    }
+
+    return Ar;
+}
+
 #undef LOCTEXT_NAMESPACE
\ No newline at end of file
@@ -1,13 +1,21 @@
 #include "Quady.h"
 
+#include "Engine/World.h"
+#include "QuadyNeighborGrid.h"
+
 #define LOCTEXT_NAMESPACE "FQuadyModule"
 
 void FQuadyModule::StartupModule()
 {
+    WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddLambda([](UWorld* World, bool bSessionEnded, bool bCleanupResources)
+    {
+        FQuadyNeighborGrid::Release(World);
+    });
 }
 
 void FQuadyModule::ShutdownModule()
 {
+    FWorldDelegates::OnWorldCleanup.Remove(WorldCleanupHandle);
 }
 
 #undef LOCTEXT_NAMESPACE
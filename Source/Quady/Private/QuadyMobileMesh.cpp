@@ -0,0 +1,229 @@
+#include "QuadyMobileMesh.h"
+
+#include "Quady.h"
+#include "QuadTreeHeightSource.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("Quady Mobile Pack Vertices"), STAT_QuadyMobilePackVertices, STATGROUP_Quady);
+DECLARE_CYCLE_STAT(TEXT("Quady Mobile Selection"), STAT_QuadyMobileSelection, STATGROUP_Quady);
+
+const float FQuadyMobileMesh::ZScale = 1.0f / 128.0f;
+
+void FQuadyMobileMesh::PackVertices(const FQuadTreeHeightTile& Tile, const float HeightScale, TArray<FQuadyMobileVertex>& OutVertices)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadyMobilePackVertices);
+
+    const auto QuadsPerSide = Tile.SampleCount - 1;
+    check(QuadsPerSide <= MaxQuadsPerSide && FMath::IsPowerOfTwo(QuadsPerSide));
+    check(Tile.Heights.Num() == Tile.SampleCount * Tile.SampleCount);
+    check(HeightScale > 0.0f);
+
+    const auto LODCount = GetLODCount(QuadsPerSide);
+
+    OutVertices.Reset(Tile.Heights.Num());
+    for (auto Y = 0; Y <= QuadsPerSide; Y++)
+    {
+        for (auto X = 0; X <= QuadsPerSide; X++)
+        {
+            /* LODs past the patch's last repeat it */
+            float Heights[MaxLODs];
+            auto Min = MAX_flt;
+            auto Max = -MAX_flt;
+            for (auto LOD = 0; LOD < MaxLODs; LOD++)
+            {
+                Heights[LOD] = GetLODHeight(Tile.Heights, QuadsPerSide, X, Y, FMath::Min(LOD, LODCount - 1)) / HeightScale;
+                Min = FMath::Min(Min, Heights[LOD]);
+                Max = FMath::Max(Max, Heights[LOD]);
+            }
+
+            /* Rounded outward so every LOD's height is within the range */
+            const auto PackedMin = (uint16)FMath::Clamp(FMath::FloorToInt(Min / ZScale) + 32768, 0, 65535);
+            const auto PackedMax = (uint16)FMath::Clamp(FMath::CeilToInt(Max / ZScale) + 32768, 0, 65535);
+            const auto DecodedMin = DecodeHeight(PackedMin);
+            const auto DecodedRange = DecodeHeight(PackedMax) - DecodedMin;
+
+            uint8 Normalized[MaxLODs];
+            for (auto LOD = 0; LOD < MaxLODs; LOD++)
+            {
+                const auto Alpha = DecodedRange > 0.0f ? (Heights[LOD] - DecodedMin) / DecodedRange : 0.0f;
+                Normalized[LOD] = (uint8)FMath::Clamp(FMath::RoundToInt(Alpha * 255.0f), 0, 255);
+            }
+
+            FQuadyMobileVertex Vertex;
+            Vertex.Position[0] = (uint8)X;
+            Vertex.Position[1] = (uint8)Y;
+
+            /* Single subsection, SubX and SubY are 0 and the low bits are free for them */
+            Vertex.Position[2] = Normalized[4] & 0xFE;
+            Vertex.Position[3] = Normalized[5] & 0xFE;
+
+            Vertex.LODHeights[0] = PackedMin >> 8;
+            Vertex.LODHeights[1] = PackedMin & 0xFF;
+            Vertex.LODHeights[2] = PackedMax >> 8;
+            Vertex.LODHeights[3] = PackedMax & 0xFF;
+            for (auto LOD = 0; LOD < 4; LOD++)
+                Vertex.LODHeights[4 + LOD] = Normalized[LOD];
+
+            OutVertices.Add(Vertex);
+        }
+    }
+}
+
+uint16 FQuadyMobileMesh::EncodeHeight(const float LocalHeight)
+{
+    return (uint16)FMath::Clamp(FMath::RoundToInt(LocalHeight / ZScale) + 32768, 0, 65535);
+}
+
+float FQuadyMobileMesh::DecodeHeight(const uint16 PackedHeight)
+{
+    return ((float)PackedHeight - 32768.0f) * ZScale;
+}
+
+float FQuadyMobileMesh::GetLODHeight(const TArray<float>& Heights, const int32 QuadsPerSide, const int32 X, const int32 Y, const int32 LOD)
+{
+    const auto Stride = QuadsPerSide + 1;
+    const auto Step = FMath::Min(1 << LOD, QuadsPerSide);
+
+    /* Cell of the LOD's grid, the far edge belongs to the last one */
+    const auto X0 = FMath::Min((X / Step) * Step, QuadsPerSide - Step);
+    const auto Y0 = FMath::Min((Y / Step) * Step, QuadsPerSide - Step);
+    const auto FracX = (float)(X - X0) / Step;
+    const auto FracY = (float)(Y - Y0) / Step;
+
+    const auto H00 = Heights[Y0 * Stride + X0];
+    const auto H10 = Heights[Y0 * Stride + X0 + Step];
+    const auto H01 = Heights[(Y0 + Step) * Stride + X0];
+    const auto H11 = Heights[(Y0 + Step) * Stride + X0 + Step];
+
+    /* Split along the 00-11 diagonal like FQuadyMobileIndexTable */
+    if (FracX >= FracY)
+        return H00 + FracX * (H10 - H00) + FracY * (H11 - H10);
+
+    return H00 + FracY * (H01 - H00) + FracX * (H11 - H01);
+}
+
+float FQuadyMobileMesh::UnpackHeight(const FQuadyMobileVertex& Vertex, const int32 LOD)
+{
+    check(LOD < MaxLODs);
+
+    const auto Min = DecodeHeight((uint16)((Vertex.LODHeights[0] << 8) | Vertex.LODHeights[1]));
+    const auto Max = DecodeHeight((uint16)((Vertex.LODHeights[2] << 8) | Vertex.LODHeights[3]));
+    const auto Normalized = LOD < 4 ? Vertex.LODHeights[4 + LOD] : (Vertex.Position[2 + LOD - 4] & 0xFE);
+
+    return FMath::Lerp(Min, Max, Normalized / 255.0f);
+}
+
+int32 FQuadyMobileMesh::GetLODCount(const int32 QuadsPerSide)
+{
+    check(QuadsPerSide > 0 && FMath::IsPowerOfTwo(QuadsPerSide));
+
+    return FMath::Min((int32)FMath::FloorLog2(QuadsPerSide) + 1, MaxLODs);
+}
+
+FQuadyMobileIndexTable::FQuadyMobileIndexTable(const int32 QuadsPerSide)
+    : QuadsPerSide(QuadsPerSide),
+    LODCount(FQuadyMobileMesh::GetLODCount(QuadsPerSide))
+{
+    check(QuadsPerSide <= FQuadyMobileMesh::MaxQuadsPerSide);
+
+    /* Stitching only removes triangles, the unstitched patch bounds every variant */
+    auto MaxIndices = 0;
+    for (auto LOD = 0; LOD < LODCount; LOD++)
+        MaxIndices += FMath::Square(QuadsPerSide >> LOD) * 6 * StitchMaskCount;
+
+    Indices.Reserve(MaxIndices);
+    Ranges.Reserve(LODCount * StitchMaskCount);
+
+    for (auto LOD = 0; LOD < LODCount; LOD++)
+        for (auto StitchMask = 0; StitchMask < StitchMaskCount; StitchMask++)
+            AddPatch(LOD, (uint8)StitchMask);
+}
+
+void FQuadyMobileIndexTable::AddPatch(const int32 LOD, const uint8 StitchMask)
+{
+    const auto Step = 1 << LOD;
+    const auto FirstIndex = Indices.Num();
+
+    auto AddTriangle = [this](const uint16 A, const uint16 B, const uint16 C)
+    {
+        /* Collapsed onto an edge by stitching */
+        if (A == B || B == C || C == A)
+            return;
+
+        Indices.Add(A);
+        Indices.Add(B);
+        Indices.Add(C);
+    };
+
+    for (auto Y = 0; Y < QuadsPerSide; Y += Step)
+    {
+        for (auto X = 0; X < QuadsPerSide; X += Step)
+        {
+            const auto I00 = GetStitchedIndex(X, Y, Step, StitchMask);
+            const auto I10 = GetStitchedIndex(X + Step, Y, Step, StitchMask);
+            const auto I01 = GetStitchedIndex(X, Y + Step, Step, StitchMask);
+            const auto I11 = GetStitchedIndex(X + Step, Y + Step, Step, StitchMask);
+
+            AddTriangle(I00, I11, I10);
+            AddTriangle(I00, I01, I11);
+        }
+    }
+
+    Ranges.Add(FRange{ FirstIndex, (Indices.Num() - FirstIndex) / 3 });
+}
+
+uint16 FQuadyMobileIndexTable::GetStitchedIndex(int32 X, int32 Y, const int32 Step, const uint8 StitchMask) const
+{
+    /* A single quad per side has no odd vertices, its corners must stay put */
+    if (StitchMask != 0 && QuadsPerSide / Step >= 2)
+    {
+        /* NWES, N is -Y */
+        if ((StitchMask & 1) && Y == 0 && ((X / Step) & 1))
+            X -= Step;
+        else if ((StitchMask & 8) && Y == QuadsPerSide && ((X / Step) & 1))
+            X -= Step;
+
+        if ((StitchMask & 2) && X == 0 && ((Y / Step) & 1))
+            Y -= Step;
+        else if ((StitchMask & 4) && X == QuadsPerSide && ((Y / Step) & 1))
+            Y -= Step;
+    }
+
+    return (uint16)(Y * (QuadsPerSide + 1) + X);
+}
+
+void FQuadyMobileSelection::Gather(const TArray<FQuadTreeLeaf>& Leaves)
+{
+    SCOPE_CYCLE_COUNTER(STAT_QuadyMobileSelection);
+
+    LeafKeys.Reset();
+    for (auto& Leaf : Leaves)
+        LeafKeys.Add(Leaf.Key);
+
+    Draws.Reset(Leaves.Num());
+    for (auto& Leaf : Leaves)
+        Draws.Add(FQuadyMobileDraw{ Leaf.Key, Leaf.Coordinates, Leaf.Level, GetStitchMask(Leaf), Leaf.GetMorphParameters() });
+}
+
+uint8 FQuadyMobileSelection::GetStitchMask(const FQuadTreeLeaf& Leaf) const
+{
+    /* Any cell just across an edge, NWES like FQuadyNeighborGrid */
+    const auto Size = 1 << Leaf.Level;
+    const FIntPoint AcrossEdge[] =
+    {
+        Leaf.Coordinates + FIntPoint(0, -1),
+        Leaf.Coordinates + FIntPoint(-1, 0),
+        Leaf.Coordinates + FIntPoint(Size, 0),
+        Leaf.Coordinates + FIntPoint(0, Size)
+    };
+
+    uint8 StitchMask = 0;
+    for (auto Index = 0; Index < 4; Index++)
+        if (LeafKeys.Contains(FQuadTreeNodeKey(AcrossEdge[Index], Leaf.Level + 1)))
+            StitchMask |= 1 << Index;
+
+    return StitchMask;
+}
+
+#undef LOCTEXT_NAMESPACE
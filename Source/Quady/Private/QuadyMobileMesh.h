@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+
+struct FQuadTreeHeightTile;
+
+/*
+Compact vertex for ES3.1, matches FVertexFactoryInput's PackedPosition and LODHeights in
+QuadyVertexFactory.ush so no height texture is fetched. 12 bytes:
+Position = x, y, LOD 4 height | SubX, LOD 5 height | SubY
+LODHeights = min and max height (16 bit, high byte first), LOD 0-3 heights normalized between them
+*/
+struct FQuadyMobileVertex
+{
+    uint8 Position[4];
+    uint8 LODHeights[8];
+};
+
+static_assert(sizeof(FQuadyMobileVertex) == 12, "FQuadyMobileVertex must match the ES3.1 vertex declaration");
+
+/* CPU side packing for the mobile vertex factory, no RHI dependencies */
+class FQuadyMobileMesh
+{
+public:
+    /* Heights per vertex, LODs 4 and 5 share bytes with the position */
+    static const int32 MaxLODs = 6;
+
+    /* Positions are bytes */
+    static const int32 MaxQuadsPerSide = 255;
+
+    /* Local heights per packed unit, DecodePackedHeight's QUADY_ZSCALE */
+    static const float ZScale;
+
+    /* One vertex per sample of Tile, row major. HeightScale is the leaf transform's Z scale, world units per local unit */
+    static void PackVertices(const FQuadTreeHeightTile& Tile, const float HeightScale, TArray<FQuadyMobileVertex>& OutVertices);
+
+    static uint16 EncodeHeight(const float LocalHeight);
+    static float DecodeHeight(const uint16 PackedHeight);
+
+    /* Height of the vertex at X, Y as drawn at LOD, interpolated across the LOD's triangles */
+    static float GetLODHeight(const TArray<float>& Heights, const int32 QuadsPerSide, const int32 X, const int32 Y, const int32 LOD);
+
+    /* Decode a packed vertex's height at LOD, as the shader does */
+    static float UnpackHeight(const FQuadyMobileVertex& Vertex, const int32 LOD);
+
+    /* LODs a patch of QuadsPerSide can be drawn at, down to a single quad */
+    static int32 GetLODCount(const int32 QuadsPerSide);
+};
+
+/*
+Triangle lists for every LOD and stitch mask of a patch, built once per resolution and
+shared by every leaf. A set stitch bit means the neighbor across that edge (NWES, as
+FQuadyNeighborGrid) is one level coarser: odd vertices on that edge collapse onto the
+previous even one so the edge matches the neighbor's without tessellation.
+*/
+class FQuadyMobileIndexTable
+{
+public:
+    static const int32 StitchMaskCount = 16;
+
+    struct FRange
+    {
+        int32 FirstIndex;
+        int32 NumPrimitives;
+    };
+
+    explicit FQuadyMobileIndexTable(const int32 QuadsPerSide);
+
+    inline int32 GetQuadsPerSide() const { return QuadsPerSide; }
+    inline int32 GetLODCount() const { return LODCount; }
+    inline const TArray<uint16>& GetIndices() const { return Indices; }
+
+    inline const FRange& GetRange(const int32 LOD, const uint8 StitchMask) const
+    {
+        check(LOD < LODCount && StitchMask < StitchMaskCount);
+        return Ranges[LOD * StitchMaskCount + StitchMask];
+    }
+
+private:
+    int32 QuadsPerSide;
+    int32 LODCount;
+    TArray<uint16> Indices;
+    TArray<FRange> Ranges;
+
+    void AddPatch(const int32 LOD, const uint8 StitchMask);
+    uint16 GetStitchedIndex(int32 X, int32 Y, const int32 Step, const uint8 StitchMask) const;
+};
+
+/* A selected leaf as the mobile path draws it */
+struct FQuadyMobileDraw
+{
+    FQuadTreeNodeKey Key;
+    FIntPoint Coordinates;
+    uint8 Level;
+    uint8 StitchMask;
+    FVector4 MorphParams;
+};
+
+/*
+Draw list for the mobile path, one pass over the selection on the calling thread. Low core
+count devices lose more to task dispatch than a few hundred leaves cost inline, containers
+are kept between frames so a steady selection doesn't allocate.
+*/
+class FQuadyMobileSelection
+{
+public:
+    void Gather(const TArray<FQuadTreeLeaf>& Leaves);
+
+    inline const TArray<FQuadyMobileDraw>& GetDraws() const { return Draws; }
+
+private:
+    TSet<FQuadTreeNodeKey> LeafKeys;
+    TArray<FQuadyMobileDraw> Draws;
+
+    uint8 GetStitchMask(const FQuadTreeLeaf& Leaf) const;
+};
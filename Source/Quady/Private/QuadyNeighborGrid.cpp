@@ -0,0 +1,193 @@
+#include "QuadyNeighborGrid.h"
+
+#include "Quady.h"
+#include "QuadTreeNode.h"
+#include "CoreGlobals.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+TMap<const UWorld*, TMap<FGuid, TSharedRef<FQuadyNeighborGrid, ESPMode::ThreadSafe>>> FQuadyNeighborGrid::WorldGrids;
+
+FQuadyNeighborGrid::FQuadyNeighborGrid(const int32 Capacity)
+    : EntryCount(0)
+{
+    const auto EntryNum = FMath::RoundUpToPowerOfTwo(FMath::Max(Capacity, 16));
+
+    Entries.SetNumZeroed(EntryNum);
+    Mask = EntryNum - 1;
+}
+
+FQuadyNeighborGrid::~FQuadyNeighborGrid()
+{
+    for (auto* Slot : AllocatedSlots)
+        FMemory::Free(Slot);
+}
+
+TSharedRef<FQuadyNeighborGrid, ESPMode::ThreadSafe> FQuadyNeighborGrid::Get(const UWorld* World, const FGuid& Owner)
+{
+    check(IsInGameThread());
+
+    auto& OwnerGrids = WorldGrids.FindOrAdd(World);
+    if (auto* Grid = OwnerGrids.Find(Owner))
+        return *Grid;
+
+    return OwnerGrids.Add(Owner, MakeShared<FQuadyNeighborGrid, ESPMode::ThreadSafe>());
+}
+
+void FQuadyNeighborGrid::Release(const UWorld* World)
+{
+    check(IsInGameThread());
+
+    WorldGrids.Remove(World);
+}
+
+FQuadyNeighborGrid::FSlot* FQuadyNeighborGrid::Register(const FQuadyNeighborInfo* Info, const FIntPoint& Cell, const uint8 Level)
+{
+    check(IsInRenderingThread());
+
+    const auto Key = MakeKey(Cell, Level);
+    auto Index = FindEntry(Key);
+    if (Entries[Index].Key == EmptyKey)
+    {
+        /* At most half full, so probes stay short */
+        if ((EntryCount + 1) * 2 > Entries.Num())
+        {
+            Grow();
+            Index = FindEntry(Key);
+        }
+
+        Entries[Index].Key = Key;
+        Entries[Index].Slot = AllocateSlot();
+        EntryCount++;
+    }
+    else
+    {
+        UE_LOG(LogQuady, Verbose, TEXT("Quady quad at %s level %d registered twice, replacing it"), *Cell.ToString(), Level);
+    }
+
+    auto* Slot = Entries[Index].Slot;
+    FPlatformAtomics::InterlockedExchangePtr((void**)&Slot->Info, (void*)Info);
+
+    for (auto NeighborIndex = 0; NeighborIndex < NEIGHBOR_COUNT; NeighborIndex++)
+    {
+        auto* Neighbor = Find(MakeKey(GetNeighborCell(Cell, Level, NeighborIndex), Level));
+        const auto* NeighborInfo = Neighbor != nullptr ? Neighbor->Info : nullptr;
+
+        FPlatformAtomics::InterlockedExchangePtr((void**)&Slot->Neighbors[NeighborIndex], (void*)NeighborInfo);
+        if (Neighbor != nullptr)
+            FPlatformAtomics::InterlockedExchangePtr((void**)&Neighbor->Neighbors[NEIGHBOR_COUNT - 1 - NeighborIndex], (void*)Info);
+    }
+
+    return Slot;
+}
+
+void FQuadyNeighborGrid::Unregister(const FQuadyNeighborInfo* Info, FSlot* Slot, const FIntPoint& Cell, const uint8 Level)
+{
+    if (Slot == nullptr)
+        return;
+
+    check(IsInRenderingThread());
+
+    const auto Key = MakeKey(Cell, Level);
+    if (Find(Key) != Slot || Slot->Info != Info)
+        return;
+
+    for (auto Index = 0; Index < NEIGHBOR_COUNT; Index++)
+    {
+        FPlatformAtomics::InterlockedExchangePtr((void**)&Slot->Neighbors[Index], nullptr);
+
+        /* Only unlink if the neighbor still points at us */
+        if (auto* Neighbor = Find(MakeKey(GetNeighborCell(Cell, Level, Index), Level)))
+            FPlatformAtomics::InterlockedCompareExchangePointer((void**)&Neighbor->Neighbors[NEIGHBOR_COUNT - 1 - Index], nullptr, (void*)Info);
+    }
+
+    FPlatformAtomics::InterlockedExchangePtr((void**)&Slot->Info, nullptr);
+
+    Remove(Key);
+    FreeSlots.Add(Slot);
+}
+
+FIntPoint FQuadyNeighborGrid::GetNeighborCell(const FIntPoint& Cell, const uint8 Level, const int32 Index)
+{
+    /* NWES, opposite of Index is NEIGHBOR_COUNT - 1 - Index */
+    static const FIntPoint Directions[NEIGHBOR_COUNT] = { FIntPoint(0, -1), FIntPoint(-1, 0), FIntPoint(1, 0), FIntPoint(0, 1) };
+
+    return Cell + Directions[Index] * (1 << Level);
+}
+
+int64 FQuadyNeighborGrid::MakeKey(const FIntPoint& Cell, const uint8 Level)
+{
+    /* Same packing as the quadtree, valid keys are never Empty */
+    return (int64)FQuadTreeNodeKey(Cell, Level).GetKey();
+}
+
+int32 FQuadyNeighborGrid::FindEntry(const int64 Key) const
+{
+    /* Never full, so an empty entry always ends the probe */
+    auto Index = (int32)(GetTypeHash(Key) & Mask);
+    while (Entries[Index].Key != Key && Entries[Index].Key != EmptyKey)
+        Index = (Index + 1) & Mask;
+
+    return Index;
+}
+
+FQuadyNeighborGrid::FSlot* FQuadyNeighborGrid::Find(const int64 Key) const
+{
+    const auto& Entry = Entries[FindEntry(Key)];
+    return Entry.Key == Key ? Entry.Slot : nullptr;
+}
+
+void FQuadyNeighborGrid::Remove(const int64 Key)
+{
+    auto Hole = FindEntry(Key);
+    if (Entries[Hole].Key != Key)
+        return;
+
+    Entries[Hole] = FEntry{ EmptyKey, nullptr };
+    EntryCount--;
+
+    /* Backward shift, moves later entries of the run into the hole unless that would put them before their home */
+    for (auto Index = (Hole + 1) & Mask; Entries[Index].Key != EmptyKey; Index = (Index + 1) & Mask)
+    {
+        const auto Home = (int32)(GetTypeHash(Entries[Index].Key) & Mask);
+        const auto bHomeAfterHole = Hole <= Index ? (Home > Hole && Home <= Index) : (Home > Hole || Home <= Index);
+        if (bHomeAfterHole)
+            continue;
+
+        Entries[Hole] = Entries[Index];
+        Entries[Index] = FEntry{ EmptyKey, nullptr };
+        Hole = Index;
+    }
+}
+
+void FQuadyNeighborGrid::Grow()
+{
+    /* Slots stay where they are, proxies keep their pointers */
+    auto OldEntries = MoveTemp(Entries);
+    Entries.SetNumZeroed(OldEntries.Num() * 2);
+    Mask = Entries.Num() - 1;
+
+    for (auto& Entry : OldEntries)
+        if (Entry.Key != EmptyKey)
+            Entries[FindEntry(Entry.Key)] = Entry;
+}
+
+FQuadyNeighborGrid::FSlot* FQuadyNeighborGrid::AllocateSlot()
+{
+    FSlot* Slot = nullptr;
+    if (FreeSlots.Num() > 0)
+    {
+        Slot = FreeSlots.Pop(false);
+    }
+    else
+    {
+        Slot = (FSlot*)FMemory::Malloc(sizeof(FSlot), PLATFORM_CACHE_LINE_SIZE);
+        AllocatedSlots.Add(Slot);
+    }
+
+    /* A reused slot must not hand out its previous quad's neighbors */
+    FMemory::Memzero(Slot, sizeof(FSlot));
+    return Slot;
+}
+
+#undef LOCTEXT_NAMESPACE
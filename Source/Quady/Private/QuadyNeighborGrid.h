@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Guid.h"
+
+class FQuadyNeighborInfo;
+class UWorld;
+
+/*
+Per world and owner index of registered quads by cell and level. Each quad gets a slot of
+one cache line holding it and its four neighbors, so a neighbor query is a single read
+without a lock. Slots never move. Proxies register and unregister on the rendering thread,
+where they are created and destroyed, so the open addressing index over the slots has a
+single writer and no reader elsewhere and takes no lock either. The index grows with the
+quads and deletes by shifting back, so it never fills up with tombstones.
+*/
+class FQuadyNeighborGrid
+{
+public:
+    static const int32 NEIGHBOR_COUNT = 4;
+
+    /* One cache line */
+    MS_ALIGN(PLATFORM_CACHE_LINE_SIZE) struct FSlot
+    {
+        const FQuadyNeighborInfo* volatile Info;
+
+        //       -Y
+        //    - - 0 - -
+        //    |       |
+        // -X 1   P   2 +X
+        //    |       |
+        //    - - 3 - -
+        //       +Y
+        const FQuadyNeighborInfo* volatile Neighbors[NEIGHBOR_COUNT];
+    } GCC_ALIGN(PLATFORM_CACHE_LINE_SIZE);
+
+    /* Initial capacity, rounded up to a power of two */
+    explicit FQuadyNeighborGrid(const int32 Capacity = 1024);
+    ~FQuadyNeighborGrid();
+
+    /* Game thread only. One grid per owner, such as a Quady actor, so quads of different owners never stitch.
+       The grid outlives the world for any proxy still holding it */
+    static TSharedRef<FQuadyNeighborGrid, ESPMode::ThreadSafe> Get(const UWorld* World, const FGuid& Owner);
+    static void Release(const UWorld* World);
+
+    /* Rendering thread only. Link with same level neighbors, returns the quad's slot. A quad already at Cell and Level is replaced */
+    FSlot* Register(const FQuadyNeighborInfo* Info, const FIntPoint& Cell, const uint8 Level);
+    /* Rendering thread only. Does nothing if Info was since replaced */
+    void Unregister(const FQuadyNeighborInfo* Info, FSlot* Slot, const FIntPoint& Cell, const uint8 Level);
+
+    static FIntPoint GetNeighborCell(const FIntPoint& Cell, const uint8 Level, const int32 Index);
+
+private:
+    static const int64 EmptyKey = 0;
+
+    struct FEntry
+    {
+        int64 Key;
+        FSlot* Slot;
+    };
+
+    /* Only touched by the rendering thread, neighbor reads go through the slots only */
+    TArray<FEntry> Entries;
+    int32 Mask;
+    int32 EntryCount;
+
+    TArray<FSlot*> AllocatedSlots;
+    TArray<FSlot*> FreeSlots;
+
+    static int64 MakeKey(const FIntPoint& Cell, const uint8 Level);
+
+    /* Index of Key's entry, or of the empty entry ending its probe */
+    int32 FindEntry(const int64 Key) const;
+    FSlot* Find(const int64 Key) const;
+    void Remove(const int64 Key);
+    void Grow();
+
+    FSlot* AllocateSlot();
+
+    static TMap<const UWorld*, TMap<FGuid, TSharedRef<FQuadyNeighborGrid, ESPMode::ThreadSafe>>> WorldGrids;
+};
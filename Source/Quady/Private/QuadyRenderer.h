@@ -20,6 +20,8 @@
 #include "PrimitiveViewRelevance.h"
 #include "PrimitiveSceneProxy.h"
 #include "StaticMeshResources.h"
+#include "QuadyNeighborGrid.h"
+#include "QuadyVisibilityMasks.h"
 
 #define QUADY_LOD_LEVELS 8
 
@@ -29,6 +31,10 @@ BEGIN_UNIFORM_BUFFER_STRUCT(FQuadyUniformShaderParameters, QUADY_API)
     UNIFORM_MEMBER(FVector4, SubsectionSizeVertsLayerUVPan)
     UNIFORM_MEMBER(FVector4, SubsectionOffsetParams)
     UNIFORM_MEMBER(FMatrix, LocalToWorldNoScaling)
+    /** geomorph range of the leaf, see FQuadTreeLeaf::GetMorphParameters. Only read with QUADY_GEOMORPH, nothing writes it yet */
+    UNIFORM_MEMBER(FVector4, MorphParams)
+    /** leaf's slot in the height atlas, see UQuadTree::GetHeightAtlasUVScaleBias */
+    UNIFORM_MEMBER(FVector4, HeightmapUVScaleBias)
 END_UNIFORM_BUFFER_STRUCT(FLandscapeUniformShaderParameters)
 
 /* Data needed for the quady vertex factory to set the render state for an individual batch element */
@@ -42,6 +48,9 @@ struct FQuadyBatchElementParameters
     int32 SubX;
     int32 SubY;
     int32 CurrentLOD;
+
+    // Index into FQuadyViewVisibility::ElementMasks, the proxy's PrimitiveCustomDataIndex
+    int32 ElementIndex;
 };
 
 class FLandscapeElementParameterArray
@@ -141,7 +150,21 @@ public:
         UpdateRHI();
     }
 
-    virtual uint64 GetStaticBatchElementVisibility(const FSceneView& InView, const FMeshBatch* InBatch, const void* InViewCustomData = nullptr) const override;
+    /**
+    * Precomputed for every quad once per view on a worker, InViewCustomData is the view's FQuadyViewVisibility
+    * returned from the proxy's InitViewCustomData. See FQuadyVisibilityMasks
+    */
+    virtual uint64 GetStaticBatchElementVisibility(const FSceneView& InView, const FMeshBatch* InBatch, const void* InViewCustomData = nullptr) const override
+    {
+        const auto* Parameters = (const FQuadyBatchElementParameters*)InBatch->Elements[0].UserData;
+        const auto* Visibility = (const FQuadyViewVisibility*)InViewCustomData;
+
+        // No selection for this view yet, a single subsection at LOD 0
+        if (Visibility == nullptr)
+            return 1;
+
+        return Visibility->GetMask(Parameters->ElementIndex);
+    }
 
     /** stream component data bound to this vertex factory */
     FDataType Data;
@@ -262,50 +285,26 @@ public:
 class FQuadyNeighborInfo
 {
 protected:
-    static const int8 NEIGHBOR_COUNT = 4;
-
-    // Key to uniquely identify the quad to find the correct render proxy map
-    class FQuadyKey
-    {
-    private:
-        const UWorld* World;
-        const FGuid Guid;
-
-    public:
-        FQuadyKey(const UWorld* InWorld, const FGuid& InGuid)
-            : World(InWorld),
-            Guid(InGuid) { }
-
-        friend inline uint32 GetTypeHash(const FQuadyKey& Key)
-        {
-            return HashCombine(GetTypeHash(Key.World), GetTypeHash(Key.Guid));
-        }
-
-        friend bool operator==(const FQuadyKey& A, const FQuadyKey& B)
-        {
-            return A.World == B.World && A.Guid == B.Guid;
-        }
-    };
+    static const int8 NEIGHBOR_COUNT = FQuadyNeighborGrid::NEIGHBOR_COUNT;
 
+    // Pointer to our neighbor's scene proxies in NWES order (nullptr if there is currently no neighbor), one cache line read
     const FQuadyNeighborInfo* GetNeighbor(int32 Index) const
     {
-        if (Index < NEIGHBOR_COUNT)
-            return Neighbors[Index];
+        if (Slot != nullptr && Index < NEIGHBOR_COUNT)
+            return Slot->Neighbors[Index];
 
         return nullptr;
     }
 
     virtual const UQuadyMeshComponent* GetQuadyComponent() const { return nullptr; }
 
-    // Map of currently registered quady proxies, used to register with our neighbors
-    static TMap<FQuadyKey, TMap<FIntPoint, const FQuadyNeighborInfo*> > SharedSceneProxyMap;
+    // Per world and owner grid of currently registered quady proxies, used to register with our neighbors
+    TSharedRef<FQuadyNeighborGrid, ESPMode::ThreadSafe> NeighborGrid;
+    FQuadyNeighborGrid::FSlot* Slot;
 
-    // For neighbor lookup
-    FQuadyKey			LandscapeKey;
+    // For neighbor lookup, in cells
     FIntPoint				ComponentBase;
-
-    // Pointer to our neighbor's scene proxies in NWES order (nullptr if there is currently no neighbor)
-    mutable const FQuadyNeighborInfo* Neighbors[NEIGHBOR_COUNT];
+    uint8					Level;
 
     // Data we need to be able to access about our neighbor
     int8					ForcedLOD;
@@ -316,28 +315,38 @@ protected:
     friend class FQuadyMeshComponentSceneProxy;
 
 public:
-    FQuadyNeighborInfo(const UWorld* World, const FGuid& Guid, const FIntPoint& ComponentBase, int8 ForcedLOD, int8 LODBias)
-        : LandscapeKey(World, Guid)
+    // Construct on the game thread, register and unregister on the rendering thread, the grid's only writer
+    FQuadyNeighborInfo(const UWorld* World, const FGuid& Guid, const FIntPoint& ComponentBase, uint8 Level, int8 ForcedLOD, int8 LODBias)
+        : NeighborGrid(FQuadyNeighborGrid::Get(World, Guid))
+        , Slot(nullptr)
         , ComponentBase(ComponentBase)
+        , Level(Level)
         , ForcedLOD(ForcedLOD)
         , LODBias(LODBias)
         , bRegistered(false)
-        , PrimitiveCustomDataIndex(INDEX_NONE)
+        , PrimitiveCustomDataIndex(INDEX_NONE) { }
+
+    virtual ~FQuadyNeighborInfo()
     {
-        //       -Y       
-        //    - - 0 - -   
-        //    |       |   
-        // -X 1   P   2 +X
-        //    |       |   
-        //    - - 3 - -   
-        //       +Y       
-
-        Neighbors[0] = nullptr;
-        Neighbors[1] = nullptr;
-        Neighbors[2] = nullptr;
-        Neighbors[3] = nullptr;
+        UnregisterNeighbors();
     }
 
-    void RegisterNeighbors();
-    void UnregisterNeighbors();
+    void RegisterNeighbors()
+    {
+        if (bRegistered)
+            return;
+
+        Slot = NeighborGrid->Register(this, ComponentBase, Level);
+        bRegistered = Slot != nullptr;
+    }
+
+    void UnregisterNeighbors()
+    {
+        if (!bRegistered)
+            return;
+
+        NeighborGrid->Unregister(this, Slot, ComponentBase, Level);
+        Slot = nullptr;
+        bRegistered = false;
+    }
 };
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadyRenderer.h"
+#include "QuadyMobileMesh.h"
+
+/** vertex factory for quady on ES3.1, heights come from the vertex stream (FQuadyMobileVertex) instead of the heightmap */
+class FQuadyVertexFactoryMobile
+    : public FQuadyVertexFactory
+{
+    DECLARE_VERTEX_FACTORY_TYPE(FQuadyVertexFactoryMobile);
+
+    typedef FQuadyVertexFactory Super;
+
+public:
+    struct FDataType
+        : FQuadyVertexFactory::FDataType
+    {
+        /** stream which has heights of each LOD levels */
+        TArray<FVertexStreamComponent, TFixedAllocator<2>> LODHeightsComponent;
+    };
+
+    FQuadyVertexFactoryMobile(ERHIFeatureLevel::Type InFeatureLevel)
+        : FQuadyVertexFactory(InFeatureLevel) { }
+
+    virtual ~FQuadyVertexFactoryMobile() { }
+
+    /**
+    * Mobile only, SM4 and up use FQuadyVertexFactory
+    */
+    static bool ShouldCompilePermutation(EShaderPlatform Platform, const FMaterial* Material, const FShaderType* ShaderType)
+    {
+        return IsMobilePlatform(Platform) &&
+            (Material->IsUsedWithLandscape() || Material->IsSpecialEngineMaterial());
+    }
+
+    static bool SupportsTessellationShaders() { return false; }
+
+    virtual void InitRHI() override
+    {
+        FVertexDeclarationElementList Elements;
+        Elements.Add(AccessStreamComponent(MobileData.PositionComponent, 0));
+
+        for (auto Index = 0; Index < MobileData.LODHeightsComponent.Num(); Index++)
+            Elements.Add(AccessStreamComponent(MobileData.LODHeightsComponent[Index], 1 + Index));
+
+        InitDeclaration(Elements);
+    }
+
+    void SetData(const FDataType& InData)
+    {
+        MobileData = InData;
+        UpdateRHI();
+    }
+
+    /** stream component data bound to this vertex factory */
+    FDataType MobileData;
+};
+
+/** FQuadyMobileVertex stream of one leaf, packed on the game thread from its height tile */
+class FQuadyMobileVertexBuffer
+    : public FVertexBuffer
+{
+public:
+    FQuadyMobileVertexBuffer(TArray<FQuadyMobileVertex>&& InVertices)
+        : Vertices(MoveTemp(InVertices)) { }
+
+    virtual ~FQuadyMobileVertexBuffer()
+    {
+        ReleaseResource();
+    }
+
+    virtual void InitRHI() override
+    {
+        const auto Size = Vertices.Num() * sizeof(FQuadyMobileVertex);
+
+        FRHIResourceCreateInfo CreateInfo;
+        void* Data = nullptr;
+        VertexBufferRHI = RHICreateAndLockVertexBuffer(Size, BUF_Static, CreateInfo, Data);
+        FMemory::Memcpy(Data, Vertices.GetData(), Size);
+        RHIUnlockVertexBuffer(VertexBufferRHI);
+
+        /* Only needed until uploaded */
+        Vertices.Empty();
+    }
+
+    /* Bind to a mobile vertex factory, the layout matches FVertexFactoryInput's ES3.1 branch */
+    void Bind(FQuadyVertexFactoryMobile::FDataType& OutData) const
+    {
+        OutData.PositionComponent = FVertexStreamComponent(this, STRUCT_OFFSET(FQuadyMobileVertex, Position), sizeof(FQuadyMobileVertex), VET_UByte4N);
+        OutData.LODHeightsComponent.Reset();
+        OutData.LODHeightsComponent.Add(FVertexStreamComponent(this, STRUCT_OFFSET(FQuadyMobileVertex, LODHeights), sizeof(FQuadyMobileVertex), VET_UByte4N));
+        OutData.LODHeightsComponent.Add(FVertexStreamComponent(this, STRUCT_OFFSET(FQuadyMobileVertex, LODHeights) + 4, sizeof(FQuadyMobileVertex), VET_UByte4N));
+    }
+
+private:
+    TArray<FQuadyMobileVertex> Vertices;
+};
+
+/** Every LOD and stitch variant of a patch in one 16 bit index buffer, shared by all leaves of a resolution */
+class FQuadyMobileIndexBuffer
+    : public FIndexBuffer
+{
+public:
+    explicit FQuadyMobileIndexBuffer(const int32 QuadsPerSide)
+        : Table(QuadsPerSide) { }
+
+    virtual ~FQuadyMobileIndexBuffer()
+    {
+        ReleaseResource();
+    }
+
+    virtual void InitRHI() override
+    {
+        const auto& Indices = Table.GetIndices();
+        const auto Size = Indices.Num() * sizeof(uint16);
+
+        FRHIResourceCreateInfo CreateInfo;
+        void* Data = nullptr;
+        IndexBufferRHI = RHICreateAndLockIndexBuffer(sizeof(uint16), Size, BUF_Static, CreateInfo, Data);
+        FMemory::Memcpy(Data, Indices.GetData(), Size);
+        RHIUnlockIndexBuffer(IndexBufferRHI);
+    }
+
+    /* Point a batch element at a leaf's LOD and stitch variant */
+    void SetupBatchElement(FMeshBatchElement& OutElement, const int32 LOD, const FQuadyMobileDraw& Draw) const
+    {
+        const auto& Range = Table.GetRange(FMath::Min(LOD, Table.GetLODCount() - 1), Draw.StitchMask);
+        const auto Vertices = FMath::Square(Table.GetQuadsPerSide() + 1);
+
+        OutElement.IndexBuffer = this;
+        OutElement.FirstIndex = Range.FirstIndex;
+        OutElement.NumPrimitives = Range.NumPrimitives;
+        OutElement.MinVertexIndex = 0;
+        OutElement.MaxVertexIndex = Vertices - 1;
+    }
+
+    inline const FQuadyMobileIndexTable& GetTable() const { return Table; }
+
+private:
+    FQuadyMobileIndexTable Table;
+};
@@ -0,0 +1,142 @@
+#include "QuadyScalability.h"
+
+#include "Quady.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Quady LOD Bias"), STAT_QuadyLODBias, STATGROUP_Quady);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Quady LOD Pressure"), STAT_QuadyLODPressure, STATGROUP_Quady);
+
+static TAutoConsoleVariable<float> CVarQuadyRangeScale(
+    TEXT("quady.RangeScale"),
+    1.0f,
+    TEXT("Scales the selection ranges of every QuadTree, on top of r.ViewDistanceScale. Below 1 selects coarser leaves nearer the viewer.\n")
+    TEXT("Clipmaps pick it up on their next Build."),
+    ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarQuadyMaxSelectedLeaves(
+    TEXT("quady.MaxSelectedLeaves"),
+    0,
+    TEXT("Selected leaves, each a draw, the adaptive LOD keeps every QuadTree under. 0 for no limit."),
+    ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarQuadyStreamingMemory(
+    TEXT("quady.StreamingMemoryMB"),
+    0,
+    TEXT("Megabytes of height tiles each QuadTree keeps resident, caps MaxCachedHeightTiles. The current selection is always resident, while it alone is over this the adaptive LOD coarsens it.\n")
+    TEXT("0 for no limit."),
+    ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarQuadyUpdateBudget(
+    TEXT("quady.UpdateBudgetMs"),
+    2.0f,
+    TEXT("Milliseconds per frame spent updating QuadTrees, shared by all of them. At least one due QuadTree is updated every frame."),
+    ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarQuadyAdaptiveLOD(
+    TEXT("quady.AdaptiveLOD"),
+    1,
+    TEXT("Coarsen QuadTrees while update time, selected leaves or resident tiles are over budget.\n")
+    TEXT(" 0: off\n")
+    TEXT(" 1: on"),
+    ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarQuadyAdaptiveLODMaxBias(
+    TEXT("quady.AdaptiveLOD.MaxBias"),
+    2.0f,
+    TEXT("Most levels the adaptive LOD coarsens by."),
+    ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarQuadyRunInline(
+    TEXT("quady.RunInline"),
+    -1,
+    TEXT("Run short per update side work, like occlusion rasterization, on the calling thread instead of the task graph.\n")
+    TEXT(" -1: when threading is off or there are 2 cores or fewer\n")
+    TEXT(" 0: never\n")
+    TEXT(" 1: always"),
+    ECVF_Scalability);
+
+namespace QuadyLOD
+{
+    /* Levels per second, coarsens quickly and refines slowly so spikes don't pop back and forth */
+    static const float RaiseRate = 1.0f;
+    static const float LowerRate = 0.25f;
+
+    /* Under this pressure everywhere the bias is lowered, between it and 1 it holds */
+    static const float LowerThreshold = 0.75f;
+
+    static const float Step = 0.25f;
+    static const float SmoothingTime = 0.5f;
+}
+
+float FQuadyScalability::GetRangeScale()
+{
+    static const auto* CVarViewDistanceScale = IConsoleManager::Get().FindTConsoleVariableDataFloat(TEXT("r.ViewDistanceScale"));
+
+    const auto ViewDistanceScale = CVarViewDistanceScale != nullptr ? CVarViewDistanceScale->GetValueOnGameThread() : 1.0f;
+    return FMath::Max(CVarQuadyRangeScale.GetValueOnGameThread() * ViewDistanceScale, KINDA_SMALL_NUMBER);
+}
+
+int32 FQuadyScalability::GetMaxSelectedLeaves()
+{
+    return FMath::Max(CVarQuadyMaxSelectedLeaves.GetValueOnGameThread(), 0);
+}
+
+int64 FQuadyScalability::GetStreamingMemory()
+{
+    return (int64)FMath::Max(CVarQuadyStreamingMemory.GetValueOnGameThread(), 0) * 1024 * 1024;
+}
+
+float FQuadyScalability::GetUpdateBudget()
+{
+    return FMath::Max(CVarQuadyUpdateBudget.GetValueOnGameThread(), 0.0f);
+}
+
+void FQuadyScalability::SetUpdateBudget(const float BudgetMs)
+{
+    CVarQuadyUpdateBudget->Set(FMath::Max(BudgetMs, 0.0f), ECVF_SetByCode);
+}
+
+bool FQuadyScalability::ShouldRunInline()
+{
+    const auto RunInline = CVarQuadyRunInline.GetValueOnAnyThread();
+    if (RunInline >= 0)
+        return RunInline != 0;
+
+    /* Nothing to overlap with, a task would only add dispatch and wake up latency */
+    return !FApp::ShouldUseThreadingForPerformance() || FPlatformMisc::NumberOfCoresIncludingHyperthreads() <= 2;
+}
+
+FQuadyLODController::FQuadyLODController()
+    : Bias(0.0f),
+    AppliedBias(0.0f),
+    SmoothedUpdatePressure(0.0f) { }
+
+void FQuadyLODController::Update(const float DeltaTime, const float UpdatePressure, const float DrawPressure, const float MemoryPressure)
+{
+    const auto Alpha = 1.0f - FMath::Exp(-DeltaTime / QuadyLOD::SmoothingTime);
+    SmoothedUpdatePressure = FMath::Lerp(SmoothedUpdatePressure, UpdatePressure, Alpha);
+
+    const auto Pressure = FMath::Max3(SmoothedUpdatePressure, DrawPressure, MemoryPressure);
+    const auto MaxBias = FMath::Max(CVarQuadyAdaptiveLODMaxBias.GetValueOnGameThread(), 0.0f);
+
+    if (CVarQuadyAdaptiveLOD.GetValueOnGameThread() == 0)
+        Bias = 0.0f;
+    else if (Pressure > 1.0f)
+        Bias += QuadyLOD::RaiseRate * DeltaTime * FMath::Min(Pressure, 2.0f);
+    else if (Pressure < QuadyLOD::LowerThreshold)
+        Bias -= QuadyLOD::LowerRate * DeltaTime;
+
+    Bias = FMath::Clamp(Bias, 0.0f, MaxBias);
+
+    /* Applied once it has moved a whole step, so a bias hovering between two doesn't reselect */
+    if (FMath::Abs(Bias - AppliedBias) >= QuadyLOD::Step || Bias == 0.0f || Bias == MaxBias)
+        AppliedBias = FMath::GridSnap(Bias, QuadyLOD::Step);
+
+    SET_FLOAT_STAT(STAT_QuadyLODBias, AppliedBias);
+    SET_FLOAT_STAT(STAT_QuadyLODPressure, Pressure);
+}
+
+#undef LOCTEXT_NAMESPACE
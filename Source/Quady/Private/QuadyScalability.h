@@ -0,0 +1,52 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+quady.* console variables, shared by every QuadTree. They are flagged as scalability so a
+project's [ViewDistanceQuality@N] and similar sections can set them per quality level, and the
+ranges follow r.ViewDistanceScale like the engine's own view distances.
+*/
+class FQuadyScalability
+{
+public:
+    /* quady.RangeScale times r.ViewDistanceScale */
+    static float GetRangeScale();
+
+    /* 0 for no limit */
+    static int32 GetMaxSelectedLeaves();
+
+    /* Bytes of height tiles per QuadTree, 0 for no limit */
+    static int64 GetStreamingMemory();
+
+    /* Milliseconds per frame */
+    static float GetUpdateBudget();
+    static void SetUpdateBudget(const float BudgetMs);
+
+    /* quady.RunInline, true where short side work is better run inline than on the task graph */
+    static bool ShouldRunInline();
+};
+
+/*
+Coarsens every QuadTree while update time, selected leaves or resident tiles are over budget, and
+refines them again once all are comfortably under. Pressures are usage over target, 1 is on budget.
+The bias moves in quarter level steps so small fluctuations don't reselect.
+*/
+class FQuadyLODController
+{
+public:
+    FQuadyLODController();
+
+    void Update(const float DeltaTime, const float UpdatePressure, const float DrawPressure, const float MemoryPressure);
+
+    /* Levels the ranges are coarsened by */
+    inline float GetBias() const { return AppliedBias; }
+    inline float GetRangeScale() const { return FMath::Pow(2.0f, -AppliedBias); }
+
+private:
+    float Bias;
+    float AppliedBias;
+
+    /* Updates only run while viewers move, so their cost is smoothed over frames */
+    float SmoothedUpdatePressure;
+};
@@ -0,0 +1,144 @@
+#include "QuadyVisibilityMasks.h"
+
+#include "Quady.h"
+#include "Async.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/MemStack.h"
+
+#define LOCTEXT_NAMESPACE "Quady"
+
+DECLARE_CYCLE_STAT(TEXT("Quady Visibility Masks"), STAT_QuadyVisibilityMasks, STATGROUP_Quady);
+DECLARE_CYCLE_STAT(TEXT("Quady Visibility Masks Wait"), STAT_QuadyVisibilityMasksWait, STATGROUP_Quady);
+
+int32 FQuadyVisibilityMasks::AddElement(const FIntPoint& ComponentBase, const uint8 Level, const int32 ElementsPerLOD)
+{
+    check(ElementsPerLOD > 0 && ElementsPerLOD * MaxLODs <= 64);
+
+    FScopeLock ScopeLock(&Lock);
+
+    const auto Element = FElement{ ComponentBase, Level, (uint8)ElementsPerLOD };
+    if (FreeElements.Num() > 0)
+    {
+        const auto Index = FreeElements.Pop(false);
+        Elements[Index] = Element;
+        return Index;
+    }
+
+    return Elements.Add(Element);
+}
+
+void FQuadyVisibilityMasks::RemoveElement(const int32 Element)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    check(Elements.IsValidIndex(Element));
+    Elements[Element].ElementsPerLOD = 0;
+    FreeElements.Add(Element);
+}
+
+void FQuadyVisibilityMasks::BeginView(const uint32 ViewKey, const uint8 TopLevel, TArray<FQuadTreeLeaf>&& Leaves)
+{
+    auto View = MakeShared<FView, ESPMode::ThreadSafe>();
+
+    /* Holds the view, a replaced view lives until its task is done */
+    View->Task = Async<void>(EAsyncExecution::TaskGraph, [Masks = AsShared(), View, TopLevel, Leaves = MoveTemp(Leaves)]()
+    {
+        SCOPE_CYCLE_COUNTER(STAT_QuadyVisibilityMasks);
+
+        /* Registration can continue while computing */
+        TArray<FElement> Elements;
+        {
+            FScopeLock ScopeLock(&Masks->Lock);
+            Elements = Masks->Elements;
+        }
+
+        Compute(Elements, TopLevel, Leaves, *View->Visibility);
+    });
+
+    FScopeLock ScopeLock(&Lock);
+
+    /* Published with its task set, GetView may wait on it right away */
+    Views.Add(ViewKey, View);
+}
+
+TSharedPtr<const FQuadyViewVisibility, ESPMode::ThreadSafe> FQuadyVisibilityMasks::GetView(const uint32 ViewKey) const
+{
+    TSharedPtr<FView, ESPMode::ThreadSafe> View;
+    {
+        FScopeLock ScopeLock(&Lock);
+        View = Views.FindRef(ViewKey);
+    }
+
+    if (!View.IsValid())
+        return nullptr;
+
+    if (View->Task.IsValid() && !View->Task.IsReady())
+    {
+        SCOPE_CYCLE_COUNTER(STAT_QuadyVisibilityMasksWait);
+        View->Task.Wait();
+    }
+
+    return View->Visibility;
+}
+
+void FQuadyVisibilityMasks::RemoveView(const uint32 ViewKey)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    Views.Remove(ViewKey);
+}
+
+void FQuadyVisibilityMasks::Compute(const TArray<FElement>& Elements, const uint8 TopLevel, const TArray<FQuadTreeLeaf>& Leaves, FQuadyViewVisibility& OutVisibility)
+{
+    FMemMark Mark(FMemStack::Get());
+
+    /* Leaves by key with their level, and every selected node above them */
+    TSet<FQuadTreeNodeKey, DefaultKeyFuncs<FQuadTreeNodeKey>, TMemStackSetAllocator<>> LeafKeys;
+    TSet<FQuadTreeNodeKey, DefaultKeyFuncs<FQuadTreeNodeKey>, TMemStackSetAllocator<>> RefinedKeys;
+    LeafKeys.Reserve(Leaves.Num());
+
+    for (auto& Leaf : Leaves)
+    {
+        LeafKeys.Add(Leaf.Key);
+
+        /* Stop at the first ancestor already added, its own ancestors are too */
+        for (auto Level = Leaf.Level + 1; Level <= TopLevel; Level++)
+        {
+            bool bAlreadyInSet = false;
+            RefinedKeys.Add(FQuadTreeNodeKey(Leaf.Coordinates, Level), &bAlreadyInSet);
+            if (bAlreadyInSet)
+                break;
+        }
+    }
+
+    OutVisibility.ElementMasks.SetNumZeroed(Elements.Num());
+
+    for (auto Index = 0; Index < Elements.Num(); Index++)
+    {
+        const auto& Element = Elements[Index];
+        if (Element.ElementsPerLOD == 0)
+            continue;
+
+        const auto LODMask = (1ull << Element.ElementsPerLOD) - 1;
+
+        /* Selected finer than the quad, full detail */
+        if (RefinedKeys.Contains(FQuadTreeNodeKey(Element.ComponentBase, Element.Level)))
+        {
+            OutVisibility.ElementMasks[Index] = LODMask;
+            continue;
+        }
+
+        /* Covered by this leaf or an ancestor, one LOD per level coarser */
+        for (auto Level = (int32)Element.Level; Level <= TopLevel; Level++)
+        {
+            if (!LeafKeys.Contains(FQuadTreeNodeKey(Element.ComponentBase, Level)))
+                continue;
+
+            const auto LOD = FMath::Min(Level - Element.Level, MaxLODs - 1);
+            OutVisibility.ElementMasks[Index] = LODMask << (LOD * Element.ElementsPerLOD);
+            break;
+        }
+    }
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "QuadTreeNode.h"
+
+/* One view's result, a packed batch element mask per registered quad */
+struct FQuadyViewVisibility
+{
+public:
+    /* Bit LOD * ElementsPerLOD + Subsection, 0 when the quad isn't selected */
+    TArray<uint64> ElementMasks;
+
+    inline uint64 GetMask(const int32 Element) const
+    {
+        return ElementMasks.IsValidIndex(Element) ? ElementMasks[Element] : 0;
+    }
+};
+
+/*
+Batch element visibility for every Quady quad, computed once per view per frame on a
+worker from the quadtree selection. A quad draws at the LOD of the selected leaf covering
+it, at LOD 0 where the selection is finer, and not at all outside the selection, so
+GetStaticBatchElementVisibility is a single read instead of per element LOD math.
+
+The scene proxy drives it: BeginView from the selection when the view is set up, GetView
+from InitViewCustomData, AddElement into PrimitiveCustomDataIndex and the batch elements'
+ElementIndex. Until a proxy does, every quad draws LOD 0 as before.
+*/
+class FQuadyVisibilityMasks
+    : public TSharedFromThis<FQuadyVisibilityMasks, ESPMode::ThreadSafe>
+{
+public:
+    /* Batch element masks are 64 bit */
+    static const int32 MaxLODs = 8;
+
+    /* Dense index of a quad, kept as its PrimitiveCustomDataIndex. ElementsPerLOD is its subsection count */
+    int32 AddElement(const FIntPoint& ComponentBase, const uint8 Level, const int32 ElementsPerLOD);
+    void RemoveElement(const int32 Element);
+
+    /* Render thread. Start computing ViewKey's masks from its selection, replacing the previous frame's. TopLevel is the root's */
+    void BeginView(const uint32 ViewKey, const uint8 TopLevel, TArray<FQuadTreeLeaf>&& Leaves);
+
+    /* Render thread. Waits for ViewKey's masks, nullptr if the view was never begun. The next BeginView for the key
+       replaces them, so hold the reference for as long as the masks are read, such as in a one frame resource */
+    TSharedPtr<const FQuadyViewVisibility, ESPMode::ThreadSafe> GetView(const uint32 ViewKey) const;
+
+    /* Drop a view's masks, such as when it closes */
+    void RemoveView(const uint32 ViewKey);
+
+private:
+    struct FElement
+    {
+        FIntPoint ComponentBase;
+        uint8 Level;
+
+        /* 0 for free slots */
+        uint8 ElementsPerLOD;
+    };
+
+    struct FView
+    {
+        TFuture<void> Task;
+
+        /* Shared with GetView's callers, outlives the view when replaced */
+        TSharedRef<FQuadyViewVisibility, ESPMode::ThreadSafe> Visibility;
+
+        FView() : Visibility(MakeShared<FQuadyViewVisibility, ESPMode::ThreadSafe>()) { }
+    };
+
+    mutable FCriticalSection Lock;
+    TArray<FElement> Elements;
+    TArray<int32> FreeElements;
+    TMap<uint32, TSharedPtr<FView, ESPMode::ThreadSafe>> Views;
+
+    static void Compute(const TArray<FElement>& Elements, const uint8 TopLevel, const TArray<FQuadTreeLeaf>& Leaves, FQuadyViewVisibility& OutVisibility);
+};
@@ -0,0 +1,99 @@
+#include "QuadTreeClipmap.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeClipmapLeafChangesTest, "Quady.Clipmap.LeafChanges", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+struct FQuadTreeClipmapTestLeaf
+{
+    FQuadTreeNodeKey Key;
+    FFloatInterval HeightBounds;
+};
+
+bool FQuadTreeClipmapLeafChangesTest::RunTest(const FString& Parameters)
+{
+    const uint8 LevelCount = 5;
+    const auto CellSize = 100;
+    const TArray<float> Ranges = { 100.0f, 200.0f, 400.0f, 800.0f, 1600.0f };
+
+    FQuadTreeClipmap Clipmap;
+    Clipmap.Build(LevelCount, CellSize, Ranges);
+
+    auto Gather = [](const FQuadTreeClipmap& Source)
+    {
+        TArray<FQuadTreeClipmapTestLeaf> Leaves;
+        Source.ForEachLeaf([&Leaves](const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds) { Leaves.Add(FQuadTreeClipmapTestLeaf{ Key, HeightBounds }); });
+        return Leaves;
+    };
+
+    /* Mirrored the way UQuadTree keeps SelectedLeaves, starting empty like after Build */
+    TArray<FQuadTreeClipmapTestLeaf> Mirror;
+
+    /* Single cells, across nodes of several levels, past every ring, and back */
+    const FIntPoint Path[] =
+    {
+        FIntPoint(0, 0), FIntPoint(1, 0), FIntPoint(2, 1), FIntPoint(5, 3), FIntPoint(-3, 9),
+        FIntPoint(17, -6), FIntPoint(40, -17), FIntPoint(-300, 260), FIntPoint(-299, 261), FIntPoint(0, 0)
+    };
+
+    for (auto Step = 0; Step < ARRAY_COUNT(Path); Step++)
+    {
+        const auto& Cell = Path[Step];
+        const auto Context = FString::Printf(TEXT("Move %d to %d, %d"), Step, Cell.X, Cell.Y);
+
+        Clipmap.Update(Cell);
+        Clipmap.ApplyLeafChanges<FQuadTreeClipmapTestLeaf>(Mirror, [](const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds)
+        {
+            return FQuadTreeClipmapTestLeaf{ Key, HeightBounds };
+        });
+
+        /* Refit a few leaves in place, as UQuadTree::RefitHeightBounds patches the mirror */
+        for (auto Index = Step; Index < Mirror.Num(); Index += 7)
+        {
+            const auto HeightBounds = FFloatInterval((float)Step, (float)(Step + Index));
+            TestTrue(Context + TEXT(", refit leaf is resident"), Clipmap.SetHeightBounds(Mirror[Index].Key, HeightBounds));
+
+            const auto LeafIndex = Clipmap.FindLeaf(Mirror[Index].Key);
+            if (!TestEqual(Context + TEXT(", refit leaf is found where the mirror has it"), LeafIndex, Index))
+                return false;
+
+            Mirror[LeafIndex].HeightBounds = HeightBounds;
+        }
+
+        /* Same leaves in the same order with the same bounds */
+        const auto Leaves = Gather(Clipmap);
+        if (!TestEqual(Context + TEXT(", leaf count"), Mirror.Num(), Leaves.Num()))
+            return false;
+
+        for (auto Index = 0; Index < Leaves.Num(); Index++)
+        {
+            if (Mirror[Index].Key != Leaves[Index].Key || Mirror[Index].HeightBounds.Min != Leaves[Index].HeightBounds.Min || Mirror[Index].HeightBounds.Max != Leaves[Index].HeightBounds.Max)
+            {
+                AddError(FString::Printf(TEXT("%s, replayed leaf %d differs"), *Context, Index));
+                return false;
+            }
+        }
+
+        /* And the same set a clipmap placed there from scratch selects */
+        FQuadTreeClipmap Fresh;
+        Fresh.Build(LevelCount, CellSize, Ranges);
+        Fresh.Update(Cell);
+
+        TSet<FQuadTreeNodeKey> FreshKeys;
+        for (auto& Leaf : Gather(Fresh))
+            FreshKeys.Add(Leaf.Key);
+
+        TSet<FQuadTreeNodeKey> MirrorKeys;
+        for (auto& Leaf : Mirror)
+            MirrorKeys.Add(Leaf.Key);
+
+        TestEqual(Context + TEXT(", no leaf is duplicated"), MirrorKeys.Num(), Mirror.Num());
+        TestTrue(Context + TEXT(", same leaves as a fresh clipmap"), MirrorKeys.Num() == FreshKeys.Num() && MirrorKeys.Difference(FreshKeys).Num() == 0);
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "QuadTreeCore.h"
+
+#include "QuadTree.h"
+#include "QuadTreeGrid.h"
+#include "QuadTreeOcclusion.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeCoreOcclusionTest, "Quady.Core.OccludedSiblings", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeCoreRootKeysTest, "Quady.Core.RootKeys", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeCoreStaleBoundsTest, "Quady.Core.StaleBounds", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuadTreeCoreOcclusionTest::RunTest(const FString& Parameters)
+{
+    FQuadTreeGrid Grid;
+    Grid.CellSize = 100;
+
+    /* 8 x 8 cells, heights refit per leaf like a cached height tile does */
+    TQuadTree<4, FQuadTreeHeightBoundsPolicy> Core;
+    Core.Build(4, FIntPoint(0, 0), FFloatInterval(0.0f, 10000.0f));
+
+    /* A wall one cell east of the viewer, low ground behind it */
+    for (auto Y = 0; Y < 2; Y++)
+    {
+        Core.RefitHeightBounds(FQuadTreeNodeKey(FIntPoint(1, Y), 0), FFloatInterval(4900.0f, 5000.0f));
+        for (auto X = 2; X < 4; X++)
+            Core.RefitHeightBounds(FQuadTreeNodeKey(FIntPoint(X, Y), 0), FFloatInterval(0.0f, 10.0f));
+    }
+
+    FQuadTreeViewer Viewer;
+    Viewer.SetLocation(Grid, FVector(50.0f, 50.0f, 10.0f));
+    Viewer.SetRanges({ 1000.0f, 2000.0f, 4000.0f, 8000.0f });
+
+    FQuadTreeOcclusionBuffer Occlusion;
+    Occlusion.Reset(Viewer.GetCellOffset());
+    for (auto Y = 0; Y < 2; Y++)
+        Occlusion.AddOccluder(Viewer.GetRelativeBounds(FIntPoint(1, Y), 0, FFloatInterval(4900.0f, 5000.0f)));
+
+    Viewer.SetOcclusion(&Occlusion);
+    Core.Select(Viewer);
+
+    TSet<FQuadTreeNodeKey> Leaves;
+    Core.ForEachSelectedLeaf([&Leaves](const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds) { Leaves.Add(Key); });
+
+    /* The node at (2, 0) splits for its near children, its far ones are behind the wall */
+    TestFalse(TEXT("Split node is not a leaf"), Leaves.Contains(FQuadTreeNodeKey(FIntPoint(2, 0), 1)));
+    TestTrue(TEXT("Near child is selected"), Leaves.Contains(FQuadTreeNodeKey(FIntPoint(2, 0), 0)));
+    TestTrue(TEXT("Near child is selected"), Leaves.Contains(FQuadTreeNodeKey(FIntPoint(2, 1), 0)));
+    TestFalse(TEXT("Occluded sibling is not reselected"), Leaves.Contains(FQuadTreeNodeKey(FIntPoint(3, 0), 0)));
+    TestFalse(TEXT("Occluded sibling is not reselected"), Leaves.Contains(FQuadTreeNodeKey(FIntPoint(3, 1), 0)));
+
+    /* A node level with the horizon. Its footprint spans bins 8 to 11 of 256, one vector compare, and its
+       slope is exactly the occluder's: -100 over a min distance of 100, -2500 over a max distance of 2500 */
+    FQuadTreeOcclusionBuffer Boundary;
+    Boundary.Reset(FVector::ZeroVector);
+    Boundary.AddOccluder(FBox(FVector(100.0f, 0.0f, -100.0f), FVector(200.0f, 100.0f, 0.0f)));
+
+    auto MakeBehind = [](const float Top) { return FBox(FVector(2350.0f, 500.0f, -3000.0f), FVector(2400.0f, 700.0f, Top)); };
+    TestFalse(TEXT("Node level with the horizon is visible"), Boundary.IsOccluded(MakeBehind(-2500.0f)));
+    TestTrue(TEXT("Node just below the horizon is occluded"), Boundary.IsOccluded(MakeBehind(-2510.0f)));
+    TestFalse(TEXT("Node just above the horizon is visible"), Boundary.IsOccluded(MakeBehind(-2490.0f)));
+
+    return true;
+}
+
+bool FQuadTreeCoreRootKeysTest::RunTest(const FString& Parameters)
+{
+    /* A centered root sits half its size below the origin, which a key can't hold */
+    const uint8 LevelCount = 5;
+    const auto TopLevel = (uint8)(LevelCount - 1);
+    const auto TileCells = 1 << TopLevel;
+    TestFalse(TEXT("Half size offset root is unaligned"), FQuadTreeNodeKey::IsAligned(FIntPoint(-(TileCells >> 1), -(TileCells >> 1)), TopLevel));
+
+    /* So UQuadTree moves the grid under the root instead */
+    auto* Tree = NewObject<UQuadTree>();
+    Tree->MinimumQuadSize = 100;
+    Tree->MaximumQuadSize = 100 << TopLevel;
+    Tree->Build();
+
+    FIntPoint Cell;
+    FVector CellOffset;
+    Tree->GetGrid().ToCell(FVector::ZeroVector, Cell, CellOffset);
+    TestTrue(TEXT("World origin is the root's center cell"), Cell == FIntPoint(TileCells >> 1, TileCells >> 1));
+
+    TQuadTree<LevelCount, FQuadTreeHeightBoundsPolicy> Core;
+    Core.Build(LevelCount, FIntPoint::ZeroValue, FFloatInterval(-1000.0f, 1000.0f));
+
+    /* The root and its children round trip and are found in the tree */
+    const auto HalfCells = TileCells >> 1;
+    const FQuadTreeNodeKey Keys[] =
+    {
+        FQuadTreeNodeKey(FIntPoint::ZeroValue, TopLevel),
+        FQuadTreeNodeKey(FIntPoint(0, 0), TopLevel - 1),
+        FQuadTreeNodeKey(FIntPoint(HalfCells, 0), TopLevel - 1),
+        FQuadTreeNodeKey(FIntPoint(0, HalfCells), TopLevel - 1),
+        FQuadTreeNodeKey(FIntPoint(HalfCells, HalfCells), TopLevel - 1)
+    };
+
+    for (auto& Key : Keys)
+    {
+        const auto Context = FString::Printf(TEXT("Level %d at %d, %d"), Key.GetLevel(), Key.GetCoordinates().X, Key.GetCoordinates().Y);
+        TestTrue(Context + TEXT(" round trips"), FQuadTreeNodeKey(Key.GetCoordinates(), Key.GetLevel()) == Key);
+        TestTrue(Context + TEXT(" is in the tree"), Core.FindNodeIndex(Key) != INDEX_NONE);
+    }
+
+    /* Refitting a child reaches the root through the same keys */
+    Core.RefitHeightBounds(Keys[4], FFloatInterval(200.0f, 300.0f));
+    FFloatInterval RootHeightBounds;
+    TestTrue(TEXT("Root height bounds are found"), Core.GetHeightBounds(Keys[0], RootHeightBounds));
+    TestTrue(TEXT("Root includes the refit child"), RootHeightBounds.Contains(250.0f));
+
+    /* Negative, aligned roots round trip too, as tiles west and south of the origin are */
+    const auto TileKey = FQuadTreeNodeKey(FIntPoint(-TileCells, -TileCells), TopLevel);
+    TestTrue(TEXT("Negative tile round trips"), TileKey.GetCoordinates() == FIntPoint(-TileCells, -TileCells));
+
+    return true;
+}
+
+bool FQuadTreeCoreStaleBoundsTest::RunTest(const FString& Parameters)
+{
+    const auto RootHeightBounds = FFloatInterval(0.0f, 10000.0f);
+
+    TQuadTree<3, FQuadTreeHeightBoundsPolicy> Core;
+    Core.Build(3, FIntPoint(0, 0), RootHeightBounds);
+
+    /* Fit from earlier tiles, flat ground */
+    for (auto Y = 0; Y < 4; Y++)
+        for (auto X = 0; X < 4; X++)
+            Core.RefitHeightBounds(FQuadTreeNodeKey(FIntPoint(X, Y), 0), FFloatInterval(0.0f, 10.0f));
+
+    /* A hill is raised on cell 1, 0 while its level 1 parent is the selected leaf */
+    const auto Cells = FIntRect(FIntPoint(1, 0), FIntPoint(2, 1));
+    const auto Edited = FQuadTreeNodeKey(FIntPoint(0, 0), 1);
+    TestTrue(TEXT("Edited node is in the tree"), Core.ResetDescendantHeightBounds(Edited, Cells));
+    Core.RefitHeightBounds(Edited, FFloatInterval(0.0f, 3000.0f));
+
+    FFloatInterval HeightBounds;
+    Core.GetHeightBounds(FQuadTreeNodeKey(FIntPoint(1, 0), 0), HeightBounds);
+    TestTrue(TEXT("Descendant under the edit can hold the hill"), HeightBounds.Contains(3000.0f));
+
+    Core.GetHeightBounds(FQuadTreeNodeKey(FIntPoint(0, 0), 0), HeightBounds);
+    TestTrue(TEXT("Descendant outside the edit keeps its fit"), HeightBounds.Max < 100.0f);
+
+    Core.GetHeightBounds(FQuadTreeNodeKey(FIntPoint(2, 0), 0), HeightBounds);
+    TestTrue(TEXT("Other subtrees keep their fit"), HeightBounds.Max < 100.0f);
+
+    Core.GetHeightBounds(FQuadTreeNodeKey(FIntPoint(0, 0), 2), HeightBounds);
+    TestTrue(TEXT("Root includes the edit"), HeightBounds.Contains(3000.0f));
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "QuadTreeHeightAtlas.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeHeightAtlasPagingTest, "Quady.HeightAtlas.Paging", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeHeightAtlasUploadTest, "Quady.HeightAtlas.Uploads", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+static FQuadTreeNodeKey MakeAtlasTestKey(const int32 Index)
+{
+    return FQuadTreeNodeKey(FIntPoint(Index, 0), 0);
+}
+
+bool FQuadTreeHeightAtlasPagingTest::RunTest(const FString& Parameters)
+{
+    /* 4 slots */
+    FQuadTreeHeightAtlas Atlas(2, 4);
+
+    bool bAllocated;
+    int32 Slots[4];
+
+    Atlas.BeginFrame();
+    for (auto Index = 0; Index < 4; Index++)
+    {
+        Slots[Index] = Atlas.Acquire(MakeAtlasTestKey(Index), bAllocated);
+        TestTrue(TEXT("Free slot is allocated"), Slots[Index] != INDEX_NONE && bAllocated);
+    }
+
+    TestEqual(TEXT("Every slot is resident"), Atlas.Num(), 4);
+
+    /* Every slot is in use this frame, the tail can't be evicted */
+    TestEqual(TEXT("Full frame refuses a fifth key"), Atlas.Acquire(MakeAtlasTestKey(4), bAllocated), INDEX_NONE);
+    TestFalse(TEXT("Refused key isn't allocated"), bAllocated);
+
+    /* Touching 0 again leaves 1 least recently used */
+    Atlas.BeginFrame();
+    TestEqual(TEXT("Resident key keeps its slot"), Atlas.Acquire(MakeAtlasTestKey(0), bAllocated), Slots[0]);
+    TestFalse(TEXT("Resident key isn't reallocated"), bAllocated);
+
+    TestEqual(TEXT("First eviction takes the least recently used slot"), Atlas.Acquire(MakeAtlasTestKey(4), bAllocated), Slots[1]);
+    TestTrue(TEXT("Evicting key is allocated"), bAllocated);
+    TestEqual(TEXT("Evicted key is gone"), Atlas.Find(MakeAtlasTestKey(1)), INDEX_NONE);
+
+    TestEqual(TEXT("Second eviction takes the next one"), Atlas.Acquire(MakeAtlasTestKey(5), bAllocated), Slots[2]);
+    TestEqual(TEXT("Evicted key is gone"), Atlas.Find(MakeAtlasTestKey(2)), INDEX_NONE);
+
+    /* An invalidated slot goes to the tail, so it's reused ahead of the least recently used 3 */
+    Atlas.Invalidate(MakeAtlasTestKey(0));
+    TestEqual(TEXT("Invalidated key is gone"), Atlas.Find(MakeAtlasTestKey(0)), INDEX_NONE);
+    TestEqual(TEXT("Invalidated slot is reused first"), Atlas.Acquire(MakeAtlasTestKey(6), bAllocated), Slots[0]);
+    TestEqual(TEXT("Least recently used key is still resident"), Atlas.Find(MakeAtlasTestKey(3)), Slots[3]);
+
+    /* 3 was last used a frame ago, the rest this frame */
+    TestEqual(TEXT("Stale slot is evicted within the frame"), Atlas.Acquire(MakeAtlasTestKey(7), bAllocated), Slots[3]);
+    TestEqual(TEXT("Then the frame is full"), Atlas.Acquire(MakeAtlasTestKey(8), bAllocated), INDEX_NONE);
+
+    return true;
+}
+
+bool FQuadTreeHeightAtlasUploadTest::RunTest(const FString& Parameters)
+{
+    const auto SlotsPerSide = 2;
+    const auto SlotSize = 4;
+    const auto SlotTexels = SlotSize * SlotSize;
+    FQuadTreeHeightAtlas Atlas(SlotsPerSide, SlotSize);
+
+    TArray<FColor> Staging;
+    TArray<FQuadTreeHeightAtlasRegion> Regions;
+    TestFalse(TEXT("Nothing queued, nothing to take"), Atlas.TakeUploads(Staging, Regions));
+
+    bool bAllocated;
+    int32 Slots[3];
+
+    Atlas.BeginFrame();
+    for (auto Index = 0; Index < 3; Index++)
+    {
+        Slots[Index] = Atlas.Acquire(MakeAtlasTestKey(Index), bAllocated);
+        Atlas.QueueUpload(Slots[Index]);
+    }
+
+    /* Queued once however often */
+    Atlas.QueueUpload(Slots[1]);
+
+    for (auto Index = 0; Index < 3; Index++)
+    {
+        auto* Texels = Atlas.GetQueuedTexels(Slots[Index]);
+        for (auto Texel = 0; Texel < SlotTexels; Texel++)
+            Texels[Texel] = FColor((uint8)Index, (uint8)Texel, 0, 255);
+    }
+
+    /* A previous upload's image, handed back to stage the next frame */
+    TArray<FColor> Recycled;
+    Recycled.Reserve(SlotTexels * 4);
+    const auto* RecycledData = Recycled.GetData();
+
+    TestTrue(TEXT("Queued slots are taken"), Atlas.TakeUploads(Recycled, Regions));
+    TestEqual(TEXT("One slot of texels per queued slot"), Recycled.Num(), SlotTexels * 3);
+    TestEqual(TEXT("One region per queued slot"), Regions.Num(), 3);
+
+    for (auto& Region : Regions)
+    {
+        /* Source rows are SlotSize texels wide, first texel tells which slot was written there */
+        const auto& First = Recycled[Region.SourceY * SlotSize];
+        const auto Index = (int32)First.R;
+        if (!TestTrue(TEXT("Region points at a written slot"), Index < 3 && First.G == 0))
+            return false;
+
+        const auto Slot = Slots[Index];
+        TestTrue(FString::Printf(TEXT("Slot %d lands on its corner"), Slot), Region.Destination == FIntPoint(Slot % SlotsPerSide, Slot / SlotsPerSide) * SlotSize);
+        TestEqual(FString::Printf(TEXT("Slot %d's last texel follows its first"), Slot), (int32)Recycled[Region.SourceY * SlotSize + SlotTexels - 1].G, SlotTexels - 1);
+    }
+
+    /* Swapped, not moved, so the next frame stages into the recycled image */
+    Atlas.BeginFrame();
+    const auto Slot = Atlas.Acquire(MakeAtlasTestKey(3), bAllocated);
+    Atlas.QueueUpload(Slot);
+    TestTrue(TEXT("Next frame stages into the recycled image"), Atlas.GetQueuedTexels(Slot) == RecycledData);
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#include "QuadTreeHeightSource.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeHeightSourceDerivationTest, "Quady.HeightSource.Derivation", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuadTreeHeightSourceDerivationTest::RunTest(const FString& Parameters)
+{
+    const FQuadTreeProceduralHeightSource Source{ FQuadTreeNoiseSettings() };
+
+    const auto CellSize = 100;
+    const auto SampleCount = 17;
+
+    auto Generate = [&Source](const FQuadTreeHeightTile* Parent, const FIntPoint& Coordinates, const uint8 Level)
+    {
+        FQuadTreeHeightTile Tile(FQuadTreeNodeKey(Coordinates, Level), CellSize, SampleCount);
+        Source.Generate(Parent, Tile);
+        return Tile;
+    };
+
+    /* Straddles the origin so negative lattice cells are covered too */
+    const auto Parent = Generate(nullptr, FIntPoint(-32, -32), 5);
+    TestTrue(TEXT("Children resolve more octaves than their parent"), Source.GetOctaveCount(Parent.GetSampleSpacing() * 0.5f) > Parent.Detail);
+
+    const FIntPoint Quadrants[] = { FIntPoint(0, 0), FIntPoint(1, 0), FIntPoint(0, 1), FIntPoint(1, 1) };
+    for (auto& Quadrant : Quadrants)
+    {
+        const auto Coordinates = Parent.Key.GetCoordinates() + Quadrant * 16;
+        const auto Derived = Generate(&Parent, Coordinates, 4);
+        const auto Direct = Generate(nullptr, Coordinates, 4);
+
+        /* Exact, cached and uncached tiles must not disagree */
+        const auto Context = FString::Printf(TEXT("Child %d, %d"), Coordinates.X, Coordinates.Y);
+        TestTrue(Context + TEXT(" is bit identical derived or direct"), Derived.Heights == Direct.Heights);
+    }
+
+    /* Neighbors share their edge samples */
+    const auto West = Generate(nullptr, FIntPoint(-16, 0), 4);
+    const auto East = Generate(nullptr, FIntPoint(0, 0), 4);
+    for (auto Y = 0; Y < SampleCount; Y++)
+    {
+        if (West.Heights[Y * SampleCount + SampleCount - 1] != East.Heights[Y * SampleCount])
+        {
+            AddError(FString::Printf(TEXT("Shared edge sample %d differs"), Y));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "QuadTreeRelevancy.h"
+
+#include "QuadTreeGrid.h"
+#include "Misc/AutomationTest.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Engine/StaticMeshActor.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeRelevancyCullingTest, "Quady.Relevancy.Culling", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeRelevancyRootLeafTest, "Quady.Relevancy.RootLeaf", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuadTreeRelevancyCullingTest::RunTest(const FString& Parameters)
+{
+    auto* World = UWorld::CreateWorld(EWorldType::Game, false);
+    auto& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+    WorldContext.SetCurrentWorld(World);
+
+    /* Same layout as a 100 cell, 8 level QuadTree centered on the origin */
+    FQuadTreeGrid Grid;
+    Grid.CellSize = 100;
+
+    const uint8 LevelCount = 8;
+    TArray<float> Ranges;
+    for (auto Level = 0; Level < LevelCount; Level++)
+        Ranges.Add((Grid.CellSize >> 1) * (float)(1 << Level));
+
+    /* UQuadTree moves the grid under the root rather than the root off cell (0, 0) */
+    const auto HalfSize = Grid.CellSize << (LevelCount - 2);
+    Grid.Origin = FIntVector(-HalfSize, -HalfSize, 0);
+    const auto RootCoordinates = FIntPoint::ZeroValue;
+
+    FQuadTreeRelevancy Relevancy(Grid);
+    Relevancy.Configure(LevelCount, Ranges, &RootCoordinates);
+
+    /* Both inside the root, the far one well beyond the ranges of the levels around it */
+    auto* Near = World->SpawnActor<AStaticMeshActor>(FVector(150.0f, 150.0f, 0.0f), FRotator::ZeroRotator);
+    auto* Far = World->SpawnActor<AStaticMeshActor>(FVector(6000.0f, 6000.0f, 0.0f), FRotator::ZeroRotator);
+    Relevancy.Register(Near);
+    Relevancy.Register(Far);
+
+    TArray<FQuadTreeRelevantActor> Relevant;
+    Relevancy.GetRelevantActors(World, FVector(50.0f, 50.0f, 0.0f), Relevant);
+
+    auto Contains = [&Relevant](const AActor* Actor) { return Relevant.ContainsByPredicate([Actor](const FQuadTreeRelevantActor& Item) { return Item.Actor == Actor; }); };
+    TestTrue(TEXT("Near actor is relevant"), Contains(Near));
+    TestFalse(TEXT("Far actor is not relevant"), Contains(Far));
+
+    GEngine->DestroyWorldContext(World);
+    World->DestroyWorld(false);
+
+    return true;
+}
+
+bool FQuadTreeRelevancyRootLeafTest::RunTest(const FString& Parameters)
+{
+    auto* World = UWorld::CreateWorld(EWorldType::Game, false);
+    auto& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+    WorldContext.SetCurrentWorld(World);
+
+    FQuadTreeGrid Grid;
+    Grid.CellSize = 100;
+
+    /* Only the top range reaches past the root, so a client outside it cuts the root alone */
+    const uint8 LevelCount = 4;
+    const TArray<float> Ranges = { 50.0f, 100.0f, 200.0f, 100000.0f };
+
+    /* Centered on cell (0, 0), so unaligned, its key would decode to [-8, 0) */
+    const auto RootCoordinates = FIntPoint(-4, -4);
+
+    FQuadTreeRelevancy Relevancy(Grid);
+    Relevancy.Configure(LevelCount, Ranges, &RootCoordinates);
+
+    auto* Positive = World->SpawnActor<AStaticMeshActor>(FVector(150.0f, 150.0f, 0.0f), FRotator::ZeroRotator);
+    auto* Negative = World->SpawnActor<AStaticMeshActor>(FVector(-150.0f, -150.0f, 0.0f), FRotator::ZeroRotator);
+    auto* Outside = World->SpawnActor<AStaticMeshActor>(FVector(-650.0f, -650.0f, 0.0f), FRotator::ZeroRotator);
+    Relevancy.Register(Positive);
+    Relevancy.Register(Negative);
+    Relevancy.Register(Outside);
+
+    TArray<FQuadTreeRelevantActor> Relevant;
+    Relevancy.GetRelevantActors(World, FVector(2050.0f, 2050.0f, 0.0f), Relevant);
+
+    auto Find = [&Relevant](const AActor* Actor) { return Relevant.FindByPredicate([Actor](const FQuadTreeRelevantActor& Item) { return Item.Actor == Actor; }); };
+    TestTrue(TEXT("Actor in the root's positive half is relevant"), Find(Positive) != nullptr);
+    TestTrue(TEXT("Actor in the root's negative half is relevant"), Find(Negative) != nullptr);
+    TestTrue(TEXT("Actor outside the root is not relevant"), Find(Outside) == nullptr);
+
+    if (const auto* Item = Find(Positive))
+        TestEqual(TEXT("Priority is the root's level"), (int32)Item->Level, LevelCount - 1);
+
+    GEngine->DestroyWorldContext(World);
+    World->DestroyWorld(false);
+
+    return true;
+}
+
+#endif
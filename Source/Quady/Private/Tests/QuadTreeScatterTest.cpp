@@ -0,0 +1,114 @@
+#include "QuadTreeScatter.h"
+
+#include "Misc/AutomationTest.h"
+#include "HAL/PlatformProcess.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeScatterPoolingTest, "Quady.Scatter.Pooling", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuadTreeScatterPoolingTest::RunTest(const FString& Parameters)
+{
+    const auto CellSize = 1000;
+    const auto SampleCount = 9;
+
+    TArray<FQuadTreeScatterLayer> Settings;
+    Settings.AddDefaulted();
+    Settings[0].Density = 40.0f;
+
+    /* Every tile is resident and flat, a leaf only waits on its own generation */
+    TMap<FQuadTreeNodeKey, FQuadTreeHeightTilePtr> Tiles;
+    TMap<FQuadTreeNodeKey, int32> InstanceCounts;
+    auto MakeLeaf = [&](const int32 Index)
+    {
+        const auto Key = FQuadTreeNodeKey(FIntPoint(Index, 0), 0);
+        if (!Tiles.Contains(Key))
+        {
+            auto Tile = MakeShared<FQuadTreeHeightTile, ESPMode::ThreadSafe>(Key, CellSize, SampleCount);
+            Tile->Heights.Init(0.0f, SampleCount * SampleCount);
+
+            TArray<FTransform> Instances;
+            FQuadTreeScatter::Generate(Settings[0], 0, *Tile, Instances);
+            InstanceCounts.Add(Key, Instances.Num());
+            Tiles.Add(Key, Tile);
+        }
+
+        return FQuadTreeLeaf(Key, Key.GetCoordinates(), FFloatInterval(0.0f, 0.0f), 0, FVector2D::ZeroVector);
+    };
+
+    const auto A = MakeLeaf(0);
+    const auto B = MakeLeaf(1);
+    const auto C = MakeLeaf(2);
+    const auto D = MakeLeaf(3);
+    const auto Count = [&InstanceCounts](const FQuadTreeLeaf& Leaf) { return InstanceCounts[Leaf.Key]; };
+
+    if (!TestTrue(TEXT("Leaves get instances"), Count(A) > 0 && Count(B) > 0 && Count(C) > 0 && Count(D) > 0))
+        return false;
+
+    FQuadTreeScatter Scatter(Settings);
+    auto FindTile = [&Tiles](const FQuadTreeNodeKey Key) { return Tiles.FindRef(Key); };
+
+    /* Slot to whether it currently holds a visible instance */
+    TMap<int32, bool> Visible;
+    auto VisibleCount = [&Visible]()
+    {
+        auto Num = 0;
+        for (auto& KVP : Visible)
+            Num += KVP.Value ? 1 : 0;
+        return Num;
+    };
+
+    /* Generation runs on workers, updates until every selected leaf is written */
+    auto Settle = [&](const int32 ExpectedVisible)
+    {
+        TArray<FQuadTreeScatterWrite> Writes;
+        for (auto Attempt = 0; Attempt < 5000; Attempt++)
+        {
+            Writes.Reset();
+            Scatter.Update(FindTile, Writes);
+            for (auto& Write : Writes)
+                Visible.Add(Write.Slot, !Write.Transform.GetScale3D().IsNearlyZero());
+
+            if (VisibleCount() == ExpectedVisible)
+                return true;
+
+            FPlatformProcess::Sleep(0.001f);
+        }
+
+        return false;
+    };
+
+    /* A is deselected right after its generation started, before it was ever written */
+    Scatter.SetSelection({ A, B });
+    TArray<FQuadTreeScatterWrite> Started;
+    Scatter.Update(FindTile, Started);
+    TestEqual(TEXT("Nothing is written while generating"), Started.Num(), 0);
+
+    Scatter.SetSelection({ B, C });
+    if (!TestTrue(TEXT("B and C are written"), Settle(Count(B) + Count(C))))
+        return false;
+
+    /* A's generation never took a slot, so slots stay dense */
+    TestEqual(TEXT("Only selected leaves hold slots"), Scatter.GetSlotCount(0), Count(B) + Count(C));
+    TestEqual(TEXT("Two leaves are selected"), Scatter.GetLeafCount(), 2);
+
+    /* B's slots are hidden and handed to D */
+    Scatter.SetSelection({ C, D });
+    if (!TestTrue(TEXT("C and D are written"), Settle(Count(C) + Count(D))))
+        return false;
+
+    TestEqual(TEXT("Slots are reused before new ones are added"), Scatter.GetSlotCount(0), FMath::Max(Count(B), Count(D)) + Count(C));
+    for (auto& KVP : Visible)
+        TestTrue(TEXT("Every written slot is within the slot count"), KVP.Key >= 0 && KVP.Key < Scatter.GetSlotCount(0));
+
+    /* A comes back through a pooled leaf and is generated again, with no stale task or instances */
+    Scatter.SetSelection({ A, C, D });
+    if (!TestTrue(TEXT("Reselected A is written"), Settle(Count(A) + Count(C) + Count(D))))
+        return false;
+
+    TestEqual(TEXT("Slot count is the largest selection's"), Scatter.GetSlotCount(0), FMath::Max(FMath::Max(Count(B), Count(D)) + Count(C), Count(A) + Count(C) + Count(D)));
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include "QuadyMobileMesh.h"
+
+#include "QuadTreeHeightSource.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadyMobileMeshPackingTest, "Quady.Mobile.Packing", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadyMobileMeshStitchingTest, "Quady.Mobile.Stitching", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuadyMobileMeshPackingTest::RunTest(const FString& Parameters)
+{
+    /* Rounded to the nearest packed unit */
+    for (auto Height = -200.0f; Height <= 200.0f; Height += 0.37f)
+    {
+        const auto Decoded = FQuadyMobileMesh::DecodeHeight(FQuadyMobileMesh::EncodeHeight(Height));
+        TestTrue(FString::Printf(TEXT("Height %f round trips"), Height), FMath::Abs(Decoded - Height) <= FQuadyMobileMesh::ZScale * 0.5f + KINDA_SMALL_NUMBER);
+    }
+
+    const auto QuadsPerSide = 16;
+    const auto HeightScale = 4.0f;
+
+    FQuadTreeHeightTile Tile(FQuadTreeNodeKey(FIntPoint(0, 0), 4), 100, QuadsPerSide + 1);
+    FRandomStream Random(1234);
+    for (auto Index = 0; Index < FMath::Square(Tile.SampleCount); Index++)
+        Tile.Heights.Add(Random.FRandRange(-300.0f, 300.0f));
+
+    TArray<FQuadyMobileVertex> Vertices;
+    FQuadyMobileMesh::PackVertices(Tile, HeightScale, Vertices);
+    TestEqual(TEXT("One vertex per sample"), Vertices.Num(), Tile.Heights.Num());
+
+    const auto LODCount = FQuadyMobileMesh::GetLODCount(QuadsPerSide);
+    for (auto Y = 0; Y <= QuadsPerSide; Y++)
+    {
+        for (auto X = 0; X <= QuadsPerSide; X++)
+        {
+            const auto& Vertex = Vertices[Y * (QuadsPerSide + 1) + X];
+            TestTrue(TEXT("Position is the sample"), Vertex.Position[0] == X && Vertex.Position[1] == Y);
+
+            /* Normalized to a byte between min and max, LODs 4 and 5 also lose their low bit to SubX and SubY */
+            const auto Min = FQuadyMobileMesh::DecodeHeight((uint16)((Vertex.LODHeights[0] << 8) | Vertex.LODHeights[1]));
+            const auto Max = FQuadyMobileMesh::DecodeHeight((uint16)((Vertex.LODHeights[2] << 8) | Vertex.LODHeights[3]));
+            const auto Tolerance = (Max - Min) * 2.0f / 255.0f + KINDA_SMALL_NUMBER;
+
+            for (auto LOD = 0; LOD < FQuadyMobileMesh::MaxLODs; LOD++)
+            {
+                const auto Expected = FQuadyMobileMesh::GetLODHeight(Tile.Heights, QuadsPerSide, X, Y, FMath::Min(LOD, LODCount - 1)) / HeightScale;
+                const auto Unpacked = FQuadyMobileMesh::UnpackHeight(Vertex, LOD);
+                if (FMath::Abs(Unpacked - Expected) > Tolerance)
+                {
+                    AddError(FString::Printf(TEXT("Vertex %d, %d at LOD %d unpacks to %f instead of %f"), X, Y, LOD, Unpacked, Expected));
+                    return false;
+                }
+            }
+
+            /* LOD 0 is the sample itself */
+            TestTrue(TEXT("LOD 0 is the sample"), FMath::Abs(FQuadyMobileMesh::UnpackHeight(Vertex, 0) * HeightScale - Tile.Heights[Y * (QuadsPerSide + 1) + X]) <= Tolerance * HeightScale);
+        }
+    }
+
+    return true;
+}
+
+bool FQuadyMobileMeshStitchingTest::RunTest(const FString& Parameters)
+{
+    const auto QuadsPerSide = 8;
+    const auto Stride = QuadsPerSide + 1;
+
+    const FQuadyMobileIndexTable Table(QuadsPerSide);
+    const auto& Indices = Table.GetIndices();
+    TestEqual(TEXT("LODs down to a single quad"), Table.GetLODCount(), 4);
+
+    for (auto LOD = 0; LOD < Table.GetLODCount(); LOD++)
+    {
+        const auto Step = 1 << LOD;
+        const auto bCanStitch = QuadsPerSide / Step >= 2;
+
+        for (auto StitchMask = 0; StitchMask < FQuadyMobileIndexTable::StitchMaskCount; StitchMask++)
+        {
+            const auto& Range = Table.GetRange(LOD, (uint8)StitchMask);
+            if (!TestTrue(TEXT("Range is in the table"), Range.FirstIndex >= 0 && Range.FirstIndex + Range.NumPrimitives * 3 <= Indices.Num()))
+                return false;
+
+            /* Covers the patch exactly once, same winding throughout */
+            TSet<uint16> Used;
+            auto Area = 0;
+            auto bSameWinding = true;
+            for (auto Triangle = 0; Triangle < Range.NumPrimitives; Triangle++)
+            {
+                FIntPoint Corners[3];
+                for (auto Corner = 0; Corner < 3; Corner++)
+                {
+                    const auto Index = Indices[Range.FirstIndex + Triangle * 3 + Corner];
+                    Used.Add(Index);
+                    Corners[Corner] = FIntPoint(Index % Stride, Index / Stride);
+                }
+
+                const auto DoubleArea = (Corners[1] - Corners[0]).X * (Corners[2] - Corners[0]).Y - (Corners[1] - Corners[0]).Y * (Corners[2] - Corners[0]).X;
+                bSameWinding &= DoubleArea < 0;
+                Area += FMath::Abs(DoubleArea);
+            }
+
+            const auto Context = FString::Printf(TEXT("LOD %d, stitch mask %d"), LOD, StitchMask);
+            TestTrue(Context + TEXT(" has one winding"), bSameWinding);
+            TestEqual(Context + TEXT(" covers the patch"), Area, 2 * QuadsPerSide * QuadsPerSide);
+
+            /* NWES, a stitched edge keeps only the coarser neighbor's vertices, every other edge keeps the LOD's */
+            for (auto Along = 0; Along <= QuadsPerSide; Along += Step)
+            {
+                const FIntPoint EdgeVertices[] =
+                {
+                    FIntPoint(Along, 0),
+                    FIntPoint(0, Along),
+                    FIntPoint(QuadsPerSide, Along),
+                    FIntPoint(Along, QuadsPerSide)
+                };
+
+                const auto bOdd = ((Along / Step) & 1) != 0;
+                for (auto Edge = 0; Edge < 4; Edge++)
+                {
+                    const auto bStitched = bCanStitch && (StitchMask & (1 << Edge)) != 0;
+                    const auto Index = (uint16)(EdgeVertices[Edge].Y * Stride + EdgeVertices[Edge].X);
+                    if (Used.Contains(Index) == (bStitched && bOdd))
+                    {
+                        AddError(FString::Printf(TEXT("%s, edge %d vertex %d is %s"), *Context, Edge, Along, bStitched && bOdd ? TEXT("used") : TEXT("missing")));
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+#endif
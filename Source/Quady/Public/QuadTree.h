@@ -2,12 +2,47 @@
 
 #include "CoreMinimal.h"
 #include "Array.h"
+#include "Async/TaskGraphInterfaces.h"
 #include "QuadTreeNode.h"
+#include "QuadTreeGrid.h"
+#include "QuadTreeViewer.h"
+#include "QuadTreeHeightSource.h"
 
 #include "QuadTree.generated.h"
 
 class UWorld;
-class FQuadTreeViewer;
+class IQuadTreeCore;
+class FQuadTreeOcclusionBuffer;
+class FQuadTreeHeightCache;
+class FQuadTreeHeightAtlas;
+struct FQuadTreeHeightAtlasUpload;
+class UTexture2D;
+class FQuadTreeRelevancy;
+class FQuadTreeClipmap;
+class FQuadTreeLayers;
+class ULineBatchComponent;
+
+UENUM(BlueprintType)
+enum class EQuadTreeDebugView : uint8
+{
+    /* Debug boxes per selected node every Draw */
+    Immediate,
+
+    /* Leaf outlines and ranges, batched and only rebuilt when the selection changes */
+    Outlines,
+
+    /* Heatmaps over the batched outlines */
+    Level,
+
+    /* Height bounds relative to leaf size, how far a leaf is from flat */
+    Error,
+
+    /* Leaves still waiting on their height tile */
+    Streaming,
+
+    /* Leaves that entered the selection recently, where Update spent its work */
+    UpdateCost
+};
 
 UCLASS(BlueprintType)
 class QUADY_API UQuadTree
@@ -16,21 +51,77 @@ class QUADY_API UQuadTree
     GENERATED_BODY()
 
 public:
-    /* NOTE: Not Implemented */
+    /* Stay fixed in world space across world origin shifts, see ApplyWorldOffset */
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree")
     bool bFloatingOrigin;
 
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree")
     int32 MinimumQuadSize;
 
-    /* Must be a multiple of MinimumQuadSize */
+    /* Must be a power of two multiple of MinimumQuadSize */
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree")
     int32 MaximumQuadSize;
 
+    /* Page MaximumQuadSize root tiles in and out around the viewers instead of a single fixed Root, for unbounded worlds */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree")
+    bool bTiled;
+
+    /* Select on a compact TQuadTree instead of FQuadTreeNode objects, picked by level count at Build. Ignored when bTiled.
+       Nodes keep their own height bounds with a height source or occlusion culling, cube bounds otherwise */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree")
+    bool bCompactNodes;
+
+    /* Select rings of tiles that follow the viewer instead of recursing nodes, cheaper on flat open maps.
+       Unbounded like bTiled, ignores bTiled, bCompactNodes, occlusion and shadow views */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree")
+    bool bClipmap;
+
     /* A viewers radius is the MinimumQuadSize, increase this when the viewer is moving quickly */
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree")
     float ViewerRadiusMultiplier;
 
+    /* Fraction of a level's range after which its vertices start morphing toward the parent level */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+    float MorphStartRatio;
+
+    /* Skip refining nodes hidden behind the nearest selected leaves. Needs real height bounds, default bounds are cubes */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Occlusion")
+    bool bOcclusionCulling;
+
+    /* Nearest leaves of the previous selection used as occluders */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Occlusion", meta = (ClampMin = "1", EditCondition = "bOcclusionCulling"))
+    int32 OccluderCount;
+
+    /* Generate heights from NoiseSettings when no height source is set */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Height")
+    bool bProceduralHeights;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Height", meta = (EditCondition = "bProceduralHeights"))
+    FQuadTreeNoiseSettings NoiseSettings;
+
+    /* Quads per side of a height tile, a power of two */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Height", meta = (ClampMin = "2"))
+    int32 HeightTileResolution;
+
+    /* Tiles kept for reuse after their leaves are deselected */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Height", meta = (ClampMin = "0"))
+    int32 MaxCachedHeightTiles;
+
+    /* Keep heights and normals of selected leaves resident in one atlas texture for rendering, needs a height source */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Height")
+    bool bHeightAtlas;
+
+    /* Atlas capacity is the square of this, slots are HeightTileResolution + 1 texels */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Height", meta = (ClampMin = "1", EditCondition = "bHeightAtlas"))
+    int32 HeightAtlasSlotsPerSide;
+
+    /* Z scale of the rendered leaves, packed heights span +-256 times this */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "QuadTree|Height", meta = (ClampMin = "0.01", EditCondition = "bHeightAtlas"))
+    float HeightAtlasZScale;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "QuadTree|Debug")
+    EQuadTreeDebugView DebugView;
+
     UQuadTree();
 
     /* Validate and construct QuadTree */
@@ -41,18 +132,96 @@ public:
     UFUNCTION(BlueprintCallable, Category = "QuadTree")
     virtual void Update();
 
-    /* Draw Quads */
+    /* Radius of the finest level's range, the least a viewer can move to change the selection near it */
+    inline float GetSmallestRange() const { return Viewer->GetRange(0).SphereRadius; }
+
+    /* Scales every level's range, such as for scalability or adaptive LOD. Reselects on the next Update.
+       Clipmap rings are sized on Build and keep their scale until then. Returns true if the ranges changed */
+    bool SetRangeScale(const float InRangeScale);
+    inline float GetRangeScale() const { return RangeScale; }
+
+    /* Estimated bytes of the height tiles the current selection keeps resident */
+    int64 GetRequiredHeightTileMemory() const;
+
+    /* Edits, view changes, atlas uploads or new layers waiting for the next Update, regardless of viewer movement */
+    bool HasPendingWork() const;
+
+    /* Leaves of the current selection with their morph ranges */
+    inline const TArray<FQuadTreeLeaf>& GetSelectedLeaves() const { return SelectedLeaves; }
+
+    /* Changes whenever the selected or shadow leaves are gathered again */
+    inline uint32 GetSelectionRevision() const { return SelectionRevision; }
+
+    /* Cell space of leaves and height tiles */
+    inline const FQuadTreeGrid& GetGrid() const { return Grid; }
+
+    /* Add or replace a light view, such as a shadow cascade, whose coarser cut is selected in the same pass as the main view.
+       Frustum is in world space, LevelBias is clamped below the root level. Reselects on the next Update */
+    void SetShadowView(const int32 Index, const FConvexVolume& WorldFrustum, const int32 LevelBias);
+    void ClearShadowViews();
+
+    inline int32 GetShadowViewCount() const { return ShadowViews.Num(); }
+
+    /* Leaves of a shadow view's cut, morph ranges follow its biased ranges */
+    inline const TArray<FQuadTreeLeaf>& GetShadowLeaves(const int32 Index) const { check(Index < ShadowViews.Num()); return ShadowLeaves[Index]; }
+
+    /* Heights under WorldRect changed. Intersecting height tiles are regenerated, their bounds refit up the ancestors 
+       and only the selection within WorldRect is redone, on the next Update */
+    UFUNCTION(BlueprintCallable, Category = "QuadTree")
+    void MarkDirty(const FBox2D& WorldRect);
+
+    /* Set a node's height bounds directly, for data without a height source. Refits its ancestors and reselects within it */
+    void SetNodeHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds);
+
+    /* Heights for selected leaves are generated on workers from this source. Takes effect on Build */
+    void SetHeightSource(const TSharedPtr<IQuadTreeHeightSource, ESPMode::ThreadSafe>& Source) { HeightSource = Source; }
+
+    /* Nullptr until generated, or if there is no height source */
+    TSharedPtr<const FQuadTreeHeightTile, ESPMode::ThreadSafe> FindHeightTile(const FQuadTreeNodeKey Key) const;
+
+    /* Nullptr until the first tiles are uploaded, or without bHeightAtlas */
+    inline UTexture2D* GetHeightAtlasTexture() const { return HeightAtlasTexture; }
+
+    /* QuadyParameters.HeightmapUVScaleBias of a resident leaf. False if it isn't resident */
+    bool GetHeightAtlasUVScaleBias(const FQuadTreeNodeKey Key, FVector4& OutUVScaleBias) const;
+
+    /* Server side relevancy index on this tree's grid and ranges, actors registered here stay registered across Build */
+    inline FQuadTreeRelevancy& GetRelevancy() const { return *Relevancy; }
+
+    /* Payload layers selected in one walk with the main viewer, layers registered here stay registered across Build */
+    inline FQuadTreeLayers& GetLayers() const { return *PayloadLayers; }
+
+    /* Draw Quads, see DebugView */
     virtual void Draw(const UWorld* World);
 
     UFUNCTION(BlueprintCallable, Category = "QuadTree", meta = (WorldContext = "WorldContextObject"))
     void Draw(UObject* WorldContextObject) { Draw(WorldContextObject->GetWorld()); }
+
+    /* Rebase onto a shifted world origin, O(1) and without reselecting. Does nothing unless bFloatingOrigin */
+    virtual void ApplyWorldOffset(const FVector& InOffset, bool bWorldShift);
+
+    /* Save or restore selection, node height bounds and viewer state. Returns false if a loaded snapshot is invalid */
+    virtual bool SerializeSnapshot(FArchive& Ar);
+
+    UFUNCTION(BlueprintCallable, Category = "QuadTree")
+    bool SaveSnapshot(const FString& Filename);
+
+    /* Restores a previous selection without a cold Update */
+    UFUNCTION(BlueprintCallable, Category = "QuadTree")
+    bool LoadSnapshot(const FString& Filename);
     
 private:
     UPROPERTY(Transient)
     TArray<FBoxSphereBounds> PreviousViewLocations;
 
     uint8 LevelCount;
+    FQuadTreeGrid Grid;
+
+    /* Part of Grid.Origin that centers a single root on the world origin, the rest is rebasing */
+    FIntVector GridCentering;
+
     TSharedPtr<FQuadTreeViewer> Viewer;
+    float RangeScale;
 
 #if WITH_EDITOR
     /* For drawing */
@@ -60,4 +229,117 @@ private:
 #endif
 
     FQuadTreeNode Root;
+    TSharedPtr<IQuadTreeCore> Core;
+    TSharedPtr<FQuadTreeClipmap> Clipmap;
+    TArray<FQuadTreeLeaf> SelectedLeaves;
+    TSharedPtr<FQuadTreeOcclusionBuffer> Occlusion;
+
+    /* World space, moved into the viewers cell space every Update */
+    TArray<FQuadTreeShadowView> ShadowViews;
+    TArray<FQuadTreeLeaf> ShadowLeaves[FQuadTreeShadowView::MaxViews];
+    bool bShadowViewsDirty;
+
+    TSharedPtr<IQuadTreeHeightSource, ESPMode::ThreadSafe> HeightSource;
+    TSharedPtr<FQuadTreeHeightCache, ESPMode::ThreadSafe> HeightCache;
+
+    /* Tiles requested for the current selection, which Trim never drops */
+    int32 RequiredHeightTileCount;
+
+    TSharedPtr<FQuadTreeHeightAtlas> HeightAtlas;
+
+    UPROPERTY(Transient)
+    UTexture2D* HeightAtlasTexture;
+
+    /* Handed to the render thread by UpdateHeightAtlas and reused once copied */
+    TArray<TSharedPtr<FQuadTreeHeightAtlasUpload, ESPMode::ThreadSafe>> HeightAtlasUploads;
+
+    /* Every leaf of this selection revision is resident, nothing to do until it changes */
+    uint32 HeightAtlasRevision;
+    bool bHeightAtlasComplete;
+
+    /* Warned about a full atlas since the last Build */
+    bool bWarnedHeightAtlasFull;
+
+    TSharedPtr<FQuadTreeRelevancy> Relevancy;
+    TSharedPtr<FQuadTreeLayers> PayloadLayers;
+
+    /* Cells, max exclusive, waiting to be reselected */
+    TArray<FIntRect> DirtyRegions;
+
+    /* Bumped whenever SelectedLeaves is gathered */
+    uint32 SelectionRevision;
+
+    /* Batched debug view, persistent until its inputs change */
+    UPROPERTY(Transient)
+    ULineBatchComponent* DebugBatcher;
+
+    struct FDebugDrawState
+    {
+        EQuadTreeDebugView View;
+        uint32 SelectionRevision;
+        uint64 StreamingState;
+        FIntPoint ViewerCell;
+        FIntVector Origin;
+
+        /* Immediate never matches a built batch */
+        FDebugDrawState()
+            : View(EQuadTreeDebugView::Immediate),
+            SelectionRevision(0),
+            StreamingState(0),
+            ViewerCell(FIntPoint::ZeroValue),
+            Origin(FIntVector::ZeroValue) { }
+
+        bool operator==(const FDebugDrawState& Other) const
+        {
+            return View == Other.View && SelectionRevision == Other.SelectionRevision && StreamingState == Other.StreamingState
+                && ViewerCell == Other.ViewerCell && Origin == Other.Origin;
+        }
+    };
+
+    FDebugDrawState DebugDrawState;
+
+    /* UpdateCost view only, selection revision each leaf entered at */
+    TMap<FQuadTreeNodeKey, uint32> DebugLeafRevisions;
+
+    /* Tiled mode only, keyed by tile coordinates */
+    TMap<FIntPoint, TSharedPtr<FQuadTreeNode>> Tiles;
+    TArray<TSharedPtr<FQuadTreeNode>> TilePool;
+
+    inline int32 GetTileSizeInCells() const { return 1 << (LevelCount - 1); }
+
+    /* Per level, doubling from half the minimum quad size, times RangeScale */
+    void GetRanges(TArray<float>& OutRanges) const;
+
+    void ForEachRoot(TFunctionRef<void(FQuadTreeNode&)> Func);
+    void DrawBatched(const UWorld* World);
+    void GatherSelectedLeaves();
+
+    /* Patch the selection with the leaves the clipmap's last Update added and removed */
+    void ApplyClipmapChanges();
+
+    /* Queue height tiles for newly selected leaves */
+    void RequestHeightTiles();
+
+    /* Pack generated tiles of selected leaves into atlas slots, uploaded in one texture update */
+    void UpdateHeightAtlas();
+
+    /* Route to whichever tree holds Key */
+    bool RefitHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds);
+
+    /* Route to whichever tree holds Key, see FQuadTreeNode::ResetDescendantHeightBounds */
+    void ResetDescendantHeightBounds(const FQuadTreeNodeKey Key, const FIntRect& Cells);
+
+    /* Bounds the selection tests Key with, a cube of the node's size where no tree holds it */
+    FFloatInterval GetNodeHeightBounds(const FQuadTreeNodeKey Key) const;
+
+    /* Refit and reselect edits whose tiles are ready. Returns true if anything was reselected */
+    bool UpdateDirtyRegions();
+
+    /* Rasterize occluders from the previous selection on a worker, or inline and return no task */
+    FGraphEventRef BeginOcclusion(const float EyeHeight);
+
+    /* Page in tiles within the top level range of any view, recycle the rest. Returns true if any were paged in */
+    bool UpdateTiles();
+    void AcquireTile(const FIntPoint& TileCoordinates);
+    void ReleaseTile(const FIntPoint& TileCoordinates);
 };
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Interval.h"
+#include "QuadTreeNode.h"
+
+/*
+Alternative to recursive selection for flat, open maps. Each level is a ring of tiles around the
+viewer, snapped to the next level's nodes so rings nest on node boundaries and siblings are always
+selected together. Rings are addressed toroidally, so moving the viewer only rewrites the strips
+that scrolled in and the tiles around the hole left by the finer ring. The leaves are kept as a
+dense list along with the changes made to it, so a selection mirroring it is patched in O(delta).
+*/
+class QUADY_API FQuadTreeClipmap
+{
+public:
+    /* Ranges are the viewer's, in world units. A ring reaches at least its level's range past the viewer's node */
+    void Build(const uint8 LevelCount, const int32 CellSize, const TArray<float>& Ranges);
+
+    /* A change to the leaf list, replayed in order. Removed leaves are swapped with the last one */
+    struct FLeafChange
+    {
+        /* Index removed, INDEX_NONE for a leaf appended with Key */
+        int32 RemovedIndex;
+        FQuadTreeNodeKey Key;
+        FFloatInterval HeightBounds;
+    };
+
+    /* Recenter the rings on the viewer's cell. Returns true if the leaves changed, GetLeafChanges has how */
+    bool Update(const FIntPoint& ViewerCell);
+
+    /* Every level's tiles outside the finer ring's hole, level 0 entirely. In leaf list order */
+    void ForEachLeaf(TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func) const;
+
+    /* Changes made by the last Update, a list matching ForEachLeaf's before it matches it after replaying them */
+    inline const TArray<FLeafChange>& GetLeafChanges() const { return LeafChanges; }
+
+    /* Replay GetLeafChanges on a list that matched ForEachLeaf before the last Update, MakeLeaf builds appended leaves */
+    template<typename LeafType>
+    void ApplyLeafChanges(TArray<LeafType>& OutLeaves, TFunctionRef<LeafType(const FQuadTreeNodeKey, const FFloatInterval&)> MakeLeaf) const
+    {
+        for (auto& Change : LeafChanges)
+        {
+            if (Change.RemovedIndex != INDEX_NONE)
+                OutLeaves.RemoveAtSwap(Change.RemovedIndex, 1, false);
+            else
+                OutLeaves.Add(MakeLeaf(Change.Key, Change.HeightBounds));
+        }
+    }
+
+    /* Position in the leaf list, INDEX_NONE if Key isn't a resident leaf */
+    int32 FindLeaf(const FQuadTreeNodeKey Key) const;
+
+    /* Bounds of a resident leaf until it scrolls out, cube bounds of its level by default. False if Key isn't resident */
+    bool SetHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds);
+
+    /* Tiles in the finer rings' holes within Cells go back to cube bounds. Edits only refit leaves, these would come out of the hole stale */
+    void ResetHoleHeightBounds(const FIntRect& Cells);
+
+    /* Tiles per side */
+    inline int32 GetRingWidth(const uint8 Level) const { return Rings[Level].Width; }
+
+    /* Tiles rewritten by the last Update */
+    inline int32 GetUpdatedTileCount() const { return UpdatedTileCount; }
+
+private:
+    struct FTile
+    {
+        FQuadTreeNodeKey Key;
+        FFloatInterval HeightBounds;
+
+        /* Into Leaves, INDEX_NONE inside the finer ring's hole */
+        int32 LeafIndex;
+
+        FTile() : HeightBounds(0.0f, 0.0f), LeafIndex(INDEX_NONE) { }
+    };
+
+    /* Where a leaf's tile is */
+    struct FLeaf
+    {
+        uint8 Level;
+        int32 TileIndex;
+    };
+
+    struct FRing
+    {
+        /* Even, whole nodes of the next level */
+        int32 Width;
+
+        /* Tile coordinates of the min corner, in this level's tiles */
+        FIntPoint Origin;
+        bool bIsValid;
+
+        /* Width squared, by tile coordinates modulo Width */
+        TArray<FTile> Tiles;
+
+        inline FIntRect GetRect() const { return FIntRect(Origin, Origin + FIntPoint(Width, Width)); }
+        inline int32 GetTileIndex(const FIntPoint& Coordinates) const
+        {
+            const auto X = (Coordinates.X % Width + Width) % Width;
+            const auto Y = (Coordinates.Y % Width + Width) % Width;
+            return Y * Width + X;
+        }
+
+        inline FTile& GetTile(const FIntPoint& Coordinates) { return Tiles[GetTileIndex(Coordinates)]; }
+    };
+
+    int32 CellSize;
+    TArray<FRing> Rings;
+    int32 UpdatedTileCount;
+
+    TArray<FLeaf> Leaves;
+    TArray<FLeafChange> LeafChanges;
+
+    /* Index of the resident tile holding Key in its level's ring, INDEX_NONE if it scrolled out */
+    int32 FindTile(const FQuadTreeNodeKey Key) const;
+
+    /* Area of ring Level - 1 in this level's tiles, empty for level 0 */
+    FIntRect GetHole(const uint8 Level) const;
+
+    void WriteTile(const uint8 Level, const FIntPoint& Coordinates, const FIntRect& Hole);
+
+    /* Adds or removes the tile's leaf, recording the change */
+    void SetLeaf(const uint8 Level, const int32 TileIndex, const bool bIsLeaf);
+};
@@ -5,19 +5,55 @@
 
 #include "QuadTreeComponent.generated.h"
 
+class UQuadTree;
+
+/*
+Owns a QuadTree and updates it when a viewer has moved far enough to matter. Components don't
+tick, a shared scheduler checks them once per frame and spends a global budget on the most
+urgent ones, so idle trees only cost a distance check.
+*/
 UCLASS(ClassGroup=(Quady), meta=(BlueprintSpawnableComponent))
-class QUADY_API UQuadTreeComponent 
+class QUADY_API UQuadTreeComponent
     : public USceneComponent
 {
 	GENERATED_BODY()
 
 public:
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Instanced, Category = "QuadTree", meta = (ShowOnlyInnerProperties))
+    UQuadTree* QuadTree;
+
+    /* Fraction of the smallest range a viewer moves before the tree is updated. 0 updates on any movement */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "QuadTree|Scheduling", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+    float UpdateDistanceRatio;
+
+    /* Draw the QuadTree every frame, see UQuadTree::DebugView */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "QuadTree|Debug")
+    bool bDrawDebug;
+
 	UQuadTreeComponent();
 
+    /* Update on the next scheduler pass regardless of viewer movement, such as after changing the QuadTree */
+    UFUNCTION(BlueprintCallable, Category = "QuadTree")
+    void RequestUpdate() { bUpdateRequested = true; }
+
+    /* How overdue an update is, 1 or more when one is needed. Counts frames spent waiting on the budget */
+    float GetUpdateUrgency() const;
+
+    /* Called by the scheduler */
+    void PerformUpdate();
+    void PerformDraw();
+    inline void Defer() { DeferredFrames++; }
+    void SetRangeScale(const float RangeScale);
+
+    virtual void ApplyWorldOffset(const FVector& InOffset, bool bWorldShift) override;
+
 protected:
-	// Called when the game starts
-	virtual void BeginPlay() override;
+    virtual void OnRegister() override;
+    virtual void OnUnregister() override;
 
-public:	
-	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
-};
\ No newline at end of file
+private:
+    /* View origins at the last update, 2D */
+    TArray<FVector> LastViewLocations;
+    bool bUpdateRequested;
+    int32 DeferredFrames;
+};
@@ -0,0 +1,485 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Interval.h"
+#include "Templates/ChooseClass.h"
+#include "QuadTreeNode.h"
+#include "QuadTreeViewer.h"
+
+/*
+Compact alternative to FQuadTreeNode. A complete tree stored as one flat array,
+each depth in Morton order, so a node's coordinates, level and key all come from
+its index and the node itself is only flags, bounds data and payload.
+*/
+
+/* Type erased so UQuadTree can pick a specialization at Build time */
+class IQuadTreeCore
+{
+public:
+    /* A complete tree of 12 levels is already 5.6M nodes, deeper trees use FQuadTreeNode */
+    static const uint8 MaxLevelCount = 12;
+
+    virtual ~IQuadTreeCore() { }
+
+    virtual void Build(const uint8 LevelCount, const FIntPoint& RootCoordinates, const FFloatInterval& RootHeightBounds) = 0;
+    virtual void Select(const FQuadTreeViewer& Viewer) = 0;
+
+    /* Select only within Cells, see FQuadTreeNode::Reselect */
+    virtual void Reselect(const FQuadTreeViewer& Viewer, const FIntRect& Cells) = 0;
+
+    /* Set a node's bounds and refit its ancestors to their children. False if Key isn't in this tree */
+    virtual bool RefitHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds) = 0;
+
+    /* A node's descendants within Cells go back to unrefit bounds, an edit left them stale. False if Key isn't in this tree */
+    virtual bool ResetDescendantHeightBounds(const FQuadTreeNodeKey Key, const FIntRect& Cells) = 0;
+
+    /* The bounds selection tests a node with. False if Key isn't in this tree */
+    virtual bool GetHeightBounds(const FQuadTreeNodeKey Key, FFloatInterval& OutHeightBounds) const = 0;
+    virtual void ForEachSelectedLeaf(TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func) const = 0;
+    virtual void ForEachShadowLeaf(const int32 View, TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func) const = 0;
+
+    /* Selection and bounds data, returns false if a loaded tree doesn't match. Shadow cuts aren't saved */
+    virtual bool Serialize(FArchive& Ar) = 0;
+
+    virtual int32 GetNodeCount() const = 0;
+    virtual SIZE_T GetAllocatedSize() const = 0;
+};
+
+/* Same cube bounds as FQuadTreeNode, derived from depth alone */
+struct FQuadTreeCubeBoundsPolicy
+{
+    static const uint8 Id = 0;
+
+    struct FData { };
+
+    static FFloatInterval GetHeightBounds(const FData& Data, const FFloatInterval& RootHeightBounds, const uint8 Depth)
+    {
+        const auto HalfHeight = RootHeightBounds.Size() * 0.5f / (float)(1 << Depth);
+        return FFloatInterval(-HalfHeight, HalfHeight);
+    }
+
+    static void SetHeightBounds(FData& Data, const FFloatInterval& RootHeightBounds, const FFloatInterval& HeightBounds) { }
+    static void Include(FData& Data, const FData& Other) { }
+
+    static void Serialize(FArchive& Ar, FData& Data) { }
+};
+
+/* Per node min/max height, quantized to the root's height bounds. Unrefit nodes span the root's */
+struct FQuadTreeHeightBoundsPolicy
+{
+    static const uint8 Id = 1;
+
+    struct FData
+    {
+        uint16 Min;
+        uint16 Max;
+
+        FData() : Min(0), Max(MAX_uint16) { }
+    };
+
+    static FFloatInterval GetHeightBounds(const FData& Data, const FFloatInterval& RootHeightBounds, const uint8 Depth)
+    {
+        const auto Scale = RootHeightBounds.Size() / MAX_uint16;
+        return FFloatInterval(RootHeightBounds.Min + Data.Min * Scale, RootHeightBounds.Min + Data.Max * Scale);
+    }
+
+    /* Rounded outward so the quantized bounds always contain HeightBounds */
+    static void SetHeightBounds(FData& Data, const FFloatInterval& RootHeightBounds, const FFloatInterval& HeightBounds)
+    {
+        const auto InvScale = MAX_uint16 / FMath::Max(RootHeightBounds.Size(), KINDA_SMALL_NUMBER);
+        Data.Min = (uint16)FMath::Clamp(FMath::FloorToInt((HeightBounds.Min - RootHeightBounds.Min) * InvScale), 0, (int32)MAX_uint16);
+        Data.Max = (uint16)FMath::Clamp(FMath::CeilToInt((HeightBounds.Max - RootHeightBounds.Min) * InvScale), 0, (int32)MAX_uint16);
+    }
+
+    static void Include(FData& Data, const FData& Other)
+    {
+        Data.Min = FMath::Min(Data.Min, Other.Min);
+        Data.Max = FMath::Max(Data.Max, Other.Max);
+    }
+
+    static void Serialize(FArchive& Ar, FData& Data) { Ar << Data.Min << Data.Max; }
+};
+
+struct FQuadTreeNoPayload { };
+
+template <uint8 MaxLevels, typename BoundsPolicy = FQuadTreeCubeBoundsPolicy, typename PayloadT = FQuadTreeNoPayload>
+class TQuadTree
+    : public IQuadTreeCore
+{
+    static_assert(MaxLevels > 0 && MaxLevels <= 16, "TQuadTree supports 1 to 16 levels");
+
+public:
+    typedef typename BoundsPolicy::FData FBoundsData;
+
+    /* Narrowest index that can address every node */
+    typedef typename TChooseClass<(MaxLevels <= 8), uint16, uint32>::Result FIndex;
+
+    struct FNode
+    {
+        uint8 bIsSelected : 1;
+
+        /* Hidden in the last selection, the sibling constraint leaves it out */
+        uint8 bIsOccluded : 1;
+        uint8 ShadowMask : FQuadTreeShadowView::MaxViews;
+        FBoundsData Bounds;
+        PayloadT Payload;
+
+        FNode() : bIsSelected(false), bIsOccluded(false), ShadowMask(0) { }
+    };
+
+    /* First node of each depth */
+    static constexpr uint32 GetDepthOffset(const uint8 Depth)
+    {
+        return Depth == 0 ? 0 : GetDepthOffset(Depth - 1) + (1u << (2 * (Depth - 1)));
+    }
+
+    TQuadTree()
+        : LevelCount(0),
+        RootCoordinates(FIntPoint::ZeroValue),
+        RootHeightBounds(0.0f, 0.0f)
+    {
+        static_assert(GetDepthOffset(MaxLevels) - 1 <= TNumericLimits<FIndex>::Max(), "Index type too narrow");
+
+        for (uint8 Depth = 0; Depth <= MaxLevels; Depth++)
+            DepthOffsets[Depth] = GetDepthOffset(Depth);
+    }
+
+    virtual void Build(const uint8 LevelCount, const FIntPoint& RootCoordinates, const FFloatInterval& RootHeightBounds) override
+    {
+        check(LevelCount > 0 && LevelCount <= MaxLevels);
+        check(FQuadTreeNodeKey::IsAligned(RootCoordinates, LevelCount - 1));
+
+        this->LevelCount = LevelCount;
+        this->RootCoordinates = RootCoordinates;
+        this->RootHeightBounds = RootHeightBounds;
+
+        Nodes.Reset();
+        Nodes.AddDefaulted(DepthOffsets[LevelCount]);
+    }
+
+    virtual void Select(const FQuadTreeViewer& Viewer) override
+    {
+        if (Nodes.Num() > 0)
+            SelectNode(Viewer, Viewer.GetShadowViewMask(), 0, 0);
+    }
+
+    virtual void Reselect(const FQuadTreeViewer& Viewer, const FIntRect& Cells) override
+    {
+        if (Nodes.Num() > 0)
+            SelectNode(Viewer, Viewer.GetShadowViewMask(), 0, 0, &Cells);
+    }
+
+    virtual bool RefitHeightBounds(const FQuadTreeNodeKey Key, const FFloatInterval& HeightBounds) override
+    {
+        const auto Index = FindNodeIndex(Key);
+        if (Index == INDEX_NONE)
+            return false;
+
+        auto Depth = (uint8)(LevelCount - 1 - Key.GetLevel());
+        auto Morton = (FIndex)(Index - DepthOffsets[Depth]);
+        BoundsPolicy::SetHeightBounds(GetNode(Depth, Morton).Bounds, RootHeightBounds, HeightBounds);
+
+        /* Parent is Morton / 4 one depth up, O(depth) */
+        while (Depth > 0)
+        {
+            Depth--;
+            Morton = (FIndex)(Morton >> 2);
+
+            const auto FirstChild = (FIndex)(Morton << 2);
+            auto& Parent = GetNode(Depth, Morton);
+            Parent.Bounds = GetNode(Depth + 1, FirstChild).Bounds;
+            for (FIndex Quadrant = 1; Quadrant < 4; Quadrant++)
+                BoundsPolicy::Include(Parent.Bounds, GetNode(Depth + 1, (FIndex)(FirstChild + Quadrant)).Bounds);
+        }
+
+        return true;
+    }
+
+    virtual bool ResetDescendantHeightBounds(const FQuadTreeNodeKey Key, const FIntRect& Cells) override
+    {
+        const auto Index = FindNodeIndex(Key);
+        if (Index == INDEX_NONE)
+            return false;
+
+        const auto Depth = (uint8)(LevelCount - 1 - Key.GetLevel());
+        ResetDescendants(Depth, (FIndex)(Index - DepthOffsets[Depth]), Cells);
+        return true;
+    }
+
+    virtual bool GetHeightBounds(const FQuadTreeNodeKey Key, FFloatInterval& OutHeightBounds) const override
+    {
+        const auto Index = FindNodeIndex(Key);
+        if (Index == INDEX_NONE)
+            return false;
+
+        OutHeightBounds = BoundsPolicy::GetHeightBounds(Nodes[Index].Bounds, RootHeightBounds, (uint8)(LevelCount - 1 - Key.GetLevel()));
+        return true;
+    }
+
+    virtual void ForEachSelectedLeaf(TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func) const override
+    {
+        if (Nodes.Num() > 0)
+            ForEachSelectedLeaf(Func, 0, 0);
+    }
+
+    virtual void ForEachShadowLeaf(const int32 View, TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func) const override
+    {
+        if (Nodes.Num() > 0)
+            ForEachShadowLeaf(View, Func, 0, 0);
+    }
+
+    virtual bool Serialize(FArchive& Ar) override
+    {
+        auto NodeCount = Nodes.Num();
+        auto PolicyId = BoundsPolicy::Id;
+        Ar << NodeCount;
+        Ar << PolicyId;
+
+        if (Ar.IsLoading() && (NodeCount != Nodes.Num() || PolicyId != BoundsPolicy::Id))
+            return false;
+
+        TBitArray<> Selection;
+        if (Ar.IsSaving())
+        {
+            Selection.Reserve(NodeCount);
+            for (auto& Node : Nodes)
+                Selection.Add(Node.bIsSelected);
+        }
+
+        Ar << Selection;
+        if (Selection.Num() != NodeCount)
+            return false;
+
+        for (auto i = 0; i < NodeCount; i++)
+        {
+            Nodes[i].bIsSelected = Selection[i];
+            if (Ar.IsLoading())
+                Nodes[i].ShadowMask = 0;
+            BoundsPolicy::Serialize(Ar, Nodes[i].Bounds);
+        }
+
+        return !Ar.IsError();
+    }
+
+    virtual int32 GetNodeCount() const override { return Nodes.Num(); }
+    virtual SIZE_T GetAllocatedSize() const override { return Nodes.GetAllocatedSize(); }
+
+    FORCEINLINE uint8 GetLevel(const uint8 Depth) const { return LevelCount - 1 - Depth; }
+
+    FORCEINLINE FIntPoint GetCoordinates(const uint8 Depth, const FIndex Morton) const
+    {
+        const auto Size = 1 << GetLevel(Depth);
+        return RootCoordinates + FIntPoint((int32)FMath::ReverseMortonCode2(Morton) * Size, (int32)FMath::ReverseMortonCode2(Morton >> 1) * Size);
+    }
+
+    FORCEINLINE FQuadTreeNodeKey GetKey(const uint8 Depth, const FIndex Morton) const
+    {
+        return FQuadTreeNodeKey(GetCoordinates(Depth, Morton), GetLevel(Depth));
+    }
+
+    /* INDEX_NONE if the key isn't in this tree */
+    int32 FindNodeIndex(const FQuadTreeNodeKey Key) const
+    {
+        const auto Level = Key.GetLevel();
+        if (Level >= LevelCount)
+            return INDEX_NONE;
+
+        const auto Relative = Key.GetCoordinates() - RootCoordinates;
+        const auto Depth = (uint8)(LevelCount - 1 - Level);
+        const auto Extent = 1 << Depth;
+        const auto X = Relative.X >> Level;
+        const auto Y = Relative.Y >> Level;
+        if (Relative.X < 0 || Relative.Y < 0 || X >= Extent || Y >= Extent)
+            return INDEX_NONE;
+
+        return DepthOffsets[Depth] + (FMath::MortonCode2(X) | (FMath::MortonCode2(Y) << 1));
+    }
+
+    FNode* FindNode(const FQuadTreeNodeKey Key)
+    {
+        const auto Index = FindNodeIndex(Key);
+        return Index != INDEX_NONE ? &Nodes[Index] : nullptr;
+    }
+
+private:
+    uint8 LevelCount;
+    FIntPoint RootCoordinates;
+    FFloatInterval RootHeightBounds;
+    TArray<FNode> Nodes;
+
+    /* GetDepthOffset for each depth, sized at compile time */
+    uint32 DepthOffsets[MaxLevels + 1];
+
+    FORCEINLINE FNode& GetNode(const uint8 Depth, const FIndex Morton) { return Nodes[DepthOffsets[Depth] + Morton]; }
+    FORCEINLINE const FNode& GetNode(const uint8 Depth, const FIndex Morton) const { return Nodes[DepthOffsets[Depth] + Morton]; }
+
+    /* Same rules as FQuadTreeNode::Select, returns true if selected. ShadowViews are the views the parent is selected in.
+       With DirtyCells, nodes outside it keep their selection */
+    bool SelectNode(const FQuadTreeViewer& Viewer, const uint8 ShadowViews, const uint8 Depth, const FIndex Morton, const FIntRect* DirtyCells = nullptr)
+    {
+        auto& Node = GetNode(Depth, Morton);
+        const auto Level = GetLevel(Depth);
+
+        if (DirtyCells != nullptr && !Intersects(Depth, Morton, *DirtyCells))
+            return Node.bIsSelected;
+
+        const auto HeightBounds = BoundsPolicy::GetHeightBounds(Node.Bounds, RootHeightBounds, Depth);
+        const auto Bounds = Viewer.GetRelativeBounds(GetCoordinates(Depth, Morton), Level, HeightBounds);
+
+        if (!FBoxSphereBounds::BoxesIntersect(Bounds, Viewer.GetRange(Level).GetSphere()))
+        {
+            Deselect(Depth, Morton);
+            return false;
+        }
+
+        /* Hidden, don't refine. Still casts shadows */
+        if (Viewer.IsOccluded(Bounds))
+        {
+            Deselect(Depth, Morton);
+            Node.bIsOccluded = true;
+            SelectShadows(Viewer, ShadowViews, Depth, Morton);
+            return false;
+        }
+
+        Node.bIsSelected = true;
+        Node.bIsOccluded = false;
+        Node.ShadowMask = Viewer.GetShadowViews(Bounds, Level, ShadowViews);
+        if (Level == 0)
+            return true;
+
+        const auto FirstChild = (FIndex)(Morton << 2);
+        const uint8 NodeShadowMask = Node.ShadowMask;
+        auto bAnyChildSelected = false;
+        uint8 ChildShadowMask = 0;
+        for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            bAnyChildSelected |= SelectNode(Viewer, NodeShadowMask, Depth + 1, (FIndex)(FirstChild + Quadrant), DirtyCells);
+            ChildShadowMask |= GetNode(Depth + 1, (FIndex)(FirstChild + Quadrant)).ShadowMask;
+        }
+
+        /* Constrain, ensures no non-square spaces. Occluded siblings stay out, nothing is seen through them */
+        for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            auto& Child = GetNode(Depth + 1, (FIndex)(FirstChild + Quadrant));
+            Child.bIsSelected |= bAnyChildSelected && !Child.bIsOccluded;
+            Child.ShadowMask |= ChildShadowMask;
+        }
+
+        return true;
+    }
+
+    /* Footprint overlaps Cells, max exclusive */
+    bool Intersects(const uint8 Depth, const FIndex Morton, const FIntRect& Cells) const
+    {
+        const auto Coordinates = GetCoordinates(Depth, Morton);
+        const auto Size = 1 << GetLevel(Depth);
+        return Coordinates.X < Cells.Max.X && Coordinates.X + Size > Cells.Min.X
+            && Coordinates.Y < Cells.Max.Y && Coordinates.Y + Size > Cells.Min.Y;
+    }
+
+    /* Only within Cells, O(edit area) per level */
+    void ResetDescendants(const uint8 Depth, const FIndex Morton, const FIntRect& Cells)
+    {
+        if (GetLevel(Depth) == 0)
+            return;
+
+        const auto FirstChild = (FIndex)(Morton << 2);
+        for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            const auto Child = (FIndex)(FirstChild + Quadrant);
+            if (!Intersects(Depth + 1, Child, Cells))
+                continue;
+
+            GetNode(Depth + 1, Child).Bounds = FBoundsData();
+            ResetDescendants(Depth + 1, Child, Cells);
+        }
+    }
+
+    /* Shadow views only, for subtrees hidden from the main view. Returns the node's mask */
+    uint8 SelectShadows(const FQuadTreeViewer& Viewer, const uint8 ShadowViews, const uint8 Depth, const FIndex Morton)
+    {
+        auto& Node = GetNode(Depth, Morton);
+        const auto Level = GetLevel(Depth);
+        const auto HeightBounds = BoundsPolicy::GetHeightBounds(Node.Bounds, RootHeightBounds, Depth);
+
+        Node.ShadowMask = Viewer.GetShadowViews(Viewer.GetRelativeBounds(GetCoordinates(Depth, Morton), Level, HeightBounds), Level, ShadowViews);
+        if (Node.ShadowMask == 0 || Level == 0)
+            return Node.ShadowMask;
+
+        const auto FirstChild = (FIndex)(Morton << 2);
+        const uint8 NodeShadowMask = Node.ShadowMask;
+        uint8 ChildShadowMask = 0;
+        for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+            ChildShadowMask |= SelectShadows(Viewer, NodeShadowMask, Depth + 1, (FIndex)(FirstChild + Quadrant));
+
+        for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+            GetNode(Depth + 1, (FIndex)(FirstChild + Quadrant)).ShadowMask |= ChildShadowMask;
+
+        return NodeShadowMask;
+    }
+
+    /* Unselected nodes never have selected children, so this stops at the first one. Shadow cuts can continue under occluded nodes */
+    void Deselect(const uint8 Depth, const FIndex Morton)
+    {
+        auto& Node = GetNode(Depth, Morton);
+        Node.bIsOccluded = false;
+        if (!Node.bIsSelected && Node.ShadowMask == 0)
+            return;
+
+        Node.bIsSelected = false;
+        Node.ShadowMask = 0;
+        if (GetLevel(Depth) == 0)
+            return;
+
+        const auto FirstChild = (FIndex)(Morton << 2);
+        for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+            Deselect(Depth + 1, (FIndex)(FirstChild + Quadrant));
+    }
+
+    void ForEachSelectedLeaf(TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func, const uint8 Depth, const FIndex Morton) const
+    {
+        if (!GetNode(Depth, Morton).bIsSelected)
+            return;
+
+        auto bAnyChildSelected = false;
+        if (GetLevel(Depth) > 0)
+        {
+            const auto FirstChild = (FIndex)(Morton << 2);
+            for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+            {
+                if (!GetNode(Depth + 1, (FIndex)(FirstChild + Quadrant)).bIsSelected)
+                    continue;
+
+                bAnyChildSelected = true;
+                ForEachSelectedLeaf(Func, Depth + 1, (FIndex)(FirstChild + Quadrant));
+            }
+        }
+
+        if (!bAnyChildSelected)
+            Func(GetKey(Depth, Morton), BoundsPolicy::GetHeightBounds(GetNode(Depth, Morton).Bounds, RootHeightBounds, Depth));
+    }
+
+    void ForEachShadowLeaf(const int32 View, TFunctionRef<void(const FQuadTreeNodeKey, const FFloatInterval&)> Func, const uint8 Depth, const FIndex Morton) const
+    {
+        const auto Bit = (uint8)(1 << View);
+        if ((GetNode(Depth, Morton).ShadowMask & Bit) == 0)
+            return;
+
+        auto bAnyChildSelected = false;
+        if (GetLevel(Depth) > 0)
+        {
+            const auto FirstChild = (FIndex)(Morton << 2);
+            for (FIndex Quadrant = 0; Quadrant < 4; Quadrant++)
+            {
+                if ((GetNode(Depth + 1, (FIndex)(FirstChild + Quadrant)).ShadowMask & Bit) == 0)
+                    continue;
+
+                bAnyChildSelected = true;
+                ForEachShadowLeaf(View, Func, Depth + 1, (FIndex)(FirstChild + Quadrant));
+            }
+        }
+
+        if (!bAnyChildSelected)
+            Func(GetKey(Depth, Morton), BoundsPolicy::GetHeightBounds(GetNode(Depth, Morton).Bounds, RootHeightBounds, Depth));
+    }
+};
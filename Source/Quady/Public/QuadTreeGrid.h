@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+Integer cell grid the QuadTree is built on. Nodes only store cell coordinates,
+world space is derived from a movable origin so rebasing is O(1) and precision
+doesn't depend on the distance from the world origin.
+*/
+struct FQuadTreeGrid
+{
+public:
+    /* World location of cell (0, 0) */
+    FIntVector Origin;
+
+    /* Size of a cell, the MinimumQuadSize */
+    int32 CellSize;
+
+    FQuadTreeGrid()
+        : Origin(FIntVector::ZeroValue),
+        CellSize(1) { }
+
+    /* Split a world location into its cell and the offset within that cell, exact for any Origin */
+    void ToCell(const FVector& WorldLocation, FIntPoint& OutCell, FVector& OutOffset) const
+    {
+        check(CellSize > 0);
+
+        /* Take whole cells out of the origin first so the float math only sees small values */
+        const auto OriginCell = FIntPoint(FloorDivide(Origin.X, CellSize), FloorDivide(Origin.Y, CellSize));
+        const auto Remainder = FVector(Origin.X - OriginCell.X * CellSize, Origin.Y - OriginCell.Y * CellSize, Origin.Z);
+
+        const auto Local = WorldLocation - Remainder;
+        const auto LocalCell = FIntPoint(FMath::FloorToInt(Local.X / CellSize), FMath::FloorToInt(Local.Y / CellSize));
+
+        OutCell = LocalCell - OriginCell;
+        OutOffset = FVector(Local.X - LocalCell.X * (float)CellSize, Local.Y - LocalCell.Y * (float)CellSize, Local.Z);
+    }
+
+    /* World location of a cell's minimum corner, for drawing only */
+    FVector ToWorld(const FIntPoint& Cell) const
+    {
+        return FVector(Origin) + FVector(Cell.X * (float)CellSize, Cell.Y * (float)CellSize, 0.0f);
+    }
+
+    /* Follow a world origin shift */
+    void Rebase(const FVector& Offset)
+    {
+        Origin += FIntVector(Offset);
+    }
+
+    static int32 FloorDivide(const int32 A, const int32 B)
+    {
+        return A >= 0 ? A / B : -((-A + B - 1) / B);
+    }
+};
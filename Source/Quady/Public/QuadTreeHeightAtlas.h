@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+
+/* A slot's texels within the frame's staging image */
+struct FQuadTreeHeightAtlasRegion
+{
+    int32 SourceY;
+    FIntPoint Destination;
+};
+
+/*
+Fixed grid of tile slots in one texture, with a page table from node key to slot. Slots are
+replaced least recently used first, never while in use this frame, and the frame's new tiles
+are stacked into one staging image so they go up in a single texture update. Only plain data,
+the texture itself belongs to the owner.
+*/
+class QUADY_API FQuadTreeHeightAtlas
+{
+public:
+    /* SlotSize texels per side per slot, one per height sample */
+    FQuadTreeHeightAtlas(const int32 SlotsPerSide, const int32 SlotSize);
+
+    /* Start of a frame, slots acquired after this are in use until the next */
+    void BeginFrame();
+
+    /* Slot holding Key, allocated if it isn't resident. bOutAllocated means its texels must be queued.
+       INDEX_NONE if every slot is already in use this frame */
+    int32 Acquire(const FQuadTreeNodeKey Key, bool& bOutAllocated);
+
+    /* INDEX_NONE if not resident */
+    int32 Find(const FQuadTreeNodeKey Key) const;
+
+    /* Free Key's slot, such as when its heights change */
+    void Invalidate(const FQuadTreeNodeKey Key);
+
+    /* Reserve SlotSize * SlotSize texels for Slot in this frame's staging, once however often it's queued */
+    void QueueUpload(const int32 Slot);
+
+    /* Where to write a queued slot's texels, any thread. Valid until the next QueueUpload or TakeUploads */
+    FColor* GetQueuedTexels(const int32 Slot);
+
+    /* Hand over this frame's staging image, SlotSize wide, and a region per slot. OutStaging's previous
+       image, which must no longer be in use, stages the next frame. False if nothing was queued */
+    bool TakeUploads(TArray<FColor>& OutStaging, TArray<FQuadTreeHeightAtlasRegion>& OutRegions);
+
+    /* Texel size and slot corner, as HeightmapUVScaleBias in QuadyVertexFactory.ush which adds the half texel.
+       One texel per LOD 0 vertex, the atlas has no mips so coarser LODs read every other texel */
+    FVector4 GetUVScaleBias(const int32 Slot) const;
+
+    inline int32 GetTextureSize() const { return SlotsPerSide * SlotSize; }
+    inline int32 GetSlotSize() const { return SlotSize; }
+    inline int32 GetSlotCount() const { return Slots.Num(); }
+    inline int32 Num() const { return PageTable.Num(); }
+
+private:
+    struct FSlot
+    {
+        FQuadTreeNodeKey Key;
+        uint32 LastFrame;
+
+        /* LRU list, head is the most recent */
+        int32 Previous;
+        int32 Next;
+    };
+
+    int32 SlotsPerSide;
+    int32 SlotSize;
+    uint32 Frame;
+
+    TArray<FSlot> Slots;
+    TMap<FQuadTreeNodeKey, int32> PageTable;
+    int32 Head;
+    int32 Tail;
+
+    /* Queued this frame, by slot */
+    TArray<FColor> Staging;
+    TMap<int32, int32> QueuedSlots;
+
+    void Unlink(const int32 Slot);
+    void LinkHead(const int32 Slot);
+    void LinkTail(const int32 Slot);
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+#include "QuadTreeHeightSource.h"
+
+typedef TSharedPtr<const FQuadTreeHeightTile, ESPMode::ThreadSafe> FQuadTreeHeightTilePtr;
+
+/*
+Height tiles by node key, generated on workers from an IQuadTreeHeightSource.
+Keys are deterministic so a tile is generated once however often its node is reselected,
+and a child is generated from its parent's tile when that is still cached.
+*/
+class QUADY_API FQuadTreeHeightCache
+    : public TSharedFromThis<FQuadTreeHeightCache, ESPMode::ThreadSafe>
+{
+public:
+    FQuadTreeHeightCache(const TSharedRef<IQuadTreeHeightSource, ESPMode::ThreadSafe>& Source, const int32 CellSize, const int32 SampleCount);
+
+    /* Game thread. Start of a selection, requests after this count as its uses */
+    void BeginSelection();
+
+    /* Game thread. Queue generation unless cached or already pending */
+    void Request(const FQuadTreeNodeKey Key);
+
+    /* Game thread. Drop a tile whose source data changed, a generation in flight for it is discarded */
+    void Invalidate(const FQuadTreeNodeKey Key);
+
+    /* Any thread, nullptr until generated */
+    FQuadTreeHeightTilePtr Find(const FQuadTreeNodeKey Key) const;
+
+    /* Game thread. Drop the least recently requested tiles over MaxTiles, never those of the current selection */
+    void Trim(const int32 MaxTiles);
+
+    int32 Num() const;
+    int32 GetPendingCount() const;
+
+private:
+    struct FEntry
+    {
+        FQuadTreeHeightTilePtr Tile;
+        uint32 LastSelection;
+    };
+
+    TSharedRef<IQuadTreeHeightSource, ESPMode::ThreadSafe> Source;
+    int32 CellSize;
+    int32 SampleCount;
+    uint32 Selection;
+
+    mutable FCriticalSection Lock;
+    TMap<FQuadTreeNodeKey, FEntry> Tiles;
+    TSet<FQuadTreeNodeKey> Pending;
+    TSet<FQuadTreeNodeKey> Stale;
+
+    void Generate(const FQuadTreeNodeKey Key);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeHeightCache.h"
+
+/* A tile and the cached tiles around it, NWES, any of which may be missing */
+struct FQuadTreeHeightNeighborhood
+{
+    FQuadTreeHeightTilePtr Tile;
+
+    /* Same level */
+    FQuadTreeHeightTilePtr Neighbors[4];
+
+    /* Level + 1 nodes holding each side's border, the parent or a coarser neighbor */
+    FQuadTreeHeightTilePtr Coarse[4];
+};
+
+/*
+Packs a tile into atlas texels with normals from central differences, four samples at a time
+with vector registers. Border samples come from the same level neighbor where cached, else
+from the coarser node around that side, so both sides of a seam difference the same heights.
+Only reads tiles, safe on workers.
+*/
+class QUADY_API FQuadTreeHeightNormals
+{
+public:
+    /* Any thread */
+    static FQuadTreeHeightNeighborhood Gather(const FQuadTreeHeightCache& Cache, const FQuadTreeHeightTilePtr& Tile);
+
+    /* (SampleCount + 2) squared heights, the tile's with one border sample per side. Corners are unused */
+    static void GatherBorder(const FQuadTreeHeightNeighborhood& Neighborhood, float* OutBordered);
+
+    /* Height in RG (16 bit, as DecodePackedHeight) and an 8 bit octahedral normal in BA.
+       Bordered as from GatherBorder, padded by at least 3 floats. HeightScale is world units per local unit */
+    static void PackTexels(const float* Bordered, const int32 SampleCount, const float SampleSpacing, const float HeightScale, FColor* OutTexels);
+
+    /* GatherBorder and PackTexels through the mem stack */
+    static void PackTexels(const FQuadTreeHeightNeighborhood& Neighborhood, const float HeightScale, FColor* OutTexels);
+
+    /* Upper hemisphere only, as heightfield normals are. Matches DecodeOctahedralNormal in QuadyVertexFactory.ush */
+    static FVector2D EncodeOctahedral(const FVector& Normal);
+    static FVector DecodeOctahedral(const FVector2D& Encoded);
+};
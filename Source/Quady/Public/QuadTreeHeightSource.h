@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Interval.h"
+#include "QuadTreeNode.h"
+
+#include "QuadTreeHeightSource.generated.h"
+
+/* Heights of a node on a regular grid of samples, edges are shared with neighbors */
+struct QUADY_API FQuadTreeHeightTile
+{
+public:
+    FQuadTreeNodeKey Key;
+    int32 CellSize;
+
+    /* Per side, an odd number so a child's samples include every other of its parent's */
+    int32 SampleCount;
+
+    /* Row major, relative to the grid origin */
+    TArray<float> Heights;
+    FFloatInterval HeightBounds;
+
+    /* Source specific, how much detail Heights holds so a child can continue from it */
+    int32 Detail;
+
+    FQuadTreeHeightTile(const FQuadTreeNodeKey Key, const int32 CellSize, const int32 SampleCount)
+        : Key(Key),
+        CellSize(CellSize),
+        SampleCount(SampleCount),
+        HeightBounds(0.0f, 0.0f),
+        Detail(0) { }
+
+    /* World distance between samples, relative to the grid */
+    inline float GetSampleSpacing() const { return (float)(CellSize << Key.GetLevel()) / (SampleCount - 1); }
+
+    void UpdateHeightBounds();
+};
+
+/* Where node heights come from. Generate is called on workers and must be thread safe */
+class QUADY_API IQuadTreeHeightSource
+{
+public:
+    virtual ~IQuadTreeHeightSource() { }
+
+    /* Fill InOutTile's heights. Parent is the tile of the node's parent if it is already cached */
+    virtual void Generate(const FQuadTreeHeightTile* Parent, FQuadTreeHeightTile& InOutTile) const = 0;
+};
+
+USTRUCT(BlueprintType)
+struct QUADY_API FQuadTreeNoiseSettings
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise")
+    int32 Seed;
+
+    /* Upper limit, each level only sums octaves its sample spacing can resolve */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", meta = (ClampMin = "1", ClampMax = "24"))
+    int32 Octaves;
+
+    /* Of the first octave, per world unit */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise")
+    float Frequency;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise")
+    float Amplitude;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", meta = (ClampMin = "1.0"))
+    float Lacunarity;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+    float Gain;
+
+    /* Sharp crests instead of rolling hills */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise")
+    bool bRidged;
+
+    FQuadTreeNoiseSettings()
+        : Seed(1337),
+        Octaves(12),
+        Frequency(1.0f / 200000.0f),
+        Amplitude(25600.0f),
+        Lacunarity(2.0f),
+        Gain(0.5f),
+        bRidged(false) { }
+};
+
+/*
+fBm or ridged value noise, evaluated four samples at a time with vector registers.
+A child tile starts the samples it shares with its parent from the parent's heights and
+only adds the octaves the parent couldn't resolve, in the same order as a direct evaluation.
+Samples sit on a global integer lattice, so those heights are bit identical to evaluating
+them directly, and so are the edges neighbors share.
+*/
+class QUADY_API FQuadTreeProceduralHeightSource
+    : public IQuadTreeHeightSource
+{
+public:
+    explicit FQuadTreeProceduralHeightSource(const FQuadTreeNoiseSettings& Settings);
+
+    virtual void Generate(const FQuadTreeHeightTile* Parent, FQuadTreeHeightTile& InOutTile) const override;
+
+    /* Octaves below the sampling limit at this spacing, at least one */
+    int32 GetOctaveCount(const float SampleSpacing) const;
+
+private:
+    FQuadTreeNoiseSettings Settings;
+
+    /* Per octave */
+    TArray<double> Frequencies;
+    TArray<float> Amplitudes;
+    TArray<FIntPoint> LatticeOffsets;
+
+    /* Count is a multiple of 4, SampleX and SampleY are sample indices within the tile */
+    void EvaluateOctaves(const FQuadTreeHeightTile& Tile, const int32* SampleX, const int32* SampleY, float* InOutHeights, const int32 Count, const int32 FirstOctave, const int32 LastOctave) const;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+
+struct FQuadTreeGrid;
+
+/* Game thread, a node entered or left a layer's cut */
+typedef TFunction<void(const FQuadTreeNodeKey)> FQuadTreeLayerCallback;
+
+/* Height bounds the selection tests a node with */
+typedef TFunctionRef<FFloatInterval(const FQuadTreeNodeKey)> FQuadTreeLayerHeightBounds;
+
+struct FQuadTreeLayerDesc
+{
+public:
+    /* Scales every level's range, below 1 keeps the layer's detail closer to the viewer */
+    float RangeMultiplier;
+
+    /* Coarsest level with payloads, nodes above it are only traversed */
+    uint8 MaxLevel;
+
+    FQuadTreeLayerCallback OnLoad;
+    FQuadTreeLayerCallback OnUnload;
+
+    FQuadTreeLayerDesc()
+        : RangeMultiplier(1.0f),
+        MaxLevel(MAX_uint8) { }
+};
+
+/*
+Payload layers over one QuadTree, such as water, decals or navigation tiles. Every layer's cut
+follows the selection's range rule with its own ranges, and all of them are selected in a single
+walk that carries a mask of the layers still refining, without node storage. Nodes are tested
+with the selection's own bounds and range test, so a layer at range multiplier 1 matches its cut.
+Only the leaves that entered or left each cut are loaded or unloaded.
+*/
+class QUADY_API FQuadTreeLayers
+{
+public:
+    static const int32 MaxLayers = 32;
+
+    /* Grid is the owning QuadTree's, so origin shifts are followed */
+    explicit FQuadTreeLayers(const FQuadTreeGrid& Grid);
+
+    /* Ranges per level as built by the QuadTree. RootCoordinates is the single root, or nullptr when unbounded.
+       Every layer is unloaded and reselected on the next Update */
+    void Configure(const uint8 LevelCount, const TArray<float>& Ranges, const FIntPoint* RootCoordinates);
+
+    /* Same levels with new ranges, such as a changed LOD bias. Loaded nodes stay until the next Update's delta */
+    void SetRanges(const TArray<float>& Ranges);
+
+    /* Selected on the next Update. INDEX_NONE if MaxLayers are in use */
+    int32 AddLayer(const FQuadTreeLayerDesc& Desc);
+
+    /* Unloads the layer's nodes right away */
+    void RemoveLayer(const int32 Layer);
+
+    /* One walk for every layer, unloads then loads each layer's delta. Cell and CellOffset as the viewer's */
+    void Update(const FIntPoint& Cell, const FVector& CellOffset, FQuadTreeLayerHeightBounds GetHeightBounds);
+
+    /* Reselects every layer on the next Update even if the viewer hasn't moved */
+    inline void Invalidate() { bDirty = ValidMask != 0; }
+
+    /* A layer was added, the ranges changed or Invalidate was called since the last Update */
+    inline bool IsDirty() const { return bDirty; }
+
+    inline bool IsLoaded(const int32 Layer, const FQuadTreeNodeKey Key) const { return Layers[Layer].Loaded.Contains(Key); }
+    inline int32 GetLoadedCount(const int32 Layer) const { return Layers[Layer].Loaded.Num(); }
+
+private:
+    struct FLayer
+    {
+        FQuadTreeLayerDesc Desc;
+        TArray<float> Ranges;
+        TSet<FQuadTreeNodeKey> Loaded;
+
+        /* Built by the walk and swapped with Loaded, both keep their allocations between updates */
+        TSet<FQuadTreeNodeKey> Cut;
+        bool bIsValid;
+
+        FLayer() : bIsValid(false) { }
+    };
+
+    const FQuadTreeGrid& Grid;
+    uint8 LevelCount;
+    TArray<float> Ranges;
+    bool bHasRoot;
+    FIntPoint RootCoordinates;
+
+    TArray<FLayer> Layers;
+    uint32 ValidMask;
+    bool bDirty;
+
+    void ApplyRanges(FLayer& Layer) const;
+    void Unload(FLayer& Layer);
+
+    /* Mask is the layers Coordinates is selected for */
+    void SelectNode(const FIntPoint& Cell, const FVector& CellOffset, FQuadTreeLayerHeightBounds GetHeightBounds, const FIntPoint& Coordinates, const uint8 Level, const uint32 Mask);
+
+    /* Layers in Mask whose range at Level reaches the node, FQuadTreeNode::IsInRange per layer */
+    uint32 GetInRangeMask(const FIntPoint& Cell, const FVector& CellOffset, FQuadTreeLayerHeightBounds GetHeightBounds, const FIntPoint& Coordinates, const uint8 Level, const uint32 Mask) const;
+
+    void AddLeaf(const FIntPoint& Coordinates, const uint8 Level, uint32 Mask);
+};
@@ -2,10 +2,12 @@
 
 #include "CoreMinimal.h"
 #include "Array.h"
+#include "Math/Interval.h"
+#include "Misc/MemStack.h"
 
 class FQuadTreeViewer;
+struct FQuadTreeGrid;
 
-// TODO: Deterministic key for nodes
 // TODO: Return added and removed nodes on Update
 
 enum class EQuadrant : uint8
@@ -17,33 +19,51 @@ enum class EQuadrant : uint8
     None = 4 // Root
 };
 
-struct FQuadTreeNodeKey;
-
+/* Deterministic, derived from the node's grid coordinates and level only */
 struct FQuadTreeNodeKey
 {
 public:
     FQuadTreeNodeKey() : Key(0) { }
 
-    /* Root */
-    FQuadTreeNodeKey(const FVector& BottomLeft, const uint8 Level)
+    /* Coordinates is the node's bottom left cell */
+    FQuadTreeNodeKey(const FIntPoint& Coordinates, const uint8 Level)
     {
-        Key = GetTypeHash(BottomLeft) << 16 | (uint32)EQuadrant::None << 8 | (uint32)Level;
-    }
+        check(Level <= LevelMask);
 
-    FQuadTreeNodeKey(const FQuadTreeNodeKey& Parent, const FVector& BottomLeft, const EQuadrant Quadrant, const uint8 Level)
-    {
-        Key = Parent.GetKey() | GetTypeHash(BottomLeft) << 16 | (uint32)Quadrant << 8 | (uint32)Level;
+        const auto X = (uint64)(Coordinates.X >> Level) & CoordinateMask;
+        const auto Y = (uint64)(Coordinates.Y >> Level) & CoordinateMask;
+        Key = Y << 36 | X << 8 | ValidFlag | (uint64)Level;
     }
 
-    inline const uint32 GetKey() const { return Key; }
+    /* Only a node on a multiple of its own size round trips, the key holds Coordinates >> Level */
+    static inline bool IsAligned(const FIntPoint& Coordinates, const uint8 Level) { return ((Coordinates.X | Coordinates.Y) & ((1 << Level) - 1)) == 0; }
+
+    inline const uint64 GetKey() const { return Key; }
     inline const bool IsValid() const { return Key > 0; }
+
+    inline const uint8 GetLevel() const { return (uint8)(Key & LevelMask); }
+    inline const FIntPoint GetCoordinates() const
+    {
+        const auto Size = 1 << GetLevel();
+        return FIntPoint(SignExtend((Key >> 8) & CoordinateMask) * Size, SignExtend((Key >> 36) & CoordinateMask) * Size);
+    }
     
     bool operator==(const FQuadTreeNodeKey& Other) const { return Key == Other.Key; }
     bool operator!=(const FQuadTreeNodeKey& Other) const { return !operator==(Other); }
-    friend uint32 GetTypeHash(const FQuadTreeNodeKey& Key) { return Key.GetKey(); }
+    friend uint32 GetTypeHash(const FQuadTreeNodeKey& Key) { return GetTypeHash(Key.GetKey()); }
+
+    friend FArchive& operator<<(FArchive& Ar, FQuadTreeNodeKey& Key) { return Ar << Key.Key; }
 
 private:
-    uint32 Key;
+    static const uint64 LevelMask = 0x3F;
+    static const uint64 ValidFlag = 0x80;
+    static const uint64 CoordinateMask = 0xFFFFFFF;
+    static const uint64 CoordinateSignBit = 0x8000000;
+
+    /* 28 bit two's complement to int32 by arithmetic, shifting a negative value left is undefined */
+    static inline int32 SignExtend(const uint64 Index) { return (int32)Index - (int32)((Index & CoordinateSignBit) << 1); }
+
+    uint64 Key;
 };
 
 /* Flags */
@@ -54,7 +74,8 @@ enum class EQuadTreeNodeSelectionEventType : uint8
     OutOfRange = 2,
     InFrustum = 4,
     OutOfFrustum = 8,
-    DueToParent = 16
+    DueToParent = 16,
+    Occluded = 32
 };
 ENUM_CLASS_FLAGS(EQuadTreeNodeSelectionEventType);
 
@@ -73,28 +94,107 @@ public:
     bool operator==(const FQuadTreeNodeSelectionEvent& Other) const { return Key == Other.Key; }
     bool operator!=(const FQuadTreeNodeSelectionEvent& Other) const { return !operator==(Other); }
 
-    friend uint32 GetTypeHash(const FQuadTreeNodeSelectionEvent& Event) { return Event.Key.GetKey(); }
+    friend uint32 GetTypeHash(const FQuadTreeNodeSelectionEvent& Event) { return GetTypeHash(Event.Key); }
+};
+
+/* Each node is visited once per Select so events are unique, backed by the frame's FMemStack */
+typedef TArray<FQuadTreeNodeSelectionEvent, TMemStackAllocator<>> FQuadTreeNodeSelectionEvents;
+
+/* A selected node with no selected children, what gets drawn */
+struct FQuadTreeLeaf
+{
+public:
+    FQuadTreeNodeKey Key;
+    FIntPoint Coordinates;
+    FFloatInterval HeightBounds;
+    uint8 Level;
+
+    /* Viewer distances where vertices start morphing toward the parent level, and where they fully match it */
+    float MorphStart;
+    float MorphEnd;
+
+    FQuadTreeLeaf(const FQuadTreeNodeKey Key, const FIntPoint& Coordinates, const FFloatInterval& HeightBounds, const uint8 Level, const FVector2D& MorphRange)
+        : Key(Key),
+        Coordinates(Coordinates),
+        HeightBounds(HeightBounds),
+        Level(Level),
+        MorphStart(MorphRange.X),
+        MorphEnd(MorphRange.Y) { }
+
+    /* Packed for QuadyVertexFactory.ush MorphParams, Morph = saturate(Distance * z - w)
+       x = start, y = end, z = 1 / (end - start), w = start / (end - start) */
+    FVector4 GetMorphParameters() const
+    {
+        const auto InvMorphLength = 1.0f / FMath::Max(MorphEnd - MorphStart, KINDA_SMALL_NUMBER);
+        return FVector4(MorphStart, MorphEnd, InvMorphLength, MorphStart * InvMorphLength);
+    }
 };
 
 struct FQuadTreeNode
 {
 public:
     FQuadTreeNode() = default;
-    FQuadTreeNode(const FQuadTreeNode* Parent, EQuadrant Quadrant, const FBox& Bounds, const uint8 Level);
+    FQuadTreeNode(EQuadrant Quadrant, const FIntPoint& Coordinates, const uint8 Level, const FFloatInterval& HeightBounds);
 
     virtual ~FQuadTreeNode();
 
-    /* Returns true if was split, used for constraints */
+    /* Returns true if was split, used for constraints. Selects the viewers shadow views in the same pass */
     bool Select(const TSharedPtr<FQuadTreeViewer>& Viewer);
-    bool Select(const TSharedPtr<FQuadTreeViewer>& Viewer, TSet<FQuadTreeNodeSelectionEvent>& SelectionEvents);
+    bool Select(const TSharedPtr<FQuadTreeViewer>& Viewer, FQuadTreeNodeSelectionEvents& SelectionEvents);
+
+    /* Select only within Cells, outside of it the current selection is kept. For edits, see UQuadTree::MarkDirty */
+    bool Reselect(const TSharedPtr<FQuadTreeViewer>& Viewer, const FIntRect& Cells);
 
     inline const bool IsSelected() const { return bIsSelected; }
-    const bool IsInSphere(const FSphere& Sphere);
+    void SetSelected(const bool bIsSelected, const bool bRecursive = false);
+
+    /* Selected, with no selected children */
+    const bool IsSelectedLeaf() const;
+
+    /* Bit per shadow view this node is selected in, see FQuadTreeViewer::SetShadowViews */
+    inline const uint8 GetShadowMask() const { return ShadowMask; }
+    inline void ClearShadowMask() { ShadowMask = 0; }
+
+    const bool IsInRange(const TSharedPtr<FQuadTreeViewer>& Viewer) const;
+    const bool IsOccluded(const TSharedPtr<FQuadTreeViewer>& Viewer) const;
     const bool IsInFrustum(); // TODO
 
-    virtual void Draw(const UWorld* World);
+    virtual void Draw(const UWorld* World, const FQuadTreeGrid& Grid);
 
     inline const FQuadTreeNodeKey GetKey() const { return Key; }
+    inline const uint8 GetLevel() const { return Level; }
+
+    /* Bottom left cell */
+    inline const FIntPoint& GetCoordinates() const { return Coordinates; }
+    inline const int32 GetSizeInCells() const { return 1 << Level; }
+
+    /* Vertical extent of the node relative to the grid origin, defaults to a cube */
+    inline const FFloatInterval& GetHeightBounds() const { return HeightBounds; }
+    void SetHeightBounds(const FFloatInterval& HeightBounds);
+
+    /* Set the bounds of a descendant and refit every node on the way to it to its children. False if Key isn't in this subtree */
+    bool RefitHeightBounds(const FQuadTreeNodeKey NodeKey, const FFloatInterval& NodeHeightBounds);
+
+    /* Descendants of a node within Cells go back to the cube of their size, an edit left their bounds stale. False if Key isn't in this subtree */
+    bool ResetDescendantHeightBounds(const FQuadTreeNodeKey NodeKey, const FIntRect& Cells, const float CellSize);
+
+    /* Bounds of a descendant, O(depth). False if Key isn't in this subtree */
+    bool FindHeightBounds(const FQuadTreeNodeKey NodeKey, FFloatInterval& OutHeightBounds) const;
+
+    /* Footprint overlaps Cells, max exclusive */
+    const bool Intersects(const FIntRect& Cells) const;
+
+    /* Move this subtree to new coordinates and clear its selection, for recycling roots */
+    void Reset(const FIntPoint& Coordinates, const FFloatInterval& HeightBounds);
+
+    /* Depth first, parents before children. Order is stable for a given Build */
+    void ForEachNode(TFunctionRef<void(FQuadTreeNode&)> Func);
+
+    /* Skips unselected subtrees */
+    void ForEachSelectedLeaf(TFunctionRef<void(const FQuadTreeNode&)> Func) const;
+
+    /* Leaves of a shadow view's cut */
+    void ForEachShadowLeaf(const int32 View, TFunctionRef<void(const FQuadTreeNode&)> Func) const;
 
     bool operator==(const FQuadTreeNode& Other) const { return Key == Other.Key; }
     bool operator!=(const FQuadTreeNode& Other) const { return !operator==(Other); }
@@ -104,15 +204,30 @@ public:
 private:
     FQuadTreeNodeKey Key;
     EQuadrant Quadrant;
-    FBox Bounds;
+    FIntPoint Coordinates;
+    FFloatInterval HeightBounds;
     uint8 Level;
     bool bIsSelected;
+
+    /* Hidden in the last selection, the sibling constraint leaves it out */
+    bool bIsOccluded;
+    uint8 ShadowMask;
     TMap<EQuadrant, TSharedPtr<FQuadTreeNode>> Children;
 
+    /* ShadowViews are the views the parent is selected in. With DirtyCells, nodes outside it are skipped and nodes inside are retested */
+    bool Select(const TSharedPtr<FQuadTreeViewer>& Viewer, const uint8 ShadowViews, const FIntRect* DirtyCells = nullptr);
+
+    /* Shadow views only, for subtrees hidden from the main view. Returns this node's mask */
+    uint8 SelectShadows(const TSharedPtr<FQuadTreeViewer>& Viewer, const uint8 ShadowViews);
+
     bool Split();
     void Empty();
+
+    /* Offset of a child's bottom left cell from its parent's */
+    static FIntPoint GetQuadrantOffset(const EQuadrant Quadrant, const int32 HalfSize);
+    FFloatInterval GetChildHeightBounds() const;
     
-    void SetSelected(const bool bIsSelected, const bool bRecursive = false);
-    inline void ForEachChild(TFunction<void(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func);
-    inline bool AnyChild(TFunction<bool(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func, bool bTerminateOnFirst = true);
+    /* TFunctionRef, these run for every visited node and must not allocate */
+    inline void ForEachChild(TFunctionRef<void(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func);
+    inline bool AnyChild(TFunctionRef<bool(EQuadrant, TSharedPtr<FQuadTreeNode>&)> Func, bool bTerminateOnFirst = true);
 };
\ No newline at end of file
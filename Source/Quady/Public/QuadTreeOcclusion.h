@@ -0,0 +1,39 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+Selection time occlusion. Terrain is a heightfield seen from within, so a per azimuth
+maximum elevation around the viewer (a horizon) stands in for a depth buffer: anything
+whose highest point is below the horizon in every direction it spans is hidden.
+All bounds are relative to the viewers cell, see FQuadTreeViewer::GetRelativeBounds.
+*/
+class QUADY_API FQuadTreeOcclusionBuffer
+{
+public:
+    /* Resolution is the number of azimuth bins, a power of two and at least 4 */
+    explicit FQuadTreeOcclusionBuffer(const int32 Resolution = 256);
+
+    void Reset(const FVector& EyeLocation);
+
+    /* Terrain under a leaf is solid up to at least its minimum height */
+    void AddOccluder(const FBox& RelativeBounds);
+
+    /* True if hidden in every direction it spans by strictly nearer occluders */
+    bool IsOccluded(const FBox& RelativeBounds) const;
+
+    inline int32 GetOccluderCount() const { return OccluderCount; }
+
+private:
+    int32 Resolution;
+    FVector EyeLocation;
+    float MaxOccluderDistance;
+    int32 OccluderCount;
+
+    /* Highest elevation slope per azimuth bin */
+    TArray<float, TAlignedHeapAllocator<16>> Horizon;
+
+    /* Bins overlapping the footprint (First to Last inclusive, may wrap) and fully inside it.
+       False if the eye is inside the footprint */
+    bool GetBins(const FBox& RelativeBounds, int32& OutFirstOverlap, int32& OutLastOverlap, int32& OutFirstInside, int32& OutLastInside, float& OutMinDistance, float& OutMaxDistance) const;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtr.h"
+#include "QuadTreeNode.h"
+
+class AActor;
+struct FQuadTreeGrid;
+
+struct FQuadTreeRelevantActor
+{
+public:
+    AActor* Actor;
+
+    /* 1 for actors in the finest leaves, falling toward 0 with the leaf's level */
+    float Priority;
+    uint8 Level;
+
+    FQuadTreeRelevantActor(AActor* Actor, const float Priority, const uint8 Level)
+        : Actor(Actor),
+        Priority(Priority),
+        Level(Level) { }
+};
+
+/*
+Server side spatial relevancy. Actors are bucketed by node key at every level, so a
+client's relevant set is one bucket lookup per leaf of its cut, and its replication
+priority is the leaf's level. Cuts follow the same range rule as selection, evaluated
+without node storage, but only keep nodes their parent's range reaches, so distant
+actors aren't relevant. They are only redone when a client changes cell.
+*/
+class QUADY_API FQuadTreeRelevancy
+{
+public:
+    /* Grid is the owning QuadTree's, so origin shifts are followed */
+    explicit FQuadTreeRelevancy(const FQuadTreeGrid& Grid);
+
+    /* Ranges per level as built by the QuadTree. RootCoordinates is the single root, or nullptr when tiled */
+    void Configure(const uint8 LevelCount, const TArray<float>& Ranges, const FIntPoint* RootCoordinates);
+
+    /* Same levels with new ranges, such as a changed LOD bias. Buckets don't depend on ranges, only client cuts are redone */
+    void SetRanges(const TArray<float>& Ranges);
+
+    /* O(levels) */
+    void Register(AActor* Actor);
+    void Unregister(AActor* Actor);
+
+    /* Call when an actor moves, only rebuckets if it changed cell */
+    void Update(AActor* Actor);
+
+    /* Appends the actors relevant to Client from ViewLocation, in no particular order */
+    void GetRelevantActors(const UObject* Client, const FVector& ViewLocation, TArray<FQuadTreeRelevantActor>& OutActors);
+    void RemoveClient(const UObject* Client);
+
+    inline int32 GetActorCount() const { return ActorCells.Num(); }
+
+private:
+    /* Coordinates rather than a key, an unaligned root's key would decode to another node */
+    struct FCutLeaf
+    {
+        FIntPoint Coordinates;
+        uint8 Level;
+    };
+
+    struct FClientCut
+    {
+        FIntPoint Cell;
+        TArray<FCutLeaf> Leaves;
+    };
+
+    const FQuadTreeGrid& Grid;
+    uint8 LevelCount;
+    TArray<float> Ranges;
+    bool bHasRoot;
+    FIntPoint RootCoordinates;
+
+    /* Per level */
+    TArray<TMap<FQuadTreeNodeKey, TArray<TWeakObjectPtr<AActor>>>> Buckets;
+    TMap<TWeakObjectPtr<AActor>, FIntPoint> ActorCells;
+    TMap<const UObject*, FClientCut> Clients;
+
+    void AddToBuckets(AActor* Actor, const FIntPoint& Cell);
+    void RemoveFromBuckets(AActor* Actor, const FIntPoint& Cell);
+
+    void SelectCut(const FIntPoint& Cell, const FVector& CellOffset, TArray<FCutLeaf>& OutLeaves) const;
+    void SelectNode(const FIntPoint& Cell, const FVector& CellOffset, const FIntPoint& Coordinates, const uint8 Level, TArray<FCutLeaf>& OutLeaves) const;
+    bool IsInRange(const FIntPoint& Cell, const FVector& CellOffset, const FIntPoint& Coordinates, const uint8 Level) const;
+    bool IsInRange(const FIntPoint& Cell, const FVector& CellOffset, const FIntPoint& Coordinates, const uint8 Level, const float Range) const;
+
+    void GatherBucket(const FIntPoint& Coordinates, const uint8 Level, const float Priority, const uint8 LeafLevel, TArray<FQuadTreeRelevantActor>& OutActors) const;
+};
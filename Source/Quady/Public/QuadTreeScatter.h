@@ -0,0 +1,133 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "QuadTreeNode.h"
+#include "QuadTreeHeightCache.h"
+
+#include "QuadTreeScatter.generated.h"
+
+class UStaticMesh;
+
+/* One kind of scattered instance, such as a grass or rock mesh */
+USTRUCT(BlueprintType)
+struct QUADY_API FQuadTreeScatterLayer
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter")
+    UStaticMesh* Mesh;
+
+    /* Instances per 10 m square on level 0 leaves */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter", meta = (ClampMin = "0.0"))
+    float Density;
+
+    /* Density multiplier per level, 0.25 keeps the count per leaf constant */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+    float LevelFalloff;
+
+    /* Coarser leaves get none */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter", meta = (ClampMin = "0"))
+    int32 MaxLevel;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter", meta = (ClampMin = "0"))
+    int32 MaxInstancesPerLeaf;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter", meta = (ClampMin = "0.0"))
+    float MinScale;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter", meta = (ClampMin = "0.0"))
+    float MaxScale;
+
+    /* Tilt instances to the terrain instead of keeping them upright */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter")
+    bool bAlignToSurface;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter")
+    int32 Seed;
+
+    FQuadTreeScatterLayer()
+        : Mesh(nullptr),
+        Density(4.0f),
+        LevelFalloff(0.5f),
+        MaxLevel(2),
+        MaxInstancesPerLeaf(1024),
+        MinScale(0.8f),
+        MaxScale(1.2f),
+        bAlignToSurface(false),
+        Seed(0) { }
+};
+
+/* An instance slot to set, grid relative. Freed slots are written with a zero scale */
+struct FQuadTreeScatterWrite
+{
+    int32 Layer;
+    int32 Slot;
+    FTransform Transform;
+};
+
+/*
+Instances scattered over selected leaves, generated on workers from each leaf's key and height
+tile so a leaf always gets the same instances. Only leaves entering the selection are generated,
+and each layer's instance slots are pooled: a deselected leaf's slots are hidden and handed to the
+next leaf, so the instance count is bounded by the largest selection and writes by the delta.
+*/
+class QUADY_API FQuadTreeScatter
+{
+public:
+    explicit FQuadTreeScatter(const TArray<FQuadTreeScatterLayer>& Layers);
+
+    /* Game thread. Applied on the next Update */
+    void SetSelection(const TArray<FQuadTreeLeaf>& Leaves);
+
+    /* Game thread. Release deselected leaves, start new ones whose tile is ready and collect finished ones, appending their slot writes */
+    void Update(TFunctionRef<FQuadTreeHeightTilePtr(const FQuadTreeNodeKey)> FindTile, TArray<FQuadTreeScatterWrite>& OutWrites);
+
+    /* Slots in use or pooled, the instance count each layer needs */
+    inline int32 GetSlotCount(const int32 Layer) const { return Layers[Layer].SlotCount; }
+
+    inline int32 GetLeafCount() const { return Leaves.Num(); }
+
+    /* Any thread, deterministic for a layer, tile and seed. Grid relative */
+    static void Generate(const FQuadTreeScatterLayer& Layer, const int32 LayerIndex, const FQuadTreeHeightTile& Tile, TArray<FTransform>& OutInstances);
+
+private:
+    struct FLeaf
+    {
+        FQuadTreeNodeKey Key;
+
+        /* Waiting for its tile while neither is set */
+        TFuture<void> Task;
+        bool bIsWritten;
+
+        /* Per layer, instances until written, then the slots they were written to */
+        TArray<TArray<FTransform>> Instances;
+        TArray<TArray<int32>> Slots;
+    };
+
+    struct FLayer
+    {
+        FQuadTreeScatterLayer Settings;
+        int32 SlotCount;
+        TArray<int32> FreeSlots;
+    };
+
+    TArray<FLayer> Layers;
+    int32 MaxLevel;
+
+    TSet<FQuadTreeNodeKey> Selection;
+    bool bSelectionChanged;
+
+    /* Leaves of the applied selection */
+    TMap<FQuadTreeNodeKey, TSharedPtr<FLeaf, ESPMode::ThreadSafe>> Leaves;
+
+    /* Written leaves that were deselected, reused with their array capacity */
+    TArray<TSharedPtr<FLeaf, ESPMode::ThreadSafe>> Pool;
+
+    /* Deselected while generating, pooled once their task completes */
+    TArray<TSharedPtr<FLeaf, ESPMode::ThreadSafe>> Releasing;
+
+    void Release(const TSharedPtr<FLeaf, ESPMode::ThreadSafe>& Leaf, TArray<FQuadTreeScatterWrite>& OutWrites);
+    int32 AllocateSlot(const int32 Layer);
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "QuadTreeScatter.h"
+
+#include "QuadTreeScatterComponent.generated.h"
+
+class UQuadTreeComponent;
+class UHierarchicalInstancedStaticMeshComponent;
+
+/*
+Scatters instances over the leaves selected by the owner's QuadTreeComponent, one hierarchical
+instanced mesh per layer. Needs a height source on the QuadTree, leaves are scattered as their
+height tiles arrive.
+*/
+UCLASS(ClassGroup=(Quady), meta=(BlueprintSpawnableComponent))
+class QUADY_API UQuadTreeScatterComponent
+    : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+    /* Takes effect on register */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Scatter")
+    TArray<FQuadTreeScatterLayer> Layers;
+
+	UQuadTreeScatterComponent();
+
+    virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+    virtual void ApplyWorldOffset(const FVector& InOffset, bool bWorldShift) override;
+
+protected:
+    virtual void OnRegister() override;
+    virtual void OnUnregister() override;
+
+private:
+    UPROPERTY(Transient)
+    UQuadTreeComponent* Source;
+
+    UPROPERTY(Transient)
+    TArray<UHierarchicalInstancedStaticMeshComponent*> Instances;
+
+    TUniquePtr<FQuadTreeScatter> Scatter;
+    uint32 SelectionRevision;
+
+    /* Grid origin the instance components were last placed at, they are moved again when it changes */
+    FIntVector InstanceOrigin;
+    bool bInstancesPlaced;
+};
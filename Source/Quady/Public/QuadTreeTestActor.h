@@ -21,6 +21,8 @@ public:
 
     virtual bool ShouldTickIfViewportsOnly() const override { return true; }
 
+    virtual void ApplyWorldOffset(const FVector& InOffset, bool bWorldShift) override;
+
 protected:
 	virtual void BeginPlay() override;
 
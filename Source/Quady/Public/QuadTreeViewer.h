@@ -1,33 +1,106 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Math/Interval.h"
+#include "ConvexVolume.h"
+
+struct FQuadTreeGrid;
+class FQuadTreeOcclusionBuffer;
+
+/* A light view, such as a shadow cascade, selecting a coarser cut of the main selection */
+struct FQuadTreeShadowView
+{
+public:
+    static const int32 MaxViews = 4;
+
+    FConvexVolume Frustum;
+
+    /* Levels coarser than the main view, ranges shrink by 2^LevelBias and nothing finer than LevelBias is selected */
+    uint8 LevelBias;
+
+    FQuadTreeShadowView()
+        : LevelBias(0) { }
+
+    FQuadTreeShadowView(const FConvexVolume& Frustum, const uint8 LevelBias)
+        : Frustum(Frustum),
+        LevelBias(LevelBias) { }
+};
 
 class QUADY_API FQuadTreeViewer
 {
 public:
+    FQuadTreeViewer();
+
     const bool HasLocationChanged() const;
     const bool HasLocationChanged(bool bClearFlag = false);
+
+    /* World location, only valid until the next origin shift */
     const FVector& GetLocation() const;
-    void SetLocation(const FVector& Location);
+    void SetLocation(const FQuadTreeGrid& Grid, const FVector& Location);
+
+    /* Cell the viewer is in, and its offset within it */
+    inline const FIntPoint& GetCell() const { return Cell; }
+    inline const FVector& GetCellOffset() const { return CellOffset; }
 
     const bool HasDirectionChanged() const;
     const bool HasDirectionChanged(bool bClearFlag = false);
     const FVector& GetDirection() const;
     void SetDirection(const FVector& Direction);
 
+    /* Range spheres are relative to the viewers cell */
     const FBoxSphereBounds& GetRange(const uint8& Level) const;
     void SetRanges(const TArray<float>& Ranges);
 
+    void SetCellSize(const int32 CellSize);
+
+    /* Distances over which a leaf of Level morphs into its parent, ending at the edge of its range */
+    FVector2D GetMorphRange(const uint8 Level, const float MorphStartRatio) const;
+
+    /* Bounds of a node relative to the viewers cell */
+    FBox GetRelativeBounds(const FIntPoint& Coordinates, const uint8 Level, const FFloatInterval& HeightBounds) const;
+
+    /* Occlusion for the current selection, nullptr to disable */
+    inline void SetOcclusion(const FQuadTreeOcclusionBuffer* Occlusion) { this->Occlusion = Occlusion; }
+    const bool IsOccluded(const FBox& RelativeBounds) const;
+
+    /* World space views, moved into the viewers cell space. Call after SetLocation */
+    void SetShadowViews(const FQuadTreeGrid& Grid, const TArray<FQuadTreeShadowView>& WorldShadowViews);
+    inline const uint8 GetShadowViewMask() const { return (uint8)((1 << ShadowViewCount) - 1); }
+    inline const uint8 GetShadowLevelBias(const int32 View) const { return ShadowViews[View].LevelBias; }
+
+    /* Subset of Candidates whose range and frustum the node is in */
+    const uint8 GetShadowViews(const FBox& RelativeBounds, const uint8 Level, const uint8 Candidates) const;
+
+    /* Follow a world origin shift, the cell is unaffected */
+    void ApplyWorldOffset(const FVector& Offset);
+
+    /* Force a full reselect on the next Update */
+    void Invalidate();
+
     void PostSelect();
 
     void Draw(const UWorld* World);
 
+    /* Cell, offset and direction only, ranges are derived from the owning QuadTree */
+    friend FArchive& operator<<(FArchive& Ar, FQuadTreeViewer& Viewer);
+
 private:
     FVector Location;
+    FIntPoint Cell;
+    FVector CellOffset;
+    int32 CellSize;
     bool bLocationDirty;
 
     FVector Direction;
     bool bDirectionDirty;
 
     TArray<FBoxSphereBounds> Ranges;
+
+    const FQuadTreeOcclusionBuffer* Occlusion;
+
+    /* Relative to the viewers cell */
+    FQuadTreeShadowView ShadowViews[FQuadTreeShadowView::MaxViews];
+    int32 ShadowViewCount;
+
+    void SetCell(const FIntPoint& Cell, const FVector& CellOffset);
 };
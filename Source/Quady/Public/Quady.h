@@ -24,4 +24,7 @@ class FQuadyModule
 public:
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
+
+private:
+    FDelegateHandle WorldCleanupHandle;
 };
\ No newline at end of file